@@ -1,10 +1,21 @@
-#include "graph.h"
-#include <chrono>
-
-// Constructor: Initializes the simulation time and random number generator
-Graph::Graph() {
-    uint32_t seed = static_cast<uint32_t>(chrono::high_resolution_clock::now().time_since_epoch().count());
-    rng.seed(seed);
-    simTimeSec = 0;
-    leakThreshold = 0.75; // Default leak threshold
-}
\ No newline at end of file
+#include "graph.h"
+#include <chrono>
+
+// Constructor: Initializes the simulation time and random number generator
+Graph::Graph() {
+    rng.seed(static_cast<uint64_t>(chrono::high_resolution_clock::now().time_since_epoch().count()));
+    simTimeSec = 0;
+    leakThreshold = 0.75; // Default leak threshold
+    recordEdgeFlows = false;
+    allocationMode = AllocationMode::GreedyPath;
+    routingMode = RoutingMode::Tree;
+    workerPool = nullptr;
+    bulkLoading = false;
+    topologyVersion = 0;
+    structureVersion = 0;
+    csrValid = false;
+}
+
+void Graph::seed(uint64_t seedValue) {
+    rng.seed(seedValue);
+}
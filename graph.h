@@ -1,55 +1,157 @@
-#ifndef GRAPH_H
-#define GRAPH_H
-
-#include "graph_types.h"
-#include <random>
-#include <unordered_set>
-#include <queue>
-#include <vector>
-
-class Graph {
-public:
-    vector<Node> nodes;
-    vector<Edge> edges;
-    int simTimeSec;
-    std::mt19937 rng;
-    vector<LogEntry> history;
-    double leakThreshold;
-
-    Graph(); // Constructor
-
-    // --- Node and Edge Operations (graph_operations.cpp) ---
-    void addNode(int id, const string& name, NodeType type, double capacity = 0);
-    void addEdge(int from, int to, double capacity, double flowRate = 0, bool active = true, int valveStatus = 1);
-    void rebuildOutgoingEdges();
-    void deactivateEdge(int from, int to);
-    void activateEdge(int from, int to);
-    void displayNode(int id) const;
-    void displayEdge(int from, int to) const;
-    bool editNodeCapacity(int id, double newCapacity);
-    bool editNodeName(int id, const string& newName);
-    bool editNodeType(int id, NodeType newType);
-    bool editNodeValveStatus(int id, int newValveStatus);
-    bool editEdgeCapacity(int from, int to, double newCapacity);
-    bool editEdgeFlowRate(int from, int to, double newFlowRate);
-    bool editEdgeStatus(int from, int to, bool newStatus);
-    bool editEdgeValve(int from, int to, int newValveStatus);
-    Node* getNodeById(int id);
-    const Node* getNodeByIdConst(int id) const;
-    Edge* getEdgeByIndex(int idx);
-    int getEdgeIndex(int from, int to) const;
-
-    // --- Simulation Logic (graph_simulation.cpp) ---
-    void updateTankLevels(int intervalSec, double maxReductionPerHour);
-    bool findPath(int sourceId, int targetId, vector<int>& path, const unordered_set<int>& bannedEdges = {}) const;
-    pair<double, double> supplyWaterAlongPath(int sourceId, const vector<int>& path, int intervalSec);
-    void simulateStep(int intervalSec, int sourceId, double maxReductionPerHour, double prescribedLevel);
-
-    // --- Logging and Utilities (graph_logging.cpp) ---
-    void pushLog(const string& message);
-    void printLastKLogs(int k) const;
-    static string formatTime(int seconds);
-    size_t historySize() const { return history.size(); }
-};
-
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "graph_types.h"
+#include "graph_arena.h"
+#include "graph_event_log.h"
+#include "graph_leaks.h"
+#include "graph_observer.h"
+#include "graph_random.h"
+#include "graph_zones.h"
+#include <functional>
+#include <iosfwd>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <queue>
+#include <vector>
+
+class ThreadPool;
+
+class Graph {
+public:
+    vector<Node> nodes;
+    vector<Edge> edges;
+    NodeState state;                              // level/capacity/type columns, indexed by node slot
+    int simTimeSec;
+    CounterRng rng;                               // every random draw of the simulation; see seed()
+    EventLog history;
+    double leakThreshold;
+    AllocationMode allocationMode;
+    RoutingMode routingMode;
+    ThreadPool* workerPool;                       // pool for data-parallel phases; nullptr = ThreadPool::shared()
+    vector<SimulationObserver*> observers;        // notified by simulateStep; not owned
+    LeakDetector leaks;                           // per-pipe leak statistics fed by every delivery
+    bool recordEdgeFlows;                         // keep edgeFlow up to date (for TimeSeriesRecorder)
+    vector<double> edgeFlow;                      // volume that entered each pipe this step, by edge index
+    vector<int> nodeSlotById;                     // node id -> index into nodes (-1 if unused)
+    unordered_map<long long, int> edgeIndexByKey; // edgeKey(from, to) -> index into edges
+    bool bulkLoading;                             // true between beginBulkLoad and endBulkLoad
+    unsigned topologyVersion;                     // bumped by every edit that changes routing
+    unsigned structureVersion;                    // bumped when nodes or pipes are added, removed or re-slotted
+    vector<int> changedEdges;                     // pipes whose routing fields changed since structureVersion moved
+
+    Graph(); // Constructor
+    // Restarts the random streams. The same seed, starting state and edits give bit-identical levels,
+    // whatever the thread count; the constructor seeds from the clock.
+    void seed(uint64_t seedValue);
+    uint64_t seed() const { return rng.key; }
+
+    // --- Node and Edge Operations (graph_operations.cpp) ---
+    void addNode(int id, const string& name, NodeType type, double capacity = 0);
+    void addEdge(int from, int to, double capacity, double flowRate = 0, bool active = true, int valveStatus = 1);
+    bool removeNode(int id);
+    bool removeEdge(int from, int to);
+    void clearNetwork();
+    void beginBulkLoad();
+    void endBulkLoad();
+    void rebuildOutgoingEdges();
+    void attachOutgoingEdge(int idx);
+    void detachOutgoingEdge(int idx);
+    void setEdgeActive(int idx, bool active);
+    void deactivateEdge(int from, int to);
+    void activateEdge(int from, int to);
+    void displayNode(int id) const;
+    void displayEdge(int from, int to) const;
+    bool editNodeCapacity(int id, double newCapacity);
+    bool editNodeName(int id, const string& newName);
+    bool editNodeType(int id, NodeType newType);
+    bool editNodeValveStatus(int id, int newValveStatus);
+    bool editEdgeCapacity(int from, int to, double newCapacity);
+    bool editEdgeFlowRate(int from, int to, double newFlowRate);
+    bool editEdgeStatus(int from, int to, bool newStatus);
+    bool editEdgeValve(int from, int to, int newValveStatus);
+    bool setEdgeLoss(int from, int to, double lossFraction);
+    bool applyEdits(const EditBatch& batch);
+    Node* getNodeById(int id);
+    const Node* getNodeByIdConst(int id) const;
+    Edge* getEdgeByIndex(int idx);
+    int getEdgeIndex(int from, int to) const;
+    int getNodeSlot(int id) const;
+    double getNodeLevel(int id) const;
+    bool setNodeLevel(int id, double level);
+    static long long edgeKey(int from, int to);
+
+    // --- CSR topology snapshot (graph_topology.cpp) ---
+    const CsrTopology& topology() const;
+    void invalidateTopology();     // anything may have changed, including node slots and edge indices
+    void invalidateEdge(int idx);  // only pipe idx's active flag, valve, capacity or flow rate changed
+
+    // --- Simulation Logic (graph_simulation.cpp) ---
+    void updateTankLevels(int intervalSec, double maxReductionPerHour);
+    bool findPath(int sourceId, int targetId, vector<int>& path, const vector<int>& bannedEdges = {}) const;
+    bool findPath(int sourceId, int targetId, vector<int>& path, PathWorkspace& ws, const vector<int>& bannedEdges = {}) const;
+    double pathSupplyRate(const vector<int>& path) const;
+    void addPathFlow(const vector<int>& path, double volume);
+    pair<double, double> supplyWaterAlongPath(int sourceId, const vector<int>& path, int intervalSec,
+                                              double maxRate = numeric_limits<double>::infinity());
+    const RouteTree& routeTree(int sourceId) const;
+    bool extractPath(const RouteTree& tree, int targetId, vector<int>& path) const;
+    const RouteTree& widestTree(int sourceId) const;
+    bool findZonedPath(int sourceId, int targetId, vector<int>& path) const;
+    ZoneRouter& zones() const { return zoneRouter; }
+    double supplyWaterMaxFlow(int sourceId, const vector<int>& tankIds, int intervalSec);
+    void simulateStep(int intervalSec, int sourceId, double maxReductionPerHour, double prescribedLevel);
+
+    // --- Leak localisation (graph_leaks.cpp) ---
+    double pathRetention(const vector<int>& path) const;
+    void steerAroundLeaks(int sourceId, int targetId, vector<int>& path) const;
+    void recordDelivery(const vector<int>& path, double expected, double actual);
+    double retryAroundLeaks(int sourceId, int tankId, const vector<int>& path, int intervalSec,
+                            const function<double(const vector<int>&)>& claimRate = nullptr);
+
+    // --- Batched parallel refills (graph_refill.cpp) ---
+    RefillStats supplyWaterBatched(int sourceId, const vector<RefillRequest>& requests, int intervalSec);
+
+    // --- Binary network files (graph_io.cpp) ---
+    bool saveBinary(const string& path, bool includeCsr = true) const;
+    bool loadBinary(const string& path);
+
+    // --- CSV import (graph_import.cpp) ---
+    ImportReport importCsv(const string& nodesPath, const string& pipesPath);
+
+    // --- Headless batch runs and observers (graph_batch.cpp) ---
+    BatchStats runBatch(long long steps, int intervalSec, int sourceId, double maxReductionPerHour, double prescribedLevel);
+    void addObserver(SimulationObserver* observer);
+    void removeObserver(SimulationObserver* observer);
+
+    // --- Monte Carlo ensembles (graph_ensemble.cpp) ---
+    EnsembleResult runEnsemble(const EnsembleConfig& config) const;
+
+    // --- Logging and Utilities (graph_logging.cpp) ---
+    void pushLog(const string& message);
+    void logEvent(LogKind kind, int nodeId, int aux = 0, int aux2 = 0,
+                  double v0 = 0, double v1 = 0, double v2 = 0, double v3 = 0);
+    string formatLogMessage(const LogEntry& e, const string& text) const;
+    string formatLog(size_t i) const;
+    void printLastKLogs(int k) const;
+    void exportLogs(ostream& out) const;
+    static string formatTime(int seconds);
+    size_t historySize() const { return history.size(); }
+
+private:
+    mutable CsrTopology csr;
+    mutable bool csrValid;
+    mutable RouteTree routeCache;
+    mutable RouteTree widestCache;
+    mutable WidestScratch widestScratch;
+    mutable PathWorkspace pathScratch; // used by the findPath overload without a caller workspace
+    mutable ZoneRouter zoneRouter;
+    RefillScratch refillScratch;
+    StepArena stepArena;               // transient containers of simulateStep and updateTankLevels
+    vector<int> stepPath;              // buffers handed to the routing and refill calls, kept between
+    vector<int> stepTargets;           // steps so their capacity is reused
+    vector<RefillRequest> stepRequests;
+};
+
 #endif // GRAPH_H
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "graph_arena.h"
+#include <algorithm>
+
+using namespace std;
+
+// ---------------- step arena ----------------
+
+StepArena::StepArena(size_t initialBytes) : block(initialBytes) {
+    arena.emplace(block.data(), block.size(), &spill);
+}
+
+StepArena::StepArena(const StepArena& other) : StepArena(other.block.size()) {}
+
+StepArena& StepArena::operator=(const StepArena& other) {
+    if (this != &other) {
+        arena.reset();
+        block.assign(other.block.size(), byte{});
+        spill.bytes = 0;
+        arena.emplace(block.data(), block.size(), &spill);
+    }
+    return *this;
+}
+
+// Drops everything allocated since the last reset. If the step spilled, the block grows to at
+// least what the step used so the next one fits; otherwise the resource is just rebuilt over the
+// same block, which allocates nothing.
+void StepArena::reset() {
+    arena.reset(); // returns the spilled chunks to the heap
+    if (spill.bytes > 0) {
+        block.assign(max(2 * block.size(), block.size() + spill.bytes), byte{});
+        spill.bytes = 0;
+    }
+    arena.emplace(block.data(), block.size(), &spill);
+}
+
+void* StepArena::Spill::do_allocate(size_t n, size_t align) {
+    bytes += n;
+    return pmr::new_delete_resource()->allocate(n, align);
+}
+
+void StepArena::Spill::do_deallocate(void* p, size_t n, size_t align) {
+    pmr::new_delete_resource()->deallocate(p, n, align);
+}
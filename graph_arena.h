@@ -0,0 +1,60 @@
+#ifndef GRAPH_ARENA_H
+#define GRAPH_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+// Bump allocator for the transient containers of one simulation step (the refill priority queue,
+// the below-prescribed candidate lists, the staged consumption records). Everything is carved from
+// one block that is kept between steps and released wholesale when the outermost Scope closes; no
+// deallocation happens in between. A step that outgrows the block spills to the heap, and the next
+// reset grows the block to cover it, so once warm a step makes no heap allocation for these.
+//
+// Each Graph owns one, so concurrent simulations (ensemble workers) never share an allocator. Not
+// thread-safe: pool workers must only write into memory that was reserved before they started.
+class StepArena {
+public:
+    explicit StepArena(size_t initialBytes = 64 * 1024);
+    // a copy starts empty, with the source's block size
+    StepArena(const StepArena& other);
+    StepArena& operator=(const StepArena& other);
+
+    std::pmr::memory_resource* resource() { return &*arena; }
+    size_t capacity() const { return block.size(); }
+
+    // Opened by every entry point that allocates from the arena; the outermost one resets it on
+    // exit, so nested calls (updateTankLevels inside simulateStep) share the step's memory.
+    class Scope {
+    public:
+        explicit Scope(StepArena& a) : owner(a) { ++owner.depth; }
+        ~Scope() { if (--owner.depth == 0) owner.reset(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StepArena& owner;
+    };
+
+private:
+    // Heap fallback that records how much a step needed beyond the block.
+    class Spill : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t n, size_t align) override;
+        void do_deallocate(void* p, size_t n, size_t align) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    void reset();
+
+    std::vector<std::byte> block;
+    Spill spill;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+    int depth = 0;
+};
+
+#endif // GRAPH_ARENA_H
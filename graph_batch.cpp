@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <chrono>
+#include "graph.h"
+
+// ---------------- headless batch runs ----------------
+
+void Graph::addObserver(SimulationObserver* observer) {
+    if (observer && find(observers.begin(), observers.end(), observer) == observers.end()) {
+        observers.push_back(observer);
+    }
+}
+
+void Graph::removeObserver(SimulationObserver* observer) {
+    observers.erase(remove(observers.begin(), observers.end(), observer), observers.end());
+}
+
+// Runs `steps` back-to-back steps with no pauses and reports throughput. Nothing is printed
+// unless an observer is attached, so this measures the engine alone.
+BatchStats Graph::runBatch(long long steps, int intervalSec, int sourceId, double maxReductionPerHour, double prescribedLevel) {
+    BatchStats stats;
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < steps; ++i) {
+        simulateStep(intervalSec, sourceId, maxReductionPerHour, prescribedLevel);
+    }
+    stats.steps = steps;
+    stats.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stats.simulatedSeconds = static_cast<double>(steps) * intervalSec;
+    if (stats.wallSeconds > 0.0) {
+        stats.stepsPerSecond = steps / stats.wallSeconds;
+        stats.simSecondsPerWallSecond = stats.simulatedSeconds / stats.wallSeconds;
+    }
+    return stats;
+}
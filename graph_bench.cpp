@@ -0,0 +1,849 @@
+#include "graph.h"
+#include "graph_des.h"
+#include "graph_kernels.h"
+#include "graph_random.h"
+#include "graph_replay.h"
+#include "graph_timeseries.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+// Micro benchmarks for the graph engine. Build and run with `make bench-compare`.
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Builds a tree-shaped network (each node fed by node/2) plus one cross pipe per node,
+// roughly the shape of a distribution network hanging off one reservoir.
+static void buildNetwork(Graph& g, int nodeCount, bool bulk = false) {
+    if (bulk) g.beginBulkLoad();
+    g.addNode(0, "Reservoir", NodeType::Tank, 1e12);
+    for (int id = 1; id < nodeCount; ++id) {
+        g.addNode(id, "Tank " + to_string(id), NodeType::Tank, 1000);
+    }
+    for (int id = 1; id < nodeCount; ++id) {
+        g.addEdge(id / 2, id, 100, 70);
+        if (id + 7 < nodeCount && (id + 7) / 2 != id) g.addEdge(id, id + 7, 50, 40);
+    }
+    if (bulk) g.endBulkLoad();
+}
+
+static void benchLookups(int nodeCount) {
+    Graph g;
+    auto start = chrono::steady_clock::now();
+    buildNetwork(g, nodeCount);
+    double buildSec = secondsSince(start);
+
+    const int queries = 1000000;
+    unsigned x = 12345;
+    long long found = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        x = x * 1103515245u + 12345u;
+        if (g.getNodeById(static_cast<int>(x % nodeCount))) ++found;
+    }
+    double nodeNs = secondsSince(start) * 1e9 / queries;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        x = x * 1103515245u + 12345u;
+        int id = 1 + static_cast<int>(x % (nodeCount - 1));
+        if (g.getEdgeIndex(id / 2, id) != -1) ++found;
+    }
+    double edgeNs = secondsSince(start) * 1e9 / queries;
+
+    cout << "nodes=" << nodeCount << " edges=" << g.edges.size()
+         << " build=" << buildSec * 1e3 << " ms"
+         << " getNodeById=" << nodeNs << " ns/op"
+         << " getEdgeIndex=" << edgeNs << " ns/op"
+         << " (hits=" << found << ")\n";
+}
+
+static void benchAdjacency(int nodeCount) {
+    Graph incremental;
+    auto start = chrono::steady_clock::now();
+    buildNetwork(incremental, nodeCount);
+    double incrementalSec = secondsSince(start);
+
+    Graph bulk;
+    start = chrono::steady_clock::now();
+    buildNetwork(bulk, nodeCount, true);
+    double bulkSec = secondsSince(start);
+
+    // toggle every pipe off and on again: O(degree) per change
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < bulk.edges.size(); ++i) bulk.setEdgeActive(static_cast<int>(i), false);
+    for (size_t i = 0; i < bulk.edges.size(); ++i) bulk.setEdgeActive(static_cast<int>(i), true);
+    double toggleNs = secondsSince(start) * 1e9 / (2.0 * bulk.edges.size());
+
+    // a pipe whose source node does not exist yet is refused instead of missing from the lists
+    Graph orphan;
+    orphan.addNode(1, "Tank 1", NodeType::Tank, 1000);
+    cerr.setstate(ios::failbit);
+    orphan.addEdge(2, 1, 100, 70);
+    cerr.clear();
+    orphan.addNode(2, "Tank 2", NodeType::Tank, 1000);
+    orphan.addEdge(2, 1, 100, 70);
+    bool orphanOk = orphan.edges.size() == 1 && orphan.getNodeById(2)->outgoingEdges.size() == 1;
+
+    cout << "nodes=" << nodeCount << " pipes=" << bulk.edges.size()
+         << " addEdge=" << incrementalSec * 1e3 << " ms"
+         << " bulkLoad=" << bulkSec * 1e3 << " ms"
+         << " toggle=" << toggleNs << " ns/op"
+         << " orphan-pipe=" << (orphanOk ? "refused" : "KEPT") << "\n";
+}
+
+static void benchFindPath(int nodeCount) {
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    g.topology(); // build the CSR snapshot outside the timed loop
+
+    const int queries = 200;
+    vector<int> path;
+    size_t hops = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        int target = nodeCount - 1 - (i * 37) % (nodeCount / 2);
+        if (g.findPath(0, target, path)) hops += path.size();
+    }
+    double us = secondsSince(start) * 1e6 / queries;
+    cout << "nodes=" << nodeCount << " findPath=" << us << " us/op (avg hops="
+         << static_cast<double>(hops) / queries << ")\n";
+}
+
+static void benchRouteTree(int nodeCount, int tanks) {
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    g.topology();
+
+    vector<int> path;
+    size_t hops = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < tanks; ++i) {
+        if (g.findPath(0, nodeCount - 1 - i, path)) hops += path.size();
+    }
+    double perTankSec = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    g.invalidateTopology(); // force the tree (and snapshot) to be rebuilt inside the timed region
+    const RouteTree& tree = g.routeTree(0);
+    for (int i = 0; i < tanks; ++i) {
+        if (g.extractPath(tree, nodeCount - 1 - i, path)) hops += path.size();
+    }
+    double treeSec = secondsSince(start);
+
+    cout << "nodes=" << nodeCount << " tanks=" << tanks
+         << " findPath-per-tank=" << perTankSec * 1e3 << " ms"
+         << " routeTree+extract=" << treeSec * 1e3 << " ms"
+         << " (hops=" << hops << ")\n";
+}
+
+// Compares the greedy single-path supply (capped at 3 tanks, as in simulateStep, and uncapped)
+// against the max-flow allocation on a network where every tank is empty. Note the uncapped greedy
+// run over-delivers: each path gets its full bottleneck even when pipes are shared.
+static void benchAllocation(int nodeCount) {
+    const int intervalSec = 30;
+    vector<int> tanks;
+    for (int id = 1; id < nodeCount; ++id) tanks.push_back(id);
+
+    auto freshNetwork = [&](Graph& g) {
+        buildNetwork(g, nodeCount, true);
+        for (int id = 50; id < nodeCount; id += 50) g.addEdge(0, id, 1000, 1000); // trunk mains
+        g.setNodeLevel(0, 1e12);
+        g.topology();
+    };
+
+    double greedyDelivered[2] = {0, 0}, greedySec[2] = {0, 0};
+    for (int capped = 0; capped < 2; ++capped) {
+        Graph g;
+        freshNetwork(g);
+        vector<int> path;
+        auto start = chrono::steady_clock::now();
+        const RouteTree& tree = g.routeTree(0);
+        size_t limit = capped ? 3 : tanks.size();
+        for (size_t i = 0; i < limit; ++i) {
+            if (g.extractPath(tree, tanks[i], path)) {
+                greedyDelivered[capped] += g.supplyWaterAlongPath(0, path, intervalSec).second;
+            }
+        }
+        greedySec[capped] = secondsSince(start);
+    }
+
+    Graph g;
+    freshNetwork(g);
+    auto start = chrono::steady_clock::now();
+    double flowDelivered = g.supplyWaterMaxFlow(0, tanks, intervalSec);
+    double flowSec = secondsSince(start);
+
+    cout << "nodes=" << nodeCount << " pipes=" << g.edges.size()
+         << " greedy(3 tanks)=" << greedyDelivered[1] << " units in " << greedySec[1] * 1e3 << " ms"
+         << " greedy(all)=" << greedyDelivered[0] << " units in " << greedySec[0] * 1e3 << " ms"
+         << " maxflow=" << flowDelivered << " units in " << flowSec * 1e3 << " ms\n";
+}
+
+// Compares the fewest-pipes BFS tree with the widest-bottleneck tree on a network whose trunk mains
+// are much wider than the distribution pipes: build time, and the rate each tree's path can push to
+// a set of tanks (pathSupplyRate, i.e. what supplyWaterAlongPath delivers per second).
+static void benchWidestRouting(int nodeCount, int tanks) {
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    for (int id = 50; id < nodeCount; id += 50) g.addEdge(0, id, 1000, 1000); // trunk mains
+    g.topology();
+
+    double rate[2] = {0, 0}, sec[2] = {0, 0};
+    size_t hops[2] = {0, 0};
+    vector<int> path;
+    for (int widest = 0; widest < 2; ++widest) {
+        g.invalidateTopology(); // time the tree build, not a cache hit
+        g.topology();
+        auto start = chrono::steady_clock::now();
+        const RouteTree& tree = widest ? g.widestTree(0) : g.routeTree(0);
+        sec[widest] = secondsSince(start);
+        for (int i = 0; i < tanks; ++i) {
+            if (!g.extractPath(tree, nodeCount - 1 - i, path)) continue;
+            rate[widest] += g.pathSupplyRate(path);
+            hops[widest] += path.size();
+        }
+    }
+
+    cout << "nodes=" << nodeCount << " tanks=" << tanks
+         << " bfs-tree=" << sec[0] * 1e3 << " ms rate=" << rate[0] << "/s hops=" << hops[0]
+         << " widest-tree=" << sec[1] * 1e3 << " ms rate=" << rate[1] << "/s hops=" << hops[1] << "\n";
+}
+
+// Times one consumption phase and checks that the levels do not depend on the thread count.
+static void benchConsumption(int nodeCount) {
+    ThreadPool single(1);
+    ThreadPool wide(max(4u, thread::hardware_concurrency()));
+    vector<double> levels[2];
+    double sec[2] = {0, 0};
+    for (int variant = 0; variant < 2; ++variant) {
+        Graph g;
+        g.rng.seed(42);
+        g.workerPool = variant == 0 ? &single : &wide;
+        buildNetwork(g, nodeCount, true);
+        fill(g.state.level.begin(), g.state.level.end(), 1000.0);
+        auto start = chrono::steady_clock::now();
+        g.updateTankLevels(30, 10000.0);
+        sec[variant] = secondsSince(start);
+        levels[variant] = g.state.level;
+    }
+    cout << "nodes=" << nodeCount
+         << " 1 thread=" << sec[0] * 1e3 << " ms"
+         << " " << wide.size() << " threads=" << sec[1] * 1e3 << " ms"
+         << " identical=" << (levels[0] == levels[1] ? "yes" : "NO") << "\n";
+}
+
+// One step with every tank half empty: the greedy loop (3 tanks) against batched refills of every
+// queued tank, on one thread and on the pool; the batched levels must not depend on the thread count.
+static void benchBatchedRefill(int nodeCount) {
+    ThreadPool single(1);
+    ThreadPool wide(max(4u, thread::hardware_concurrency()));
+    auto freshNetwork = [&](Graph& g) {
+        buildNetwork(g, nodeCount, true);
+        for (int id = 50; id < nodeCount; id += 50) g.addEdge(0, id, 1000, 1000); // trunk mains
+        for (int id = 1; id < nodeCount; ++id) g.setNodeLevel(id, 100);
+        g.rng.seed(42);
+        g.topology();
+    };
+
+    struct Run { double sec = 0, delivered = 0; size_t batches = 0, deferred = 0; vector<double> levels; };
+    Run runs[3];
+    for (int variant = 0; variant < 3; ++variant) {
+        Graph g;
+        freshNetwork(g);
+        g.workerPool = variant == 2 ? &wide : &single;
+        g.allocationMode = variant == 0 ? AllocationMode::GreedyPath : AllocationMode::Batched;
+        g.routeTree(0);
+        double before = 0;
+        for (double level : g.state.level) before += level;
+        auto start = chrono::steady_clock::now();
+        if (variant == 0) {
+            g.simulateStep(30, 0, 0.0, 200.0);
+        } else {
+            vector<RefillRequest> requests;
+            for (int id = 1; id < nodeCount; ++id) requests.push_back(RefillRequest{id, 100, 1000, 0.5});
+            RefillStats st = g.supplyWaterBatched(0, requests, 30);
+            runs[variant].batches = st.batches;
+            runs[variant].deferred = st.deferred;
+        }
+        runs[variant].sec = secondsSince(start);
+        for (double level : g.state.level) runs[variant].delivered += level;
+        runs[variant].delivered -= before;
+        runs[variant].levels = g.state.level;
+    }
+    cout << "nodes=" << nodeCount
+         << " greedy(3 tanks)=" << runs[0].delivered << " units in " << runs[0].sec * 1e3 << " ms"
+         << " batched=" << runs[1].delivered << " units, " << runs[1].batches << " batches, "
+         << runs[1].deferred << " deferred, 1 thread " << runs[1].sec * 1e3 << " ms, "
+         << wide.size() << " threads " << runs[2].sec * 1e3 << " ms"
+         << " identical=" << (runs[1].levels == runs[2].levels ? "yes" : "NO") << "\n";
+}
+
+// Simulated leaks on a few distribution pipes, batched refills for a number of steps: how many of the
+// leaking pipes the detector flags, how many sound pipes it flags, and how many re-route BFS calls the
+// alerts cost. No pipe may carry more in a step than its supply rate allows, retries included.
+static void benchLeakLocalisation(int nodeCount, int steps) {
+    struct AlertCounter : SimulationObserver {
+        size_t alerts = 0, reroutes = 0;
+        void onLeakSuspected(const Graph&, int, double, double) override { ++alerts; }
+        void onAlternateRoute(const Graph&, int, bool, double, double) override { ++reroutes; }
+    } counter;
+
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    for (int id = 50; id < nodeCount; id += 50) g.addEdge(0, id, 1000, 1000); // trunk mains
+    g.rng.seed(42);
+    g.allocationMode = AllocationMode::Batched;
+    g.addObserver(&counter);
+    g.recordEdgeFlows = true;
+    SplitMix64 pick(99);
+    vector<int> leaking, path;
+    while (leaking.size() < 5) {
+        int tank = 1 + static_cast<int>(pick.next() % (nodeCount - 1));
+        if (!g.extractPath(g.routeTree(0), tank, path) || path.empty()) continue;
+        int idx = path[path.size() / 2]; // a pipe on a route in use, so it carries water
+        if (find(leaking.begin(), leaking.end(), idx) != leaking.end()) continue;
+        leaking.push_back(idx);
+        g.setEdgeLoss(g.edges[idx].from, g.edges[idx].to, 0.2 + 0.05 * static_cast<double>(leaking.size()));
+    }
+
+    double sec = 0.0;
+    size_t overdrawn = 0;
+    for (int step = 0; step < steps; ++step) {
+        auto start = chrono::steady_clock::now();
+        g.simulateStep(30, 0, 10000.0, 200.0);
+        sec += secondsSince(start);
+        for (size_t i = 0; i < g.edgeFlow.size(); ++i) {
+            const Edge& e = g.edges[i];
+            if (g.edgeFlow[i] > 0.8 * min(e.capacity, e.flowRate) * 30 * (1.0 + 1e-9)) ++overdrawn;
+        }
+    }
+
+    size_t found = 0;
+    for (int idx : leaking) found += g.leaks.flagged(idx) ? 1 : 0;
+    cout << "nodes=" << nodeCount << " steps=" << steps << " leaks=" << leaking.size()
+         << " flagged=" << found << " false-flags=" << g.leaks.flaggedCount() - found
+         << " alerts=" << counter.alerts << " reroute-bfs=" << counter.reroutes
+         << " overdrawn-pipes=" << overdrawn << " in " << sec * 1e3 << " ms\n";
+}
+
+// Max-flow allocation with a leaking main that has a detour: once the detector flags the main, the
+// flow should go around it. Reports the steps until the flag and the volume the flagged main still
+// carried afterwards.
+static void benchMaxFlowLeak() {
+    Graph g;
+    g.addNode(0, "Reservoir", NodeType::Tank, 1e12);
+    g.addNode(1, "Junction", NodeType::Industry, 1e12);
+    g.addNode(2, "Tank", NodeType::Tank, 3000); // one interval's demand fits through the detour
+    g.setNodeLevel(0, 1e12);
+    g.setNodeLevel(1, 1e12);
+    g.setNodeLevel(2, 0);
+    g.addEdge(0, 2, 100, 70);  // the leaking main
+    g.addEdge(0, 1, 200, 200); // the detour
+    g.addEdge(1, 2, 200, 200);
+    g.setEdgeLoss(0, 2, 0.5);
+    g.rng.seed(7);
+    g.allocationMode = AllocationMode::MaxFlow;
+    g.recordEdgeFlows = true;
+    const int main = g.getEdgeIndex(0, 2);
+
+    int flaggedAt = -1, steps = 0;
+    double after = 0.0;
+    for (; steps < 100; ++steps) {
+        g.simulateStep(30, 0, 100000.0, 200000.0);
+        if (flaggedAt >= 0) after += g.edgeFlow[main];
+        if (flaggedAt < 0 && g.leaks.flagged(main)) flaggedAt = steps;
+    }
+    cout << "maxflow leaking main flagged after " << flaggedAt + 1 << " steps, volume through it afterwards="
+         << after << " rerouted=" << (flaggedAt >= 0 && after == 0.0 ? "yes" : "NO") << "\n";
+}
+
+// Layout of the node record before the level/capacity columns moved into NodeState.
+struct AosNode {
+    int id;
+    NodeType type;
+    string name;
+    double storageCapacity;
+    double currentLevel;
+    int valveStatus;
+    vector<int> outgoingEdges;
+};
+
+// Consumption clamp and below-prescribed filter: AoS loop vs SoA scalar vs SoA AVX2.
+static void benchKernels(int nodeCount) {
+    const int reps = 50;
+    const double scale = 10000.0 / 3600.0 * 30;
+    const double prescribed = 200.0;
+    vector<double> factor(nodeCount);
+    SplitMix64 rnd(7);
+    for (double& f : factor) f = rnd.nextUnit() * 0.5;
+
+    vector<AosNode> aos(nodeCount);
+    NodeState soa;
+    for (int i = 0; i < nodeCount; ++i) {
+        aos[i].id = i;
+        aos[i].type = NodeType::Tank;
+        aos[i].name = "Tank " + to_string(i);
+        aos[i].storageCapacity = 1000;
+        aos[i].currentLevel = 1000;
+        soa.push(1000, true);
+        soa.level[i] = 1000;
+    }
+    vector<int> slots(nodeCount);
+    vector<double> scores(nodeCount);
+    size_t selected = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (int i = 0; i < nodeCount; ++i) {
+            aos[i].currentLevel = max(0.0, aos[i].currentLevel - factor[i] * scale);
+        }
+        for (int i = 0; i < nodeCount; ++i) {
+            const AosNode& n = aos[i];
+            if (n.type != NodeType::Tank || n.currentLevel >= prescribed) continue;
+            slots[selected % nodeCount] = i;
+            scores[selected % nodeCount] = (1.0 - n.currentLevel / prescribed) * n.storageCapacity;
+            ++selected;
+        }
+    }
+    double aosNs = secondsSince(start) * 1e9 / (static_cast<double>(reps) * nodeCount);
+
+    double soaNs[2] = {0, 0};
+    for (int variant = 0; variant < 2; ++variant) {
+        fill(soa.level.begin(), soa.level.end(), 1000.0);
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            if (variant == 0) {
+                consumeLevelsScalar(soa.level.data(), factor.data(), scale, nodeCount);
+                selected += selectTanksBelowScalar(soa.level.data(), soa.capacity.data(), soa.isTank.data(),
+                                                   nodeCount, prescribed, slots.data(), scores.data());
+            } else {
+                consumeLevelsAvx2(soa.level.data(), factor.data(), scale, nodeCount);
+                selected += selectTanksBelowAvx2(soa.level.data(), soa.capacity.data(), soa.isTank.data(),
+                                                 nodeCount, prescribed, slots.data(), scores.data());
+            }
+        }
+        soaNs[variant] = secondsSince(start) * 1e9 / (static_cast<double>(reps) * nodeCount);
+    }
+
+    cout << "nodes=" << nodeCount << " AoS=" << aosNs << " ns/node"
+         << " SoA scalar=" << soaNs[0] << " ns/node"
+         << " SoA AVX2=" << soaNs[1] << " ns/node"
+         << (cpuHasAvx2() ? "" : " (no AVX2 on this CPU: scalar fallback)")
+         << " (selected=" << selected << ")\n";
+}
+
+// Cost of recording one consumption event: the old string-formatted line vs a typed record.
+static void benchLogging() {
+    const int events = 1000000;
+    Graph g;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < events; ++i) {
+        ostringstream oss;
+        oss << "Tank " << i << " consumed " << 1.5 << " units (before=" << 100.0 << ", after=" << 98.5 << ")";
+        g.pushLog(oss.str());
+    }
+    double textNs = secondsSince(start) * 1e9 / events;
+
+    g.history.clear();
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < events; ++i) g.logEvent(LogKind::Consumption, i, 1, 0, 1.5, 100.0, 98.5);
+    double typedNs = secondsSince(start) * 1e9 / events;
+
+    cout << "events=" << events << " formatted pushLog=" << textNs << " ns/op"
+         << " typed logEvent=" << typedNs << " ns/op"
+         << " (retained=" << g.history.size() << " of " << g.history.totalPushed() << ")\n";
+}
+
+// Save and reload a network through the binary file format.
+static void benchBinaryIo(int nodeCount) {
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    const string path = "/tmp/graph_bench_network.bin";
+
+    auto start = chrono::steady_clock::now();
+    bool saved = g.saveBinary(path);
+    double saveSec = secondsSince(start);
+
+    Graph loaded;
+    start = chrono::steady_clock::now();
+    bool ok = saved && loaded.loadBinary(path);
+    double loadSec = secondsSince(start);
+    remove(path.c_str());
+
+    bool same = ok && loaded.edges.size() == g.edges.size() && loaded.state.level == g.state.level &&
+                loaded.topology().targets == g.topology().targets;
+    cout << "nodes=" << nodeCount << " pipes=" << g.edges.size()
+         << " save=" << saveSec * 1e3 << " ms load=" << loadSec * 1e3 << " ms"
+         << " roundtrip=" << (same ? "ok" : "MISMATCH") << "\n";
+}
+
+// Two simulated hours of levels and flows: recording cost per value, compression, and a one-hour
+// range query for a single tank against decoding that tank's whole run.
+static void benchTimeSeries(int nodeCount) {
+    const int steps = 240;
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    g.rng.seed(42);
+    g.recordEdgeFlows = true;
+    TimeSeriesRecorder recorder;
+    double recordSec = 0;
+    for (int step = 0; step < steps; ++step) {
+        g.simulateStep(30, 0, 10000.0, 200.0);
+        auto start = chrono::steady_clock::now();
+        recorder.sample(g);
+        recordSec += secondsSince(start);
+    }
+
+    const int tank = nodeCount / 2;
+    vector<SeriesSample> window, whole;
+    auto start = chrono::steady_clock::now();
+    recorder.levels(tank, 3600, 7200, window);
+    double windowSec = secondsSince(start);
+    start = chrono::steady_clock::now();
+    recorder.levels(tank, 0, g.simTimeSec, whole);
+    double wholeSec = secondsSince(start);
+
+    const string path = "/tmp/graph_bench_series.bin";
+    TimeSeriesRecorder loaded;
+    bool ok = recorder.save(path) && loaded.load(path);
+    remove(path.c_str());
+    vector<SeriesSample> reread;
+    if (ok) loaded.levels(tank, 0, g.simTimeSec, reread);
+    ok = ok && reread.size() == whole.size() && whole.size() == static_cast<size_t>(steps) &&
+         whole.back().value == g.getNodeLevel(tank);
+
+    cout << "nodes=" << nodeCount << " values=" << recorder.valuesRecorded()
+         << " record=" << recordSec * 1e9 / static_cast<double>(recorder.valuesRecorded()) << " ns/value"
+         << " bytes=" << recorder.compressedBytes() << " ratio="
+         << static_cast<double>(recorder.rawBytes()) / static_cast<double>(recorder.compressedBytes())
+         << " 1h-query=" << windowSec * 1e6 << " us (" << window.size() << " samples) full-series="
+         << wholeSec * 1e6 << " us roundtrip=" << (ok ? "ok" : "MISMATCH") << "\n";
+}
+
+// A seeded batched run recorded on the thread pool and replayed on one thread: the replay must match
+// every step, since the consumption draws depend only on the seed, the node and the step.
+static void benchReplay(int nodeCount) {
+    const int steps = 100;
+    ThreadPool wide(max(4u, thread::hardware_concurrency()));
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    for (int id = 50; id < nodeCount; id += 50) g.addEdge(0, id, 1000, 1000);
+    g.seed(42);
+    g.allocationMode = AllocationMode::Batched;
+    g.workerPool = &wide;
+    const string path = "/tmp/graph_bench_replay.run";
+    RunRecorder recorder;
+    bool ok = recorder.begin(g, RunParams(), path);
+    g.addObserver(&recorder);
+    auto start = chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) g.simulateStep(30, 0, 10000.0, 200.0);
+    double recordSec = secondsSince(start);
+    ok = ok && recorder.finish();
+    ReplayReport report;
+    ok = ok && replayRun(path, report) && report.ok();
+    remove(path.c_str());
+    remove((path + ".net").c_str());
+    cout << "nodes=" << nodeCount << " steps=" << steps << " recorded on " << wide.size() << " threads "
+         << recordSec * 1e3 << " ms, replayed on 1 thread " << report.wallSeconds * 1e3 << " ms match="
+         << (ok ? "yes" : "NO") << "\n";
+}
+
+// A city split into pressure districts of ~1000 nodes: each district is a buildNetwork-shaped
+// subnetwork whose root is fed by a trunk main from the reservoir, with a tie main to the next
+// district. Returns the district of every node slot.
+static vector<int> buildDistrictNetwork(Graph& g, int nodeCount) {
+    const int districtSize = 1000;
+    vector<int> district;
+    g.beginBulkLoad();
+    g.addNode(0, "Reservoir", NodeType::Tank, 1e12);
+    district.push_back(0);
+    for (int id = 1; id < nodeCount; ++id) {
+        g.addNode(id, "Tank " + to_string(id), NodeType::Tank, 1000);
+        district.push_back(1 + (id - 1) / districtSize);
+    }
+    for (int id = 1; id < nodeCount; ++id) {
+        int root = 1 + (id - 1) / districtSize * districtSize, local = id - root + 1; // local ids 1..size
+        if (local == 1) {
+            g.addEdge(0, id, 400, 300);
+            if (root + districtSize < nodeCount) g.addEdge(id, id + districtSize, 100, 70);
+            continue;
+        }
+        g.addEdge(root + local / 2 - 1, id, 100, 70);
+        int cross = id + 7;
+        if (cross < nodeCount && cross < root + districtSize && (local + 7) / 2 != local) g.addEdge(id, cross, 50, 40);
+    }
+    g.endBulkLoad();
+    return district;
+}
+
+// The step pattern after a valve change: toggle one pipe, then route a few tanks. The whole-network
+// tree pays for a CSR rebuild and a full BFS per toggle; the zone router (zones = districts)
+// recomputes only the touched zone and re-searches the small boundary overlay.
+static void benchZonedRouting(int nodeCount) {
+    const int rounds = 200, tanksPerRound = 3;
+    Graph base;
+    vector<int> district = buildDistrictNetwork(base, nodeCount);
+    vector<int> path;
+    size_t hopsTree = 0, hopsZoned = 0;
+
+    auto run = [&](bool zoned, size_t& hops) {
+        Graph g = base;
+        g.zones().setZones(district);
+        if (zoned) g.findZonedPath(0, 1, path); // zone trees and overlay, outside the timing
+        else g.routeTree(0);
+        SplitMix64 r(11);
+        auto start = chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            int idx = static_cast<int>(r.next() % g.edges.size());
+            g.setEdgeActive(idx, !g.edges[idx].active);
+            for (int k = 0; k < tanksPerRound; ++k) {
+                int tank = 1 + static_cast<int>(r.next() % (nodeCount - 1));
+                bool ok = zoned ? g.findZonedPath(0, tank, path) : g.extractPath(g.routeTree(0), tank, path);
+                if (ok) hops += path.size();
+            }
+        }
+        return secondsSince(start);
+    };
+    double treeSec = run(false, hopsTree);
+    double zonedSec = run(true, hopsZoned);
+    cout << "nodes=" << nodeCount << " districts=" << district.back() + 1 << " tree=" << treeSec / rounds * 1e3
+         << " ms/toggle zoned=" << zonedSec / rounds * 1e3 << " ms/toggle, hops "
+         << (hopsTree == hopsZoned ? "match" : "DIFFER") << "\n";
+}
+
+// A SCADA-style replay of valve and active-flag changes: one edit call per change against a
+// single applyEdits batch. Both end with the CSR rebuild the next step would trigger, and the
+// batch's patched adjacency must match a full rebuild.
+static void benchEditBatch(int nodeCount) {
+    Graph single, batched;
+    buildNetwork(single, nodeCount, true);
+    buildNetwork(batched, nodeCount, true);
+    const size_t changes = min<size_t>(100000, single.edges.size());
+    SplitMix64 pick(42);
+    vector<int> picked(changes);
+    for (auto& idx : picked) idx = static_cast<int>(pick.next() % single.edges.size());
+
+    auto start = chrono::steady_clock::now();
+    for (size_t k = 0; k < changes; ++k) {
+        const Edge& e = single.edges[picked[k]];
+        if (k % 2) single.editEdgeStatus(e.from, e.to, k % 4 == 1);
+        else single.editEdgeValve(e.from, e.to, static_cast<int>(k % 3));
+    }
+    single.topology();
+    double singleSec = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    EditBatch batch;
+    batch.edits.reserve(changes);
+    for (size_t k = 0; k < changes; ++k) {
+        const Edge& e = batched.edges[picked[k]];
+        if (k % 2) batch.setEdgeActive(e.from, e.to, k % 4 == 1);
+        else batch.setEdgeValve(e.from, e.to, static_cast<int>(k % 3));
+    }
+    batched.applyEdits(batch);
+    batched.topology();
+    double batchSec = secondsSince(start);
+
+    vector<vector<int>> patched;
+    for (const auto& n : batched.nodes) patched.push_back(n.outgoingEdges);
+    batched.rebuildOutgoingEdges();
+    bool same = batched.topology().targets == single.topology().targets;
+    for (size_t i = 0; i < batched.nodes.size(); ++i) same = same && patched[i] == batched.nodes[i].outgoingEdges;
+    cout << "nodes=" << nodeCount << " changes=" << changes << " per-edit=" << singleSec * 1e3
+         << " ms (" << changes << " log records) batch=" << batchSec * 1e3 << " ms (1 log record) adjacency="
+         << (same ? "ok" : "MISMATCH") << "\n";
+}
+
+// Fixed 30 s stepping against the discrete-event engine over the same simulated horizon, with
+// demand low enough that only some tanks reach the prescribed level (the steady-state case).
+static void benchEventDriven(int nodeCount) {
+    const double horizonSec = 4 * 3600.0;
+    const int intervalSec = 30;
+    const double maxReductionPerHour = 250.0;
+    Graph stepped;
+    buildNetwork(stepped, nodeCount, true);
+    stepped.setNodeLevel(0, 1e12);
+    for (int id = 1; id < nodeCount; ++id) stepped.setNodeLevel(id, 900);
+    Graph evented = stepped;
+    Graph backlog = stepped; // every tank starts below prescribedLevel, so the wait queue holds them all
+    for (int id = 1; id < nodeCount; ++id) backlog.setNodeLevel(id, 50 + id % 100);
+
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < horizonSec; t += intervalSec) stepped.simulateStep(intervalSec, 0, maxReductionPerHour, 200.0);
+    double stepSec = secondsSince(start);
+
+    EventSimConfig config;
+    config.maxReductionPerHour = maxReductionPerHour;
+    start = chrono::steady_clock::now();
+    EventSimulation des(evented, config);
+    des.runUntil(horizonSec);
+    double desSec = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    EventSimulation queued(backlog, config);
+    queued.runUntil(horizonSec);
+    double queuedSec = secondsSince(start);
+
+    cout << "nodes=" << nodeCount << " horizon=" << horizonSec / 3600 << " h stepper=" << stepSec * 1e3
+         << " ms (" << nodeCount * static_cast<long long>(horizonSec / intervalSec) << " node-ticks) event-driven="
+         << desSec * 1e3 << " ms (" << des.stats().events << " events, " << des.stats().refillsCompleted << " refills)"
+         << " backlog=" << queuedSec * 1e9 / static_cast<double>(queued.stats().events) << " ns/event ("
+         << queued.stats().refillsCompleted << " refills)\n";
+}
+
+// Same ensemble on pools of 1, 2, 4, ... threads; the result must not depend on the thread count.
+static void benchEnsemble(int nodeCount, size_t runs) {
+    Graph g;
+    buildNetwork(g, nodeCount, true);
+    for (int id = 1; id < nodeCount; ++id) g.setNodeLevel(id, 600);
+    EnsembleConfig config;
+    config.runs = runs;
+    config.steps = 8;
+
+    // at least four threads, so a single-core machine still checks that runs sharing a worker's
+    // clone do not leak state into each other
+    vector<unsigned> threadCounts;
+    unsigned hw = max(4u, thread::hardware_concurrency());
+    for (unsigned t = 1; t < hw; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(hw);
+
+    // the second pass loses half of what enters pipe 0->1 and adds a sound main 0->2 beside it,
+    // so the detector flags 0->1 within each run and steers later refills around it
+    for (int leak = 0; leak < 2; ++leak) {
+        if (leak) {
+            g.addEdge(0, 2, 100, 70);
+            g.setEdgeLoss(0, 1, 0.5);
+        }
+        double baseRate = 0.0;
+        EnsembleResult reference;
+        for (unsigned t : threadCounts) {
+            ThreadPool pool(t);
+            g.workerPool = &pool;
+            EnsembleResult r = g.runEnsemble(config);
+            g.workerPool = nullptr;
+            bool same = true;
+            if (t == 1) {
+                baseRate = r.runsPerSecond;
+                reference = r;
+            } else {
+                for (size_t i = 0; i < r.tanks.size(); ++i) {
+                    same = same && r.tanks[i].runsBelowPrescribed == reference.tanks[i].runsBelowPrescribed &&
+                           r.tanks[i].runsEmptied == reference.tanks[i].runsEmptied &&
+                           r.tanks[i].leakAlerts == reference.tanks[i].leakAlerts;
+                }
+            }
+            double below = 0.0;
+            unsigned long long alerts = 0;
+            for (const auto& tank : r.tanks) {
+                below += tank.probabilityBelowPrescribed;
+                alerts += tank.leakAlerts;
+            }
+            cout << "nodes=" << nodeCount << " runs=" << runs << " leak=" << (leak ? "0->1" : "none") << " threads=" << t
+                 << " runs/s=" << r.runsPerSecond << " speedup=" << r.runsPerSecond / baseRate
+                 << " steals=" << r.steals << " mean P(below)=" << below / max<size_t>(1, r.tanks.size())
+                 << " leak alerts=" << alerts << " identical=" << (same ? "yes" : "NO") << "\n";
+        }
+    }
+}
+
+// Writes the buildNetwork shape as CSV files, then times importCsv against them.
+static void benchCsvImport(int nodeCount) {
+    const string nodesPath = "/tmp/graph_bench_nodes.csv";
+    const string pipesPath = "/tmp/graph_bench_pipes.csv";
+    FILE* nf = fopen(nodesPath.c_str(), "w");
+    FILE* pf = fopen(pipesPath.c_str(), "w");
+    if (!nf || !pf) {
+        if (nf) fclose(nf);
+        if (pf) fclose(pf);
+        cout << "cannot write CSV files\n";
+        return;
+    }
+    fprintf(nf, "id,name,type,capacity,initialLevel\n0,Reservoir,Tank,1e12,1e12\n");
+    fprintf(pf, "from,to,capacity,flowRate,valve\n");
+    for (int id = 1; id < nodeCount; ++id) {
+        // every tenth row is fully quoted, with an escaped quote in the name
+        if (id % 10 == 0) {
+            fprintf(nf, "\"%d\",\"Tank \"\"%d\"\"\",\"Tank\",\"1000\",\"1000\"\n", id, id);
+            fprintf(pf, "\"%d\",\"%d\",\"100\",\"70\",\"1\"\n", id / 2, id);
+        } else {
+            fprintf(nf, "%d,Tank %d,Tank,1000,1000\n", id, id);
+            fprintf(pf, "%d,%d,100,70,1\n", id / 2, id);
+        }
+        if (id + 7 < nodeCount && (id + 7) / 2 != id) fprintf(pf, "%d,%d,50,40,1\n", id, id + 7);
+    }
+    fclose(nf);
+    fclose(pf);
+
+    Graph g;
+    auto start = chrono::steady_clock::now();
+    ImportReport report = g.importCsv(nodesPath, pipesPath);
+    double sec = secondsSince(start);
+    remove(nodesPath.c_str());
+    remove(pipesPath.c_str());
+
+    bool quotedOk = report.nodesImported == static_cast<size_t>(nodeCount) && report.malformedRows == 0;
+    for (int id = 10; quotedOk && id < nodeCount; id += 10) {
+        const Node* n = g.getNodeById(id);
+        quotedOk = n && n->name == "Tank \"" + to_string(id) + "\"" && g.getNodeLevel(id) == 1000 &&
+                   g.getEdgeIndex(id / 2, id) != -1;
+    }
+
+    size_t rows = report.nodesImported + report.edgesImported;
+    cout << "nodes=" << report.nodesImported << " pipes=" << report.edgesImported
+         << " import=" << sec * 1e3 << " ms rows/s=" << rows / sec
+         << " errors=" << report.errors.size() << " quoted=" << (quotedOk ? "ok" : "MISMATCH") << "\n";
+}
+
+int main(int argc, char** argv) {
+    vector<int> sizes = {1000, 10000, 50000, 100000};
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i) sizes.push_back(atoi(argv[i]));
+    }
+    cout << "== lookup index ==\n";
+    for (int n : sizes) benchLookups(n);
+    cout << "== adjacency maintenance ==\n";
+    for (int n : sizes) benchAdjacency(n);
+    cout << "== findPath (CSR BFS) ==\n";
+    for (int n : sizes) benchFindPath(n);
+    cout << "== routing tree vs per-tank BFS ==\n";
+    for (int n : sizes) benchRouteTree(n, min(n - 1, 1000));
+    cout << "== allocation: greedy path vs max-flow ==\n";
+    for (int n : sizes) benchAllocation(n);
+    cout << "== batched parallel refills ==\n";
+    for (int n : sizes) benchBatchedRefill(n);
+    cout << "== leak localisation ==\n";
+    for (int n : sizes) benchLeakLocalisation(n, 200);
+    benchMaxFlowLeak();
+    cout << "== consumption (updateTankLevels) ==\n";
+    for (int n : sizes) benchConsumption(n * 5);
+    cout << "== binary network file ==\n";
+    for (int n : sizes) benchBinaryIo(n * 5);
+    cout << "== time-series recorder ==\n";
+    for (int n : sizes) benchTimeSeries(n);
+    cout << "== seeded run record and replay ==\n";
+    for (int n : sizes) benchReplay(n);
+    cout << "== zoned routing after pipe toggles ==\n";
+    for (int n : sizes) benchZonedRouting(n);
+    cout << "== widest-bottleneck vs BFS routing tree ==\n";
+    for (int n : sizes) benchWidestRouting(n, min(n - 1, 1000));
+    cout << "== batched edits ==\n";
+    for (int n : sizes) benchEditBatch(n);
+    cout << "== fixed-interval stepper vs discrete-event engine ==\n";
+    for (int n : sizes) benchEventDriven(n);
+    cout << "== Monte Carlo ensemble scaling ==\n";
+    for (int n : sizes) benchEnsemble(n, max<size_t>(64, 400000 / n));
+    cout << "== CSV import ==\n";
+    for (int n : sizes) benchCsvImport(n * 10);
+    cout << "== event log ==\n";
+    benchLogging();
+    cout << "== level kernels: AoS vs SoA ==\n";
+    for (int n : sizes) benchKernels(n * 5);
+    return 0;
+}
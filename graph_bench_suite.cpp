@@ -0,0 +1,285 @@
+#include "graph.h"
+#include "graph_metrics.h"
+#include "graph_random.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+
+using namespace std;
+
+// Regression suite for the hot entry points, in the spirit of Google Benchmark: every case is run
+// until it has been timed for at least --min-time seconds and reports ns/op, allocations/op and
+// ops/sec (steps/sec for simulateStep). Networks come from three synthetic generators sized by pipe
+// count. `make bench` runs it and writes the results as JSON; compare two JSON files to spot
+// regressions between releases. Usage:
+//   graph_bench_suite [--json <file>] [--min-time <sec>] [edges...]   (default edges 1k 10k 100k 1M)
+
+// ---------------- allocation counting ----------------
+
+// Every global allocation in the process is counted; a case reports the difference across its
+// timed region, divided by the operations it ran. A METRICS=1 build already replaces operator new
+// in graph_metrics.cpp, so the suite reads that counter instead.
+#ifdef GRAPH_METRICS
+static unsigned long long allocCount() { return metricCounterValue(MetricCounter::Allocations); }
+static unsigned long long allocBytes() { return metricCounterValue(MetricCounter::AllocatedBytes); }
+#else
+static atomic<unsigned long long> allocCounter{0};
+static atomic<unsigned long long> allocByteCounter{0};
+static unsigned long long allocCount() { return allocCounter.load(); }
+static unsigned long long allocBytes() { return allocByteCounter.load(); }
+
+void* operator new(size_t size) {
+    allocCounter.fetch_add(1, memory_order_relaxed);
+    allocByteCounter.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
+
+// ---------------- network generators ----------------
+
+enum class Shape { Grid, Tree, ScaleFree };
+
+static const char* shapeName(Shape shape) {
+    switch (shape) {
+        case Shape::Grid: return "grid";
+        case Shape::Tree: return "tree";
+        case Shape::ScaleFree: return "scalefree";
+    }
+    return "?";
+}
+
+// Networks with about edgeCount pipes, all reachable from node 0 (the reservoir):
+// - Grid: a square lattice, pipes running right and down
+// - Tree: a binary tree fed from the root
+// - ScaleFree: preferential attachment, each new node fed by two earlier nodes picked in
+//   proportion to their degree (Barabasi-Albert, m = 2); a few hubs, many leaves
+static int shapeNodeCount(Shape shape, int edgeCount) {
+    if (shape == Shape::Grid) {
+        int side = max(2, static_cast<int>(sqrt(edgeCount / 2.0)));
+        return side * side;
+    }
+    if (shape == Shape::Tree) return edgeCount + 1;
+    return max(3, edgeCount / 2);
+}
+
+static void addShapeNodes(Graph& g, Shape shape, int edgeCount) {
+    int nodeCount = shapeNodeCount(shape, edgeCount);
+    for (int id = 0; id < nodeCount; ++id) {
+        g.addNode(id, "N" + to_string(id), NodeType::Tank, id == 0 ? 1e12 : 1000);
+    }
+}
+
+static void addShapePipes(Graph& g, Shape shape, int edgeCount) {
+    const int nodeCount = shapeNodeCount(shape, edgeCount);
+    if (shape == Shape::Grid) {
+        int side = static_cast<int>(sqrt(static_cast<double>(nodeCount)) + 0.5);
+        for (int r = 0; r < side; ++r) {
+            for (int c = 0; c < side; ++c) {
+                int id = r * side + c;
+                if (c + 1 < side) g.addEdge(id, id + 1, 100, 70);
+                if (r + 1 < side) g.addEdge(id, id + side, 100, 70);
+            }
+        }
+    } else if (shape == Shape::Tree) {
+        for (int id = 1; id < nodeCount; ++id) g.addEdge((id - 1) / 2, id, 100, 70);
+    } else {
+        SplitMix64 rng(12345);
+        vector<int> endpoints = {0, 1, 0, 2, 1, 2}; // one entry per pipe end, so picks follow degree
+        g.addEdge(0, 1, 1000, 1000);
+        g.addEdge(0, 2, 1000, 1000);
+        g.addEdge(1, 2, 100, 70);
+        for (int id = 3; id < nodeCount; ++id) {
+            int a = endpoints[rng.next() % endpoints.size()];
+            int b = endpoints[rng.next() % endpoints.size()];
+            g.addEdge(a, id, 100, 70);
+            endpoints.push_back(a);
+            endpoints.push_back(id);
+            if (b != a) {
+                g.addEdge(b, id, 100, 70);
+                endpoints.push_back(b);
+                endpoints.push_back(id);
+            }
+        }
+    }
+}
+
+static void buildShape(Graph& g, Shape shape, int edgeCount) {
+    g.beginBulkLoad();
+    addShapeNodes(g, shape, edgeCount);
+    addShapePipes(g, shape, edgeCount);
+    g.endBulkLoad();
+}
+
+// ---------------- harness ----------------
+
+struct CaseResult {
+    string name;
+    string shape;
+    int nodes = 0;
+    int edges = 0;
+    unsigned long long iterations = 0; // operations timed
+    double seconds = 0;
+    unsigned long long allocs = 0;
+    unsigned long long bytes = 0;
+};
+
+static double minTimeSec = 0.2;
+static vector<CaseResult> results;
+
+// Runs setup (untimed) then body (timed) until the timed total reaches minTimeSec. body returns
+// the number of operations it performed.
+static void runCase(const string& name, const char* shape, const Graph* g,
+                    const function<void()>& setup, const function<unsigned long long()>& body) {
+    CaseResult r;
+    r.name = name;
+    r.shape = shape;
+    do {
+        setup();
+        unsigned long long allocs0 = allocCount(), bytes0 = allocBytes();
+        auto start = chrono::steady_clock::now();
+        r.iterations += body();
+        r.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        r.allocs += allocCount() - allocs0;
+        r.bytes += allocBytes() - bytes0;
+    } while (r.seconds < minTimeSec);
+    if (g) {
+        r.nodes = static_cast<int>(g->nodes.size());
+        r.edges = static_cast<int>(g->edges.size());
+    }
+
+    double ops = static_cast<double>(max(1ULL, r.iterations));
+    cout << left;
+    cout.width(36);
+    cout << (name + "/" + shape + "/" + to_string(r.edges)) << right
+         << " ns/op=" << r.seconds * 1e9 / ops
+         << " allocs/op=" << r.allocs / ops
+         << " ops/sec=" << ops / r.seconds << "\n";
+    results.push_back(r);
+}
+
+static bool writeJson(const string& path) {
+    ofstream out(path);
+    if (!out) {
+        cerr << "Cannot write " << path << "\n";
+        return false;
+    }
+    out << "{\n  \"context\": {\"threads\": " << ThreadPool::shared().size()
+        << ", \"min_time_sec\": " << minTimeSec << "},\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const CaseResult& r = results[i];
+        double ops = static_cast<double>(max(1ULL, r.iterations));
+        out << "    {\"name\": \"" << r.name << "/" << r.shape << "/" << r.edges << "\""
+            << ", \"case\": \"" << r.name << "\", \"shape\": \"" << r.shape << "\""
+            << ", \"nodes\": " << r.nodes << ", \"edges\": " << r.edges
+            << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.seconds * 1e9 / ops
+            << ", \"allocs_per_op\": " << r.allocs / ops
+            << ", \"bytes_per_op\": " << r.bytes / ops
+            << ", \"ops_per_sec\": " << ops / r.seconds << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// ---------------- cases ----------------
+
+static void benchShape(Shape shape, int edgeCount) {
+    const char* name = shapeName(shape);
+
+    // addEdge: incremental inserts with the adjacency kept current, one op per pipe
+    {
+        Graph g;
+        runCase("addEdge", name, &g, [&] {
+            g = Graph();
+            addShapeNodes(g, shape, edgeCount);
+        }, [&] {
+            addShapePipes(g, shape, edgeCount);
+            return static_cast<unsigned long long>(g.edges.size());
+        });
+    }
+
+    Graph g;
+    buildShape(g, shape, edgeCount);
+    g.rng.seed(42);
+    for (size_t slot = 1; slot < g.nodes.size(); ++slot) g.state.level[slot] = 500;
+    const int nodeCount = static_cast<int>(g.nodes.size());
+
+    // fixed spread of targets reachable from the reservoir
+    vector<int> targets;
+    vector<vector<int>> paths;
+    SplitMix64 pick(7);
+    vector<int> path;
+    while (targets.size() < 256 && targets.size() < static_cast<size_t>(nodeCount - 1)) {
+        int id = 1 + static_cast<int>(pick.next() % (nodeCount - 1));
+        if (!g.findPath(0, id, path)) continue;
+        targets.push_back(id);
+        paths.push_back(path);
+    }
+
+    runCase("findPath", name, &g, [] {}, [&] {
+        for (int id : targets) g.findPath(0, id, path);
+        return static_cast<unsigned long long>(targets.size());
+    });
+
+    runCase("supplyWaterAlongPath", name, &g, [&] {
+        for (int id : targets) g.setNodeLevel(id, 0);
+    }, [&] {
+        for (const auto& p : paths) g.supplyWaterAlongPath(0, p, 30);
+        return static_cast<unsigned long long>(paths.size());
+    });
+
+    runCase("updateTankLevels", name, &g, [&] {
+        for (size_t slot = 1; slot < g.state.size(); ++slot) g.state.level[slot] = 500;
+    }, [&] {
+        g.updateTankLevels(30, 10000.0);
+        return 1ULL;
+    });
+
+    runCase("simulateStep", name, &g, [&] {
+        for (size_t slot = 1; slot < g.state.size(); ++slot) g.state.level[slot] = 500;
+    }, [&] {
+        for (int i = 0; i < 10; ++i) g.simulateStep(30, 0, 10000.0, 200.0);
+        return 10ULL;
+    });
+}
+
+static void benchPushLog() {
+    Graph g;
+    const string message = "Tank 42 refilled from the reservoir";
+    runCase("pushLog", "none", nullptr, [] {}, [&] {
+        for (int i = 0; i < 100000; ++i) g.pushLog(message);
+        return 100000ULL;
+    });
+}
+
+int main(int argc, char** argv) {
+    vector<int> sizes;
+    string jsonPath;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc) minTimeSec = atof(argv[++i]);
+        else sizes.push_back(atoi(argv[i]));
+    }
+    if (sizes.empty()) sizes = {1000, 10000, 100000, 1000000};
+
+    benchPushLog();
+    for (int edges : sizes) {
+        for (Shape shape : {Shape::Grid, Shape::Tree, Shape::ScaleFree}) benchShape(shape, edges);
+    }
+    if (!jsonPath.empty()) {
+        if (!writeJson(jsonPath)) return 1;
+        cout << "Results written to " << jsonPath << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,552 @@
+#include "graph_checkpoint.h"
+#include "graph.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------- checkpoint file ----------------
+//
+// File:    magic "WNETCKP1", version u32, pad u32, then records back to back.
+// Record:  kind u32 (0 full, 1 delta), sequence u64, payloadBytes u64, checksum u64 (FNV-1a of
+//          the payload), payload.
+// Payload: simTimeSec i32, rng seed u64, rng counter u64,
+//          nodeCount u64, edgeCount u64,
+//          levels:  dense u8; dense -> f64[nodeCount], else count u64 + count * (slot u32, f64)
+//          node capacities: same encoding as levels
+//          edges:   dense u8; dense -> edgeCount * edge, else count u64 + count * (index u32, edge)
+//                   where edge = active u8, valve i32, capacity f64, flowRate f64, lossFraction f64,
+//                   then the leak detector's stats: loss, cusum, blame, cleanEvidence f64,
+//                   observations u32, flagged u8
+//          history: capacity u64, totalPushed u64, reset u8, count u64, count * record where
+//                   record = kind u8, simTimeSec i32, nodeId i32, aux i32, aux2 i32, f64[4],
+//                   and Message records add textBytes u32 + text
+// A full record is dense everywhere with reset = 1; a delta applies on top of the records
+// before it. Sequences are consecutive, so a gap, a bad checksum or a record that does not parse
+// ends the replay.
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = {'W', 'N', 'E', 'T', 'C', 'K', 'P', '1'};
+// 1 stored a std::mt19937 state as text, 2 had no node capacity or pipe capacity/flow rate columns,
+// 3 had no simulated leaks or leak detector stats
+const uint32_t CHECKPOINT_VERSION = 4;
+const size_t FILE_HEADER_BYTES = 16;
+const size_t RECORD_HEADER_BYTES = 28;
+const uint32_t RECORD_FULL = 0;
+const uint32_t RECORD_DELTA = 1;
+const size_t MAX_QUEUED_CHECKPOINTS = 4; // checkpoint() waits for the writer beyond this
+
+uint64_t fnv1a(const unsigned char* p, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+struct ByteWriter {
+    vector<unsigned char> buf;
+
+    template <typename T>
+    void put(T value) {
+        size_t at = buf.size();
+        buf.resize(at + sizeof(T));
+        memcpy(buf.data() + at, &value, sizeof(T));
+    }
+    void putBytes(const void* p, size_t n) {
+        const unsigned char* b = static_cast<const unsigned char*>(p);
+        buf.insert(buf.end(), b, b + n);
+    }
+    template <typename T>
+    void patch(size_t at, T value) { memcpy(buf.data() + at, &value, sizeof(T)); }
+};
+
+// Bounds-checked reads; once a read runs past the end every later read fails too.
+struct ByteReader {
+    const unsigned char* p;
+    size_t n;
+    size_t at = 0;
+    bool ok = true;
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (!ok || n - at < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, p + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+    const unsigned char* take(size_t bytes) {
+        if (!ok || n - at < bytes) {
+            ok = false;
+            return nullptr;
+        }
+        const unsigned char* r = p + at;
+        at += bytes;
+        return r;
+    }
+};
+
+void putHistoryRecord(ByteWriter& w, const LogEntry& e, const string& text) {
+    w.put<uint8_t>(static_cast<uint8_t>(e.kind));
+    w.put<int32_t>(e.simTimeSec);
+    w.put<int32_t>(e.nodeId);
+    w.put<int32_t>(e.aux);
+    w.put<int32_t>(e.aux2);
+    w.putBytes(e.value, sizeof(e.value));
+    if (e.kind == LogKind::Message) {
+        w.put<uint32_t>(static_cast<uint32_t>(text.size()));
+        w.putBytes(text.data(), text.size());
+    }
+}
+
+// Reads one history record; it is pushed into log only when apply is set.
+bool readHistoryRecord(ByteReader& r, EventLog& log, bool apply) {
+    LogEntry e;
+    e.kind = static_cast<LogKind>(r.get<uint8_t>());
+    e.simTimeSec = r.get<int32_t>();
+    e.nodeId = r.get<int32_t>();
+    e.aux = r.get<int32_t>();
+    e.aux2 = r.get<int32_t>();
+    const unsigned char* values = r.take(sizeof(e.value));
+    if (!values) return false;
+    memcpy(e.value, values, sizeof(e.value));
+    if (e.kind == LogKind::Message) {
+        uint32_t len = r.get<uint32_t>();
+        const unsigned char* text = r.take(len);
+        if (!text) return false;
+        if (apply) log.pushMessage(e.simTimeSec, string(reinterpret_cast<const char*>(text), len));
+    } else if (apply) {
+        log.push(e);
+    }
+    return r.ok;
+}
+
+bool sameBits(double a, double b) { return memcmp(&a, &b, sizeof(double)) == 0; }
+
+bool sameLeakStats(const PipeLeakStats& a, const PipeLeakStats& b) {
+    return sameBits(a.loss, b.loss) && sameBits(a.cusum, b.cusum) && sameBits(a.blame, b.blame) &&
+           sameBits(a.cleanEvidence, b.cleanEvidence) && a.observations == b.observations && a.flagged == b.flagged;
+}
+
+void putLeakStats(ByteWriter& w, const PipeLeakStats& p) {
+    w.put<double>(p.loss);
+    w.put<double>(p.cusum);
+    w.put<double>(p.blame);
+    w.put<double>(p.cleanEvidence);
+    w.put<uint32_t>(p.observations);
+    w.put<uint8_t>(p.flagged ? 1 : 0);
+}
+
+PipeLeakStats readLeakStats(ByteReader& r) {
+    PipeLeakStats p;
+    p.loss = r.get<double>();
+    p.cusum = r.get<double>();
+    p.blame = r.get<double>();
+    p.cleanEvidence = r.get<double>();
+    p.observations = r.get<uint32_t>();
+    p.flagged = r.get<uint8_t>() != 0;
+    return p;
+}
+
+bool writeAll(int fd, const unsigned char* p, size_t n) {
+    size_t written = 0;
+    while (written < n) {
+        ssize_t w = ::write(fd, p + written, n - written);
+        if (w <= 0) return false;
+        written += static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// Writes a per-slot f64 column: only the slots whose bits changed since last, or the whole column
+// when the record is full or more than half changed. last is updated to the current values.
+void putColumn(ByteWriter& w, const vector<double>& values, vector<double>& last, bool full, vector<uint32_t>& changed) {
+    const size_t n = values.size();
+    changed.clear();
+    if (!full) {
+        for (size_t i = 0; i < n; ++i) {
+            if (memcmp(&values[i], &last[i], sizeof(double)) != 0) changed.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    if (full || changed.size() * 2 > n) {
+        w.put<uint8_t>(1);
+        w.putBytes(values.data(), n * sizeof(double));
+    } else {
+        w.put<uint8_t>(0);
+        w.put<uint64_t>(changed.size());
+        for (uint32_t slot : changed) {
+            w.put<uint32_t>(slot);
+            w.put<double>(values[slot]);
+        }
+    }
+    last = values;
+}
+
+bool readColumn(ByteReader& r, vector<double>& column, uint64_t n, bool apply) {
+    if (r.get<uint8_t>()) {
+        const unsigned char* values = r.take(n * sizeof(double));
+        if (!values) return false;
+        if (apply) memcpy(column.data(), values, n * sizeof(double));
+        return true;
+    }
+    uint64_t count = r.get<uint64_t>();
+    for (uint64_t k = 0; k < count && r.ok; ++k) {
+        uint32_t slot = r.get<uint32_t>();
+        double value = r.get<double>();
+        if (slot >= n) return false;
+        if (apply) column[slot] = value;
+    }
+    return r.ok;
+}
+
+// Run state being rebuilt from the file before it is installed into the graph.
+struct RestoredState {
+    int simTimeSec = 0;
+    CounterRng rng;
+    vector<double> level;
+    vector<double> capacity;
+    vector<unsigned char> active;
+    vector<int> valve;
+    vector<double> edgeCapacity;
+    vector<double> flowRate;
+    vector<double> loss;
+    vector<PipeLeakStats> leakStats;
+    EventLog history;
+};
+
+// Parses one record's payload. With apply unset it only checks that the record is well formed
+// against s; restore runs that pass first and then applies the record to s in place, so a record
+// that would fail half way never touches the last good state and no copy of it is needed.
+bool readPayload(ByteReader r, bool full, RestoredState& s, bool apply) {
+    const int simTimeSec = r.get<int32_t>();
+    const uint64_t key = r.get<uint64_t>();
+    const uint64_t counter = r.get<uint64_t>();
+    uint64_t n = r.get<uint64_t>();
+    uint64_t m = r.get<uint64_t>();
+    if (!r.ok) return false;
+    if (full) {
+        // every column is dense, so the payload bounds the counts
+        if (n > r.n / sizeof(double) || m > r.n / sizeof(double)) return false;
+        if (apply) {
+            s = RestoredState();
+            s.level.assign(n, 0.0);
+            s.capacity.assign(n, 0.0);
+            s.active.assign(m, 1);
+            s.valve.assign(m, 0);
+            s.edgeCapacity.assign(m, 0.0);
+            s.flowRate.assign(m, 0.0);
+            s.loss.assign(m, 0.0);
+            s.leakStats.assign(m, PipeLeakStats());
+        }
+    } else if (n != s.level.size() || m != s.active.size()) {
+        return false;
+    }
+    if (apply) {
+        s.simTimeSec = simTimeSec;
+        s.rng.key = key;
+        s.rng.counter = counter;
+    }
+
+    if (!readColumn(r, s.level, n, apply) || !readColumn(r, s.capacity, n, apply)) return false;
+
+    bool denseEdges = r.get<uint8_t>() != 0;
+    uint64_t edgeCount = denseEdges ? m : r.get<uint64_t>();
+    for (uint64_t k = 0; k < edgeCount && r.ok; ++k) {
+        uint32_t idx = denseEdges ? static_cast<uint32_t>(k) : r.get<uint32_t>();
+        uint8_t active = r.get<uint8_t>();
+        int32_t valve = r.get<int32_t>();
+        double edgeCapacity = r.get<double>();
+        double flowRate = r.get<double>();
+        double loss = r.get<double>();
+        PipeLeakStats leakStats = readLeakStats(r);
+        if (idx >= m) return false;
+        if (!apply) continue;
+        s.active[idx] = active;
+        s.valve[idx] = valve;
+        s.edgeCapacity[idx] = edgeCapacity;
+        s.flowRate[idx] = flowRate;
+        s.loss[idx] = loss;
+        s.leakStats[idx] = leakStats;
+    }
+
+    uint64_t capacity = r.get<uint64_t>();
+    uint64_t total = r.get<uint64_t>();
+    bool reset = r.get<uint8_t>() != 0;
+    uint64_t count = r.get<uint64_t>();
+    if (!r.ok) return false;
+    if (apply && reset) s.history.setCapacity(capacity);
+    for (uint64_t k = 0; k < count; ++k) {
+        if (!readHistoryRecord(r, s.history, apply)) return false;
+    }
+    if (apply) s.history.setTotalPushed(total);
+    return r.ok && r.at == r.n;
+}
+
+} // namespace
+
+Checkpointer::Checkpointer(const string& path, unsigned fullInterval)
+    : path(path), fullInterval(fullInterval ? fullInterval : 1) {
+    writer = std::thread([this] { writerLoop(); });
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    if (fd >= 0) ::close(fd);
+}
+
+// Captures the run state. Levels and capacities are compared bit for bit, so only slots whose
+// value actually changed go into a delta; when more than half changed the column is written
+// densely instead. A pipe goes into a delta when any of its fields or its leak detector stats changed.
+void Checkpointer::checkpoint(const Graph& g) {
+    const size_t n = g.state.size(), m = g.edges.size();
+    bool full = !hasBase || needFull.exchange(false) || sinceFull + 1 >= fullInterval ||
+                n != lastLevel.size() || m != lastActive.size() || g.history.capacity() != lastHistoryCapacity;
+
+    ByteWriter w;
+    w.put<uint32_t>(full ? RECORD_FULL : RECORD_DELTA);
+    w.put<uint64_t>(sequence);
+    w.put<uint64_t>(0); // payload size, patched below
+    w.put<uint64_t>(0); // checksum, patched below
+
+    w.put<int32_t>(g.simTimeSec);
+    w.put<uint64_t>(g.rng.key);
+    w.put<uint64_t>(g.rng.counter);
+    w.put<uint64_t>(n);
+    w.put<uint64_t>(m);
+
+    // levels and node capacities
+    vector<uint32_t> changed;
+    putColumn(w, g.state.level, lastLevel, full, changed);
+    putColumn(w, g.state.capacity, lastCapacity, full, changed);
+
+    // edge active/valve flags, capacities, flow rates, simulated leaks and detector stats
+    static const PipeLeakStats noStats;
+    auto leakStats = [&g](size_t i) -> const PipeLeakStats& {
+        const PipeLeakStats* p = g.leaks.stats(static_cast<int>(i));
+        return p ? *p : noStats;
+    };
+    changed.clear();
+    if (!full) {
+        for (size_t i = 0; i < m; ++i) {
+            const Edge& e = g.edges[i];
+            if (e.active != (lastActive[i] != 0) || e.valveStatus != lastValve[i] ||
+                !sameBits(e.capacity, lastEdgeCapacity[i]) || !sameBits(e.flowRate, lastFlowRate[i]) ||
+                !sameBits(e.lossFraction, lastLoss[i]) || !sameLeakStats(leakStats(i), lastLeakStats[i])) {
+                changed.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    } else {
+        for (size_t i = 0; i < m; ++i) changed.push_back(static_cast<uint32_t>(i));
+    }
+    lastActive.resize(m);
+    lastValve.resize(m);
+    lastEdgeCapacity.resize(m);
+    lastFlowRate.resize(m);
+    lastLoss.resize(m);
+    lastLeakStats.resize(m);
+    w.put<uint8_t>(full ? 1 : 0);
+    if (!full) w.put<uint64_t>(changed.size());
+    for (uint32_t idx : changed) {
+        const Edge& e = g.edges[idx];
+        if (!full) w.put<uint32_t>(idx);
+        w.put<uint8_t>(e.active ? 1 : 0);
+        w.put<int32_t>(e.valveStatus);
+        w.put<double>(e.capacity);
+        w.put<double>(e.flowRate);
+        w.put<double>(e.lossFraction);
+        putLeakStats(w, leakStats(idx));
+        lastActive[idx] = e.active ? 1 : 0;
+        lastValve[idx] = e.valveStatus;
+        lastEdgeCapacity[idx] = e.capacity;
+        lastFlowRate[idx] = e.flowRate;
+        lastLoss[idx] = e.lossFraction;
+        lastLeakStats[idx] = leakStats(idx);
+    }
+
+    // history: records pushed since the last checkpoint, or the whole ring if it wrapped past them
+    const EventLog& h = g.history;
+    unsigned long long fresh = h.totalPushed() - lastHistoryTotal;
+    bool reset = full || h.totalPushed() < lastHistoryTotal || fresh > h.size();
+    size_t first = reset ? 0 : h.size() - static_cast<size_t>(fresh);
+    w.put<uint64_t>(h.capacity());
+    w.put<uint64_t>(h.totalPushed());
+    w.put<uint8_t>(reset ? 1 : 0);
+    w.put<uint64_t>(h.size() - first);
+    for (size_t i = first; i < h.size(); ++i) putHistoryRecord(w, h[i], h.text(i));
+    lastHistoryTotal = h.totalPushed();
+    lastHistoryCapacity = h.capacity();
+
+    size_t payload = w.buf.size() - RECORD_HEADER_BYTES;
+    w.patch<uint64_t>(12, payload);
+    w.patch<uint64_t>(20, fnv1a(w.buf.data() + RECORD_HEADER_BYTES, payload));
+
+    hasBase = true;
+    sinceFull = full ? 0 : sinceFull + 1;
+    ++sequence;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    drained.wait(lock, [this] { return queue.size() < MAX_QUEUED_CHECKPOINTS; });
+    queue.push_back(Job{full, std::move(w.buf)});
+    wake.notify_one();
+}
+
+bool Checkpointer::flush() {
+    std::unique_lock<std::mutex> lock(mtx);
+    drained.wait(lock, [this] { return queue.empty() && !writing; });
+    bool ok = !writeFailed;
+    writeFailed = false;
+    return ok;
+}
+
+void Checkpointer::writerLoop() {
+    bool broken = false; // a write failed; deltas are useless until the next full record
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return; // stopping with nothing left to write
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        writing = true;
+        lock.unlock();
+        drained.notify_all();
+
+        bool ok;
+        if (job.full) ok = writeFull(job.bytes);
+        else ok = !broken && appendDelta(job.bytes);
+        broken = !ok;
+        if (!ok) needFull = true;
+
+        lock.lock();
+        writing = false;
+        if (!ok) writeFailed = true;
+        drained.notify_all();
+    }
+}
+
+// Writes the file header and a full record to a temporary file and renames it over the
+// checkpoint file, then keeps it open for the deltas that follow.
+bool Checkpointer::writeFull(const vector<unsigned char>& bytes) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    unsigned char header[FILE_HEADER_BYTES] = {};
+    memcpy(header, CHECKPOINT_MAGIC, 8);
+    memcpy(header + 8, &CHECKPOINT_VERSION, 4);
+
+    const string tmp = path + ".tmp";
+    int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        cerr << "Checkpointer: cannot create " << tmp << "\n";
+        return false;
+    }
+    bool ok = writeAll(out, header, sizeof(header)) && writeAll(out, bytes.data(), bytes.size()) && ::fsync(out) == 0;
+    ok = ::close(out) == 0 && ok;
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        cerr << "Checkpointer: failed to write " << path << "\n";
+        return false;
+    }
+    fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+    return fd >= 0;
+}
+
+bool Checkpointer::appendDelta(const vector<unsigned char>& bytes) {
+    if (fd < 0) return false;
+    if (!writeAll(fd, bytes.data(), bytes.size()) || ::fdatasync(fd) != 0) {
+        cerr << "Checkpointer: failed to append to " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool Checkpointer::restore(Graph& g, const string& path) {
+    int in = ::open(path.c_str(), O_RDONLY);
+    if (in < 0) {
+        cerr << "restore: cannot open " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    vector<unsigned char> file;
+    if (::fstat(in, &st) == 0) file.resize(static_cast<size_t>(st.st_size));
+    size_t got = 0;
+    while (got < file.size()) {
+        ssize_t r = ::read(in, file.data() + got, file.size() - got);
+        if (r <= 0) break;
+        got += static_cast<size_t>(r);
+    }
+    ::close(in);
+    file.resize(got);
+    if (file.size() < FILE_HEADER_BYTES || memcmp(file.data(), CHECKPOINT_MAGIC, 8) != 0) {
+        cerr << "restore: " << path << " is not a checkpoint file\n";
+        return false;
+    }
+    uint32_t version;
+    memcpy(&version, file.data() + 8, 4);
+    if (version != CHECKPOINT_VERSION) {
+        cerr << "restore: unsupported checkpoint version " << version << "\n";
+        return false;
+    }
+
+    RestoredState s;
+    bool haveFull = false;
+    uint64_t expectedSeq = 0;
+    size_t at = FILE_HEADER_BYTES;
+    while (file.size() - at >= RECORD_HEADER_BYTES) {
+        ByteReader hdr{file.data() + at, RECORD_HEADER_BYTES};
+        uint32_t kind = hdr.get<uint32_t>();
+        uint64_t seq = hdr.get<uint64_t>();
+        uint64_t payload = hdr.get<uint64_t>();
+        uint64_t checksum = hdr.get<uint64_t>();
+        const unsigned char* body = file.data() + at + RECORD_HEADER_BYTES;
+        if (payload > file.size() - at - RECORD_HEADER_BYTES || fnv1a(body, payload) != checksum) break;
+        if (kind == RECORD_DELTA && (!haveFull || seq != expectedSeq)) break;
+        if (kind != RECORD_FULL && kind != RECORD_DELTA) break;
+
+        // check the whole record before applying it in place, so one that fails half way leaves
+        // the last good state intact
+        ByteReader r{body, payload};
+        if (!readPayload(r, kind == RECORD_FULL, s, false)) break;
+        readPayload(r, kind == RECORD_FULL, s, true);
+        haveFull = true;
+        expectedSeq = seq + 1;
+        at += RECORD_HEADER_BYTES + payload;
+    }
+    if (!haveFull) {
+        cerr << "restore: no complete checkpoint in " << path << "\n";
+        return false;
+    }
+    if (s.level.size() != g.state.size() || s.active.size() != g.edges.size()) {
+        cerr << "restore: checkpoint has " << s.level.size() << " nodes and " << s.active.size()
+             << " pipes, network has " << g.state.size() << " and " << g.edges.size() << "\n";
+        return false;
+    }
+    g.rng = s.rng;
+    g.simTimeSec = s.simTimeSec;
+    g.state.level = s.level;
+    g.state.capacity = s.capacity;
+    g.leaks.reset();
+    for (size_t i = 0; i < g.edges.size(); ++i) {
+        g.edges[i].active = s.active[i] != 0;
+        g.edges[i].valveStatus = s.valve[i];
+        g.edges[i].capacity = s.edgeCapacity[i];
+        g.edges[i].flowRate = s.flowRate[i];
+        g.edges[i].lossFraction = s.loss[i];
+        if (s.leakStats[i].observations > 0 || s.leakStats[i].flagged) g.leaks.setStats(static_cast<int>(i), s.leakStats[i]);
+    }
+    g.history = std::move(s.history);
+    g.rebuildOutgoingEdges(); // active flags changed; also invalidates the topology snapshot
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef GRAPH_CHECKPOINT_H
+#define GRAPH_CHECKPOINT_H
+
+#include "graph_types.h"
+#include "graph_leaks.h"
+#include "graph_observer.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class Graph;
+
+// Periodic checkpoints of a Graph's run state: simTimeSec, node levels and capacities, pipe
+// active/valve flags, capacities, flow rates and simulated leaks, what the leak detector has
+// learned about each pipe, the rng state and the history ring. The shape of
+// the network (which nodes and pipes exist) is not saved; restore expects the same network, e.g.
+// loaded from the same network file.
+//
+// checkpoint() diffs the state against the previous checkpoint on the calling thread and
+// queues only what changed; a background thread appends the record to the file and syncs
+// it while the simulation carries on. Every fullInterval checkpoints a full record replaces
+// the file atomically, so it does not grow without bound.
+class Checkpointer {
+public:
+    explicit Checkpointer(const string& path, unsigned fullInterval = 64);
+    ~Checkpointer(); // writes out everything still queued
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    void checkpoint(const Graph& g);
+    // Blocks until every queued checkpoint is on disk; false if any write failed since the last call.
+    bool flush();
+    unsigned long long checkpointsTaken() const { return sequence; }
+
+    // Loads the latest complete checkpoint in path into g (which must hold the same network).
+    // A torn record at the end of the file, e.g. from a crash mid-write, is ignored.
+    static bool restore(Graph& g, const string& path);
+
+private:
+    struct Job {
+        bool full;
+        vector<unsigned char> bytes;
+    };
+
+    void writerLoop();
+    bool writeFull(const vector<unsigned char>& bytes);
+    bool appendDelta(const vector<unsigned char>& bytes);
+
+    string path;
+    unsigned fullInterval;
+    unsigned sinceFull = 0;
+    unsigned long long sequence = 0;
+
+    // state as of the last checkpoint, compared against on the next one
+    bool hasBase = false;
+    vector<double> lastLevel;
+    vector<double> lastCapacity;
+    vector<unsigned char> lastActive;
+    vector<int> lastValve;
+    vector<double> lastEdgeCapacity;
+    vector<double> lastFlowRate;
+    vector<double> lastLoss;
+    vector<PipeLeakStats> lastLeakStats;
+    unsigned long long lastHistoryTotal = 0;
+    size_t lastHistoryCapacity = 0;
+
+    std::thread writer;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::deque<Job> queue;
+    bool writing = false;
+    bool stopping = false;
+    bool writeFailed = false;
+    std::atomic<bool> needFull{false}; // set by the writer after a failure; the next checkpoint is full
+    int fd = -1;
+};
+
+// Takes a checkpoint at the end of every `everySteps`-th simulation step.
+class CheckpointObserver : public SimulationObserver {
+public:
+    CheckpointObserver(Checkpointer& checkpointer, unsigned everySteps)
+        : checkpointer(checkpointer), everySteps(everySteps ? everySteps : 1) {}
+
+    void onStepEnd(const Graph& g) override {
+        if (++steps % everySteps == 0) checkpointer.checkpoint(g);
+    }
+
+private:
+    Checkpointer& checkpointer;
+    unsigned everySteps;
+    unsigned long long steps = 0;
+};
+
+#endif // GRAPH_CHECKPOINT_H
@@ -0,0 +1,81 @@
+#include "graph.h"
+#include <iostream>
+
+// ---------------- console rendering of simulation steps ----------------
+
+void ConsoleObserver::onStepBegin(const Graph& g) {
+    cout << "\n--- Priority-based refill sequence at " << Graph::formatTime(g.simTimeSec) << " ---\n";
+}
+
+void ConsoleObserver::onMaxFlowAllocation(const Graph&, size_t tanks, double delivered) {
+    cout << "Max-flow allocation delivered " << delivered << " units across " << tanks << " queued tanks\n";
+}
+
+void ConsoleObserver::onBatchedRefill(const Graph&, size_t tanks, size_t batches, double delivered) {
+    cout << "Batched refill delivered " << delivered << " units across " << tanks << " queued tanks in "
+         << batches << " batches\n";
+}
+
+void ConsoleObserver::onTankProcessing(const Graph& g, int tankId, double priority, double level, double capacity) {
+    const Node* tankNode = g.getNodeByIdConst(tankId);
+    cout << "Processing Tank " << tankId << " (" << (tankNode ? tankNode->name : string())
+         << ") - Priority: " << priority
+         << " Level: " << level << "/" << capacity << "\n";
+}
+
+void ConsoleObserver::onNoPath(const Graph&, int sourceId, int tankId) {
+    cout << "  No available path from source " << sourceId << " to tank " << tankId << "\n";
+}
+
+void ConsoleObserver::onDelivery(const Graph&, int, double expected, double actual) {
+    cout << "  Expected delivered (units): " << expected
+         << " | Actual delivered: " << actual << "\n";
+}
+
+void ConsoleObserver::onLeakSuspected(const Graph& g, int tankId, double, double) {
+    cout << "  >>> Leak suspected on path to Tank " << tankId
+         << " (actual < " << g.leakThreshold * 100 << "% of expected).\n";
+}
+
+void ConsoleObserver::onAlternateRoute(const Graph& g, int, bool found, double expected, double actual) {
+    if (!found) {
+        cout << "  No alternate route available. Please inspect pipes or mark leak repaired.\n";
+        return;
+    }
+    cout << "  Alternate route found. Attempting alternate route...\n";
+    cout << "    Alternate expected: " << expected << " | Actual: " << actual << "\n";
+    if (expected > 0 && actual < g.leakThreshold * expected) {
+        cout << "    >>> Alternate route also under-delivered.\n";
+    } else {
+        cout << "    Alternate route delivered adequately.\n";
+    }
+}
+
+void ConsoleObserver::onPipeFlagged(const Graph&, int from, int to, double confidence) {
+    cout << "  Leak localised to pipe " << from << "->" << to << " (confidence " << confidence << ")\n";
+}
+
+void ConsoleObserver::onQueueCarryOver(const Graph&, int processed, size_t remaining) {
+    cout << processed << " tanks processed this step. "
+         << remaining << " tanks remaining in queue for next step.\n";
+}
+
+void ConsoleObserver::onStepEnd(const Graph& g) {
+    cout << "\n--- Snapshot at " << Graph::formatTime(g.simTimeSec) << " ---\n";
+    cout << fixed << setprecision(2);
+    for (size_t slot = 0; slot < g.nodes.size(); ++slot) {
+        const Node& no = g.nodes[slot];
+        cout << "Node " << no.id << " (" << no.name << "): level=" << g.state.level[slot]
+             << " / " << g.state.capacity[slot] << " | valveStatus=" << no.valveStatus
+             << " | outgoing=" << no.outgoingEdges.size() << "\n";
+    }
+    cout << "Edges:\n";
+    for (size_t i = 0; i < g.edges.size(); ++i) {
+        const auto& e = g.edges[i];
+        cout << "  Edge[" << i << "] " << e.from << "->" << e.to
+             << " cap=" << e.capacity << " flowRate=" << e.flowRate
+             << " active=" << (e.active ? "Y":"N")
+             << " valve=" << e.valveStatus << "\n";
+    }
+    cout << "----------------------------------------\n";
+}
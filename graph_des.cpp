@@ -0,0 +1,358 @@
+#include <cmath>
+#include <limits>
+#include "graph_des.h"
+#include "graph.h"
+
+// ---------------- kinetic max-heap ----------------
+
+void KineticMaxHeap::clear() {
+    heap.clear();
+    position.clear();
+    certVersion.clear();
+    certificates = decltype(certificates)();
+}
+
+bool KineticMaxHeap::better(const Entry& x, const Entry& y, double t) const {
+    double kx = x.at(t), ky = y.at(t);
+    return kx > ky || (kx == ky && x.slot < y.slot);
+}
+
+void KineticMaxHeap::swapAt(int i, int j) {
+    swap(heap[i], heap[j]);
+    position[heap[i].slot] = i;
+    position[heap[j].slot] = j;
+}
+
+void KineticMaxHeap::siftUp(int pos, double now) {
+    while (pos > 0 && better(heap[pos], heap[(pos - 1) / 2], now)) {
+        swapAt(pos, (pos - 1) / 2);
+        touch(pos, now);
+        pos = (pos - 1) / 2;
+    }
+    touch(pos, now);
+}
+
+void KineticMaxHeap::siftDown(int pos, double now) {
+    const int n = static_cast<int>(heap.size());
+    while (true) {
+        int best = pos;
+        for (int c = 2 * pos + 1; c <= 2 * pos + 2 && c < n; ++c) {
+            if (better(heap[c], heap[best], now)) best = c;
+        }
+        if (best == pos) break;
+        swapAt(pos, best);
+        touch(pos, now);
+        pos = best;
+    }
+    touch(pos, now);
+}
+
+// Queues the time at which heap[pos] overtakes its parent: now if it already has, never if its key
+// does not grow faster. Earlier certificates of pos go stale.
+void KineticMaxHeap::certify(int pos, double now) {
+    unsigned version = ++certVersion[pos];
+    if (pos == 0) return;
+    const Entry& c = heap[pos];
+    const Entry& p = heap[(pos - 1) / 2];
+    double t = now;
+    if (!better(c, p, now)) {
+        if (c.b <= p.b) return;
+        t = (p.a - c.a) / (c.b - p.b);
+        if (!(t > now)) t = nextafter(now, numeric_limits<double>::infinity()); // a tie, or rounding
+    }
+    certificates.push(Certificate{t, pos, version});
+}
+
+void KineticMaxHeap::touch(int pos, double now) {
+    certify(pos, now);
+    const int n = static_cast<int>(heap.size());
+    for (int c = 2 * pos + 1; c <= 2 * pos + 2 && c < n; ++c) certify(c, now);
+}
+
+void KineticMaxHeap::set(int slot, double a, double b, double now) {
+    if (slot >= static_cast<int>(position.size())) position.resize(slot + 1, -1);
+    int pos = position[slot];
+    if (pos == -1) {
+        pos = static_cast<int>(heap.size());
+        heap.push_back(Entry{slot, a, b});
+        position[slot] = pos;
+        if (certVersion.size() < heap.size()) certVersion.push_back(0); // never shrinks, so versions only grow
+    } else {
+        heap[pos].a = a;
+        heap[pos].b = b;
+    }
+    siftUp(pos, now);
+    siftDown(position[slot], now);
+}
+
+void KineticMaxHeap::erase(int slot, double now) {
+    int pos = position[slot];
+    int last = static_cast<int>(heap.size()) - 1;
+    if (pos != last) swapAt(pos, last);
+    heap.pop_back();
+    position[slot] = -1;
+    if (pos == last) return;
+    int moved = heap[pos].slot;
+    siftUp(pos, now);
+    siftDown(position[moved], now);
+}
+
+int KineticMaxHeap::top(double now) {
+    // replay the parent/child pairs that flipped since the last call
+    while (!certificates.empty() && certificates.top().time <= now) {
+        Certificate c = certificates.top();
+        certificates.pop();
+        if (c.pos >= static_cast<int>(heap.size()) || c.version != certVersion[c.pos]) continue;
+        int parent = (c.pos - 1) / 2;
+        if (better(heap[c.pos], heap[parent], now)) {
+            swapAt(c.pos, parent);
+            touch(c.pos, now);
+            touch(parent, now);
+        } else {
+            certify(c.pos, now);
+        }
+    }
+    return heap.front().slot;
+}
+
+// ---------------- discrete-event engine ----------------
+
+EventSimulation::EventSimulation(Graph& g, const EventSimConfig& config) : g(g), config(config) {
+    reset();
+}
+
+void EventSimulation::reset() {
+    const size_t n = g.state.size();
+    clock = g.simTimeSec;
+    sourceSlot = g.getNodeSlot(config.sourceId);
+    activeRefills = 0;
+    sourceOutflow = 0.0;
+    demandRng = SplitMix64(g.rng());
+    events = decltype(events)();
+    waitList.clear();
+
+    level = g.state.level;
+    lastUpdate.assign(n, clock);
+    consumption.assign(n, 0.0);
+    inflow.assign(n, 0.0);
+    sendRate.assign(n, 0.0);
+    refillStartLevel.assign(n, 0.0);
+    refillStartTime.assign(n, clock);
+    refillPaths.assign(n, vector<int>());
+    version.assign(n, 0);
+    waiting.assign(n, 0);
+    refilling.assign(n, 0);
+
+    const double maxRatePerSec = config.maxReductionPerHour / 3600.0;
+    const int reservoirSlot = g.getNodeSlot(0); // the reservoir is never drawn down
+    g.routeTree(config.sourceId);               // build the route cache once up front
+    for (size_t s = 0; s < n; ++s) {
+        int slot = static_cast<int>(s);
+        if (slot != reservoirSlot) consumption[s] = demandRng.nextUnit() * maxRatePerSec;
+        if (g.state.isTank[s] && slot != sourceSlot && level[s] < config.prescribedLevel) wait(slot);
+        scheduleLevelEvent(slot);
+        if (slot != reservoirSlot) scheduleDemandChange(slot);
+    }
+    startRefills();
+}
+
+double EventSimulation::netRate(int slot) const {
+    double rate = inflow[slot] - consumption[slot];
+    // a source other than the reservoir gives up what it delivers
+    if (slot == sourceSlot && config.sourceId != 0) rate -= sourceOutflow;
+    return rate;
+}
+
+double EventSimulation::levelAt(int slot) const {
+    double v = level[slot] + netRate(slot) * (clock - lastUpdate[slot]);
+    return min(max(v, 0.0), g.state.capacity[slot]);
+}
+
+void EventSimulation::advance(int slot) {
+    level[slot] = levelAt(slot);
+    lastUpdate[slot] = clock;
+}
+
+// Queues the next level crossing of slot at its current net rate and retires any earlier one.
+// A refilling tank always gains (see startRefills and the DemandChange case), so its only event is Full.
+void EventSimulation::scheduleLevelEvent(int slot) {
+    unsigned v = ++version[slot];
+    double rate = netRate(slot);
+    double lv = level[slot];
+    if (rate < 0.0) {
+        bool canWait = g.state.isTank[slot] && slot != sourceSlot && !waiting[slot] && !refilling[slot];
+        if (canWait && lv > config.prescribedLevel) {
+            events.push(Event{clock + (lv - config.prescribedLevel) / -rate, slot, EventKind::BelowPrescribed, v});
+        } else if (lv > 0.0) {
+            events.push(Event{clock + lv / -rate, slot, EventKind::Empty, v});
+        }
+    } else if (rate > 0.0 && refilling[slot]) {
+        events.push(Event{clock + (g.state.capacity[slot] - lv) / rate, slot, EventKind::Full, v});
+    }
+}
+
+void EventSimulation::scheduleDemandChange(int slot) {
+    if (config.demandChangeMeanSec <= 0.0) return;
+    double wait = -log(1.0 - demandRng.nextUnit()) * config.demandChangeMeanSec;
+    events.push(Event{clock + wait, slot, EventKind::DemandChange, 0});
+}
+
+void EventSimulation::wait(int slot) {
+    waiting[slot] = 1;
+    rekeyWaiting(slot);
+}
+
+// The stepper priority (1 - level / prescribedLevel) * capacity as a line in time; a waiting tank
+// only drains, and once dry its level and priority stay put.
+void EventSimulation::rekeyWaiting(int slot) {
+    const double capacity = g.state.capacity[slot];
+    double lv = levelAt(slot), rate = netRate(slot);
+    if (lv <= 0.0 && rate < 0.0) rate = 0.0;
+    double slope = -capacity * rate / config.prescribedLevel;
+    waitList.set(slot, capacity * (1.0 - lv / config.prescribedLevel) - slope * clock, slope, clock);
+}
+
+// Hands free refill slots to the waiting tanks with the highest stepper priority,
+// (1 - level / prescribedLevel) * capacity, evaluated now. Paths are steered around flagged pipes and
+// the tank receives what survives the simulated leaks on the way. A tank whose path cannot outpace its
+// own consumption would never fill and would hold its slot for good, so it is passed over; it waits
+// again at its next demand change.
+void EventSimulation::startRefills() {
+    bool sourceDry = sourceSlot == -1 || (config.sourceId != 0 && levelAt(sourceSlot) <= 0.0);
+    while (activeRefills < config.maxActiveRefills && !waitList.empty() && !sourceDry) {
+        int slot = waitList.top(clock);
+        double bestScore = (1.0 - levelAt(slot) / config.prescribedLevel) * g.state.capacity[slot];
+        waitList.erase(slot, clock);
+        waiting[slot] = 0;
+
+        int tankId = g.nodes[slot].id;
+        for (auto* o : g.observers) o->onTankProcessing(g, tankId, bestScore, levelAt(slot), g.state.capacity[slot]);
+        double rate = 0.0, received = 0.0;
+        if (!g.extractPath(g.routeTree(config.sourceId), tankId, path)) {
+            g.logEvent(LogKind::NoPath, tankId, config.sourceId);
+            for (auto* o : g.observers) o->onNoPath(g, config.sourceId, tankId);
+        } else {
+            g.steerAroundLeaks(config.sourceId, tankId, path);
+            rate = g.pathSupplyRate(path);
+            received = rate * g.pathRetention(path);
+        }
+        advance(slot);
+        if (received <= consumption[slot]) {
+            scheduleLevelEvent(slot); // left below prescribedLevel until its demand changes
+            continue;
+        }
+        if (sourceSlot != -1) advance(sourceSlot);
+        inflow[slot] = received;
+        sendRate[slot] = rate;
+        sourceOutflow += rate;
+        refilling[slot] = 1;
+        refillStartLevel[slot] = level[slot];
+        refillStartTime[slot] = clock;
+        refillPaths[slot] = path;
+        ++activeRefills;
+        ++counters.refillsStarted;
+        scheduleLevelEvent(slot);
+        if (sourceSlot != -1 && config.sourceId != 0) scheduleLevelEvent(sourceSlot);
+    }
+}
+
+// Ends the refill of slot and feeds it to the leak detector: what the source sent along the path
+// against what reached the tank.
+void EventSimulation::finishRefill(int slot) {
+    if (sourceSlot != -1) advance(sourceSlot);
+    advance(slot);
+    const vector<int>& refillPath = refillPaths[slot];
+    double elapsed = clock - refillStartTime[slot];
+    double sent = sendRate[slot] * elapsed, received = inflow[slot] * elapsed;
+    double delivered = level[slot] - refillStartLevel[slot];
+    double expected = delivered + (sent - received); // what the tank would have gained without leaks
+    int tankId = g.nodes[slot].id;
+    g.logEvent(LogKind::Supply, tankId, config.sourceId, static_cast<int>(refillPath.size()),
+               expected, delivered, refillStartLevel[slot], level[slot]);
+    for (auto* o : g.observers) o->onDelivery(g, tankId, expected, delivered);
+    g.recordDelivery(refillPath, sent, received);
+    if (sent > 0.0 && received < g.leakThreshold * sent) {
+        g.logEvent(LogKind::LeakSuspected, tankId, 0, 0, sent, received);
+        for (auto* o : g.observers) o->onLeakSuspected(g, tankId, sent, received);
+    }
+    counters.delivered += delivered;
+    ++counters.refillsCompleted;
+
+    sourceOutflow = --activeRefills == 0 ? 0.0 : sourceOutflow - sendRate[slot];
+    inflow[slot] = 0.0;
+    refilling[slot] = 0;
+    if (g.state.isTank[slot] && level[slot] < config.prescribedLevel) wait(slot);
+    scheduleLevelEvent(slot);
+    if (sourceSlot != -1 && config.sourceId != 0) scheduleLevelEvent(sourceSlot);
+}
+
+void EventSimulation::runUntil(double endTimeSec) {
+    const double maxRatePerSec = config.maxReductionPerHour / 3600.0;
+    while (!events.empty() && events.top().time <= endTimeSec) {
+        Event e = events.top();
+        events.pop();
+        if (e.kind != EventKind::DemandChange && e.version != version[e.slot]) {
+            ++counters.staleEvents;
+            continue;
+        }
+        ++counters.events;
+        clock = max(clock, e.time);
+        int slot = e.slot;
+
+        switch (e.kind) {
+            case EventKind::BelowPrescribed:
+                lastUpdate[slot] = clock;
+                level[slot] = config.prescribedLevel; // exact, no drift from the rate arithmetic
+                g.logEvent(LogKind::BelowPrescribed, g.nodes[slot].id, 0, 0, level[slot], config.prescribedLevel, 0.0);
+                wait(slot);
+                scheduleLevelEvent(slot);
+                startRefills();
+                break;
+            case EventKind::Empty:
+                lastUpdate[slot] = clock;
+                level[slot] = 0.0;
+                if (slot == sourceSlot) {
+                    // the source ran dry: stop every refill it was feeding
+                    for (int s = 0; s < static_cast<int>(refilling.size()); ++s) {
+                        if (refilling[s]) finishRefill(s);
+                    }
+                } else if (refilling[slot]) {
+                    finishRefill(slot); // cannot happen while refills always gain, but never keep a dead slot
+                } else if (waiting[slot]) {
+                    rekeyWaiting(slot); // dry: its priority stops rising
+                }
+                scheduleLevelEvent(slot);
+                startRefills();
+                break;
+            case EventKind::Full:
+                lastUpdate[slot] = clock;
+                level[slot] = g.state.capacity[slot];
+                finishRefill(slot);
+                startRefills();
+                break;
+            case EventKind::DemandChange:
+                advance(slot);
+                consumption[slot] = demandRng.nextUnit() * maxRatePerSec;
+                scheduleDemandChange(slot);
+                if (refilling[slot] && netRate(slot) <= 0.0) {
+                    // demand now eats the whole inflow: end the refill and free its slot
+                    finishRefill(slot);
+                    startRefills();
+                } else if (g.state.isTank[slot] && slot != sourceSlot && !waiting[slot] && !refilling[slot] &&
+                           level[slot] < config.prescribedLevel) {
+                    // a tank passed over by startRefills gets another chance at its new demand
+                    wait(slot);
+                    scheduleLevelEvent(slot);
+                    startRefills();
+                } else {
+                    if (waiting[slot]) rekeyWaiting(slot); // its priority now rises at the new rate
+                    scheduleLevelEvent(slot);
+                }
+                break;
+        }
+    }
+
+    clock = max(clock, endTimeSec);
+    for (size_t s = 0; s < level.size(); ++s) g.state.level[s] = levelAt(static_cast<int>(s));
+    g.simTimeSec = static_cast<int>(clock);
+}
@@ -0,0 +1,129 @@
+#ifndef GRAPH_DES_H
+#define GRAPH_DES_H
+
+#include "graph_types.h"
+#include "graph_random.h"
+#include <queue>
+
+class Graph;
+
+struct EventSimConfig {
+    int sourceId = 0;
+    double maxReductionPerHour = 10000.0;
+    double prescribedLevel = 200.0;
+    int maxActiveRefills = 3;           // refills running at once, like MAX_TANKS_PER_STEP
+    double demandChangeMeanSec = 3600.0; // mean time between demand changes per node; <= 0 keeps demand fixed
+};
+
+struct EventSimStats {
+    unsigned long long events = 0;      // events processed
+    unsigned long long staleEvents = 0; // superseded events skipped
+    unsigned long long refillsStarted = 0;
+    unsigned long long refillsCompleted = 0;
+    double delivered = 0.0;
+};
+
+// Max-heap of slots whose keys move linearly in time, key(t) = a + b * t (a kinetic heap). Every
+// parent/child pair carries the time at which the child would overtake its parent; top(now) first
+// replays the pairs that flipped since the last call, so it costs O(log n) per reordering instead of
+// re-scoring every entry. Ties go to the lower slot.
+class KineticMaxHeap {
+public:
+    void clear();
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    bool contains(int slot) const { return slot < static_cast<int>(position.size()) && position[slot] != -1; }
+    void set(int slot, double a, double b, double now); // insert or re-key
+    void erase(int slot, double now);
+    int top(double now);                               // slot with the largest key at now
+
+private:
+    struct Entry {
+        int slot;
+        double a, b;
+        double at(double t) const { return a + b * t; }
+    };
+    struct Certificate {
+        double time;
+        int pos;
+        unsigned version;
+        bool operator>(const Certificate& o) const { return time > o.time; }
+    };
+
+    bool better(const Entry& x, const Entry& y, double t) const;
+    void swapAt(int i, int j);
+    void siftUp(int pos, double now);
+    void siftDown(int pos, double now);
+    void certify(int pos, double now); // when heap[pos] overtakes its parent
+    void touch(int pos, double now);   // recertify pos and its children
+
+    vector<Entry> heap;
+    vector<int> position;              // by slot, -1 when not in the heap
+    vector<unsigned> certVersion;      // by heap position; older certificates are stale
+    priority_queue<Certificate, vector<Certificate>, greater<Certificate>> certificates;
+};
+
+// Discrete-event alternative to Graph::simulateStep. Each node consumes at a piecewise-constant
+// rate (factor * maxReductionPerHour, factor redrawn at exponentially spaced demand changes), so
+// levels are linear between events and the engine only wakes when something happens: a tank
+// crossing prescribedLevel, a refill filling a tank exactly to capacity, a node running dry, or
+// a demand change. Cost is proportional to the number of events, not nodes x ticks, and refills
+// stop at the exact fill time instead of a whole number of seconds. A waiting tank's priority is
+// linear in time between its own events, so the waiting tanks sit in a KineticMaxHeap and a refill
+// start costs O(log W) in the W waiting tanks plus the priority reorderings since the last one.
+//
+// Levels are kept lazily (value + time of last update) and written back to the graph by
+// runUntil. The engine snapshots routing at construction; call reset() after editing the network.
+class EventSimulation {
+public:
+    EventSimulation(Graph& g, const EventSimConfig& config);
+
+    void reset();                     // re-read levels and routes from the graph, redraw demand
+    void runUntil(double endTimeSec); // process events up to endTimeSec, then sync the graph
+    double now() const { return clock; }
+    double levelAt(int slot) const;   // level of a node slot at now()
+    const EventSimStats& stats() const { return counters; }
+
+private:
+    enum class EventKind : unsigned char { BelowPrescribed, Empty, Full, DemandChange };
+    struct Event {
+        double time;
+        int slot;
+        EventKind kind;
+        unsigned version; // level events are stale once the node's version has moved on
+        bool operator>(const Event& o) const {
+            if (time != o.time) return time > o.time;
+            if (slot != o.slot) return slot > o.slot;
+            return kind > o.kind;
+        }
+    };
+
+    double netRate(int slot) const;
+    void advance(int slot);           // bring the stored level of slot up to clock
+    void scheduleLevelEvent(int slot);
+    void scheduleDemandChange(int slot);
+    void startRefills();
+    void finishRefill(int slot);
+    void wait(int slot);              // queue slot for a refill
+    void rekeyWaiting(int slot);      // slot's priority line changed (demand change, ran dry)
+
+    Graph& g;
+    EventSimConfig config;
+    SplitMix64 demandRng{0};
+    double clock = 0.0;
+    int sourceSlot = -1;
+    int activeRefills = 0;
+    double sourceOutflow = 0.0;       // sum of the running refill rates
+    EventSimStats counters;
+
+    vector<double> level, lastUpdate, consumption, inflow, refillStartLevel, refillStartTime;
+    vector<double> sendRate;          // what a refill takes from the source; inflow is what survives the leaks
+    vector<vector<int>> refillPaths;  // path of each running refill, for the leak detector
+    vector<unsigned> version;
+    vector<unsigned char> waiting, refilling;
+    KineticMaxHeap waitList;          // tanks below prescribedLevel waiting for a refill slot
+    vector<int> path;
+    priority_queue<Event, vector<Event>, greater<Event>> events;
+};
+
+#endif // GRAPH_DES_H
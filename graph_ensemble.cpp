@@ -0,0 +1,141 @@
+#include <chrono>
+#include <memory>
+#include "graph.h"
+#include "graph_random.h"
+#include "thread_pool.h"
+
+// ---------------- Monte Carlo ensembles ----------------
+
+namespace {
+
+// Watches one run at a time on a worker's clone and keeps per-tank tallies across its runs.
+// Levels are checked in onStepBegin, i.e. after consumption and before refilling, which is
+// the low point of each step.
+class EnsembleTracker : public SimulationObserver {
+public:
+    EnsembleTracker(size_t slots, int sourceSlot, double prescribedLevel, double emptyLevel)
+        : sourceSlot(sourceSlot), prescribedLevel(prescribedLevel), emptyLevel(emptyLevel),
+          belowInRun(slots), emptyInRun(slots), belowRuns(slots), emptyRuns(slots),
+          emptyTimeSum(slots), leakAlerts(slots) {}
+
+    void beginRun(int startTimeSec) {
+        runStart = startTimeSec;
+        fill(belowInRun.begin(), belowInRun.end(), 0);
+        fill(emptyInRun.begin(), emptyInRun.end(), 0);
+    }
+    void endRun() {
+        for (size_t s = 0; s < belowInRun.size(); ++s) belowRuns[s] += belowInRun[s];
+    }
+
+    void onStepBegin(const Graph& g) override {
+        const double* level = g.state.level.data();
+        const unsigned char* isTank = g.state.isTank.data();
+        for (size_t s = 0; s < g.state.size(); ++s) {
+            if (!isTank[s] || static_cast<int>(s) == sourceSlot) continue;
+            if (level[s] < prescribedLevel) belowInRun[s] = 1;
+            if (level[s] <= emptyLevel && !emptyInRun[s]) {
+                emptyInRun[s] = 1;
+                ++emptyRuns[s];
+                emptyTimeSum[s] += g.simTimeSec - runStart;
+            }
+        }
+    }
+    void onLeakSuspected(const Graph& g, int tankId, double, double) override {
+        int slot = g.getNodeSlot(tankId);
+        if (slot >= 0) ++leakAlerts[slot];
+    }
+
+    int sourceSlot;
+    double prescribedLevel;
+    double emptyLevel;
+    int runStart = 0;
+    vector<unsigned char> belowInRun, emptyInRun;
+    vector<unsigned long long> belowRuns, emptyRuns, emptyTimeSum, leakAlerts;
+};
+
+// Everything one scheduler slot needs: its own copy of the scenario (topology, CSR and route
+// cache are built once and reused by every run) and its tallies. Runs only reset the columns
+// the simulation writes: levels, time, rng and history.
+struct EnsembleWorker {
+    Graph clone;
+    ThreadPool serial{1}; // the clone must not fan out into the pool that is running it
+    EnsembleTracker tracker;
+
+    EnsembleWorker(const Graph& scenario, const EnsembleConfig& config)
+        : clone(scenario),
+          tracker(scenario.state.size(), scenario.getNodeSlot(config.sourceId), config.prescribedLevel, config.emptyLevel) {
+        clone.observers.clear();
+        clone.addObserver(&tracker);
+        clone.workerPool = &serial;
+        clone.history.setCapacity(1024); // nobody reads it; keep the copies small
+        clone.topology();
+    }
+};
+
+} // namespace
+
+// Runs config.runs independent copies of the current state across the worker pool and
+// aggregates per-tank risk figures. Run r is seeded from (baseSeed, r) alone, starts from the
+// scenario's levels, time and leak-detector state whichever clone runs it, and every tally is an
+// integer sum, so the result does not depend on thread count or scheduling.
+EnsembleResult Graph::runEnsemble(const EnsembleConfig& config) const {
+    EnsembleResult result;
+    auto start = chrono::steady_clock::now();
+    ThreadPool& pool = workerPool ? *workerPool : ThreadPool::shared();
+
+    // clones are made lazily by the slot's first run, so the copies happen in parallel too
+    vector<unique_ptr<EnsembleWorker>> workers(pool.size());
+    const vector<double>& baseLevel = state.level;
+    const int baseTime = simTimeSec;
+    const LeakDetector& baseLeaks = leaks;
+
+    result.steals = pool.parallelForStealing(config.runs, [&](size_t run, unsigned slot) {
+        if (!workers[slot]) workers[slot].reset(new EnsembleWorker(*this, config));
+        EnsembleWorker& w = *workers[slot];
+        Graph& g = w.clone;
+
+        g.seed(SplitMix64::mix(config.baseSeed ^ SplitMix64::mix(run)));
+        g.state.level = baseLevel;
+        g.simTimeSec = baseTime;
+        g.leaks = baseLeaks; // what one run learns about leaks would steer the next run's routing
+        g.history.clear();
+
+        w.tracker.beginRun(baseTime);
+        for (long long s = 0; s < config.steps; ++s) {
+            g.simulateStep(config.intervalSec, config.sourceId, config.maxReductionPerHour, config.prescribedLevel);
+        }
+        w.tracker.endRun();
+    });
+
+    const size_t n = state.size();
+    vector<unsigned long long> belowRuns(n), emptyRuns(n), emptyTimeSum(n), leakAlerts(n);
+    for (const auto& w : workers) {
+        if (!w) continue;
+        for (size_t s = 0; s < n; ++s) {
+            belowRuns[s] += w->tracker.belowRuns[s];
+            emptyRuns[s] += w->tracker.emptyRuns[s];
+            emptyTimeSum[s] += w->tracker.emptyTimeSum[s];
+            leakAlerts[s] += w->tracker.leakAlerts[s];
+        }
+    }
+
+    const int sourceSlot = getNodeSlot(config.sourceId);
+    const double runs = config.runs ? static_cast<double>(config.runs) : 1.0;
+    for (size_t s = 0; s < n; ++s) {
+        if (!state.isTank[s] || static_cast<int>(s) == sourceSlot) continue;
+        TankEnsembleStats t;
+        t.tankId = nodes[s].id;
+        t.runsBelowPrescribed = belowRuns[s];
+        t.probabilityBelowPrescribed = belowRuns[s] / runs;
+        t.runsEmptied = emptyRuns[s];
+        if (emptyRuns[s]) t.meanTimeToEmptySec = static_cast<double>(emptyTimeSum[s]) / emptyRuns[s];
+        t.leakAlerts = leakAlerts[s];
+        t.leakAlertsPerRun = leakAlerts[s] / runs;
+        result.tanks.push_back(t);
+    }
+
+    result.runs = config.runs;
+    result.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (result.wallSeconds > 0.0) result.runsPerSecond = config.runs / result.wallSeconds;
+    return result;
+}
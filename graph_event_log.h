@@ -0,0 +1,70 @@
+#ifndef GRAPH_EVENT_LOG_H
+#define GRAPH_EVENT_LOG_H
+
+#include "graph_types.h"
+
+// Bounded simulation history. Records go into a fixed-capacity ring buffer, so the oldest ones
+// are overwritten once it is full and memory stays bounded however long the run is.
+// Only LogKind::Message records carry text; it is kept in a side table in the same ring slot.
+// Single writer: parallel phases stage their records and append them afterwards.
+class EventLog {
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+    explicit EventLog(size_t capacity = DEFAULT_CAPACITY) : cap(capacity ? capacity : 1) {}
+
+    void push(const LogEntry& entry) {
+        size_t slot = nextSlot();
+        records[slot] = entry;
+        texts[slot].clear();
+    }
+    void pushMessage(int simTimeSec, const string& text) {
+        size_t slot = nextSlot();
+        records[slot] = LogEntry{LogKind::Message, simTimeSec, -1, 0, 0, {0, 0, 0, 0}};
+        texts[slot] = text;
+    }
+
+    // i = 0 is the oldest retained record
+    const LogEntry& operator[](size_t i) const { return records[physical(i)]; }
+    const string& text(size_t i) const { return texts[physical(i)]; }
+
+    size_t size() const { return records.size(); }
+    bool empty() const { return records.empty(); }
+    size_t capacity() const { return cap; }
+    unsigned long long totalPushed() const { return total; }
+
+    void clear() {
+        records.clear();
+        texts.clear();
+        head = 0;
+        total = 0;
+    }
+    void setCapacity(size_t capacity) {
+        clear();
+        cap = capacity ? capacity : 1;
+    }
+    // used when the ring is rebuilt from a checkpoint, where only the retained records are replayed
+    void setTotalPushed(unsigned long long n) { total = n; }
+
+private:
+    size_t nextSlot() {
+        ++total;
+        if (records.size() < cap) {
+            records.emplace_back();
+            texts.emplace_back();
+            return records.size() - 1;
+        }
+        size_t slot = head;
+        head = (head + 1) % cap;
+        return slot;
+    }
+    size_t physical(size_t i) const { return records.size() < cap ? i : (head + i) % cap; }
+
+    vector<LogEntry> records;
+    vector<string> texts;
+    size_t cap;
+    size_t head = 0; // oldest record once the ring is full
+    unsigned long long total = 0;
+};
+
+#endif // GRAPH_EVENT_LOG_H
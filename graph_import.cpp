@@ -0,0 +1,239 @@
+#include "graph.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+#include <sys/stat.h>
+
+// ---------------- streaming CSV import ----------------
+//
+// nodes file: id,name,type,capacity,initialLevel   (type: Tank/Industry or 0/1)
+// pipes file: from,to,capacity,flowRate,valve
+// A first line whose first field is not a number is treated as a header. Names may be
+// double-quoted (with "" for a literal quote) when they contain commas; any field may be quoted.
+
+namespace {
+
+const size_t CSV_CHUNK_BYTES = 1 << 20;
+const size_t MAX_REPORTED_ERRORS = 100;
+const int MAX_FIELDS = 8;
+// rough minimum row sizes, used to reserve storage up front instead of rehashing while streaming
+const size_t MIN_NODE_ROW_BYTES = 24;
+const size_t MIN_PIPE_ROW_BYTES = 16;
+
+struct Field {
+    const char* begin;
+    const char* end;
+};
+
+// Reads a file in large chunks and hands out one line at a time without copying it.
+class CsvChunkReader {
+public:
+    explicit CsvChunkReader(const string& path) : file(fopen(path.c_str(), "rb")), buf(CSV_CHUNK_BYTES) {}
+    ~CsvChunkReader() { if (file) fclose(file); }
+    bool isOpen() const { return file != nullptr; }
+
+    size_t fileSize() const {
+        struct stat st;
+        return fstat(fileno(file), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    }
+
+    bool nextLine(const char*& lineBegin, const char*& lineEnd) {
+        while (true) {
+            const char* nl = static_cast<const char*>(memchr(buf.data() + pos, '\n', end - pos));
+            if (nl) {
+                lineBegin = buf.data() + pos;
+                lineEnd = nl;
+                pos = static_cast<size_t>(nl - buf.data()) + 1;
+                return true;
+            }
+            if (eof) {
+                if (pos == end) return false;
+                lineBegin = buf.data() + pos; // last line without a trailing newline
+                lineEnd = buf.data() + end;
+                pos = end;
+                return true;
+            }
+            // keep the partial line, then refill behind it (growing the buffer for very long lines)
+            memmove(buf.data(), buf.data() + pos, end - pos);
+            end -= pos;
+            pos = 0;
+            if (end == buf.size()) buf.resize(buf.size() * 2);
+            size_t got = fread(buf.data() + end, 1, buf.size() - end, file);
+            if (got == 0) eof = true;
+            end += got;
+        }
+    }
+
+private:
+    FILE* file;
+    vector<char> buf;
+    size_t pos = 0, end = 0;
+    bool eof = false;
+};
+
+// Splits a line on commas, honouring double quotes. A quoted field is unescaped into
+// unquoted[field number], so every field of the row keeps its own buffer; the buffers are reused
+// across rows. Returns the number of fields.
+int splitFields(const char* b, const char* e, Field* out, string* unquoted) {
+    if (e > b && e[-1] == '\r') --e;
+    int count = 0;
+    while (count < MAX_FIELDS) {
+        while (b < e && *b == ' ') ++b;
+        if (b < e && *b == '"') {
+            string& text = unquoted[count];
+            text.clear();
+            const char* p = b + 1;
+            while (p < e) {
+                if (*p == '"') {
+                    if (p + 1 < e && p[1] == '"') { text += '"'; p += 2; continue; }
+                    ++p;
+                    break;
+                }
+                text += *p++;
+            }
+            out[count++] = Field{text.data(), text.data() + text.size()};
+            while (p < e && *p != ',') ++p;
+            if (p >= e) break;
+            b = p + 1;
+            continue;
+        }
+        const char* comma = static_cast<const char*>(memchr(b, ',', e - b));
+        const char* fe = comma ? comma : e;
+        const char* trimmed = fe;
+        while (trimmed > b && trimmed[-1] == ' ') --trimmed;
+        out[count++] = Field{b, trimmed};
+        if (!comma) break;
+        b = comma + 1;
+    }
+    return count;
+}
+
+template <typename T>
+bool parseNumber(const Field& f, T& value) {
+    auto res = std::from_chars(f.begin, f.end, value);
+    return res.ec == std::errc() && res.ptr == f.end;
+}
+
+bool parseNodeType(const Field& f, NodeType& type) {
+    size_t len = static_cast<size_t>(f.end - f.begin);
+    auto is = [&](const char* word) { return len == strlen(word) && strncasecmp(f.begin, word, len) == 0; };
+    if (is("tank") || is("0")) { type = NodeType::Tank; return true; }
+    if (is("industry") || is("1")) { type = NodeType::Industry; return true; }
+    return false;
+}
+
+bool looksLikeHeader(const Field& first) {
+    int dummy;
+    return !parseNumber(first, dummy);
+}
+
+} // namespace
+
+void ImportReport::addError(const string& message) {
+    if (errors.size() < MAX_REPORTED_ERRORS) errors.push_back(message);
+    else ++suppressedErrors;
+}
+
+// Streams both files into the network (appending to whatever is already there). Rows are
+// appended straight to the node/edge arrays with hash-based duplicate checks, and the adjacency
+// is built once at the end. Bad rows are skipped and described in the returned report instead
+// of being printed.
+ImportReport Graph::importCsv(const string& nodesPath, const string& pipesPath) {
+    ImportReport report;
+    Field fields[MAX_FIELDS];
+    string unquoted[MAX_FIELDS];
+    const char* lb;
+    const char* le;
+
+    CsvChunkReader nodeReader(nodesPath);
+    if (!nodeReader.isOpen()) {
+        report.addError(nodesPath + ": cannot open");
+        return report;
+    }
+    size_t expectedNodes = nodeReader.fileSize() / MIN_NODE_ROW_BYTES;
+    nodes.reserve(nodes.size() + expectedNodes);
+    state.level.reserve(state.level.size() + expectedNodes);
+    state.capacity.reserve(state.capacity.size() + expectedNodes);
+    state.isTank.reserve(state.isTank.size() + expectedNodes);
+    size_t lineNo = 0;
+    while (nodeReader.nextLine(lb, le)) {
+        ++lineNo;
+        int nf = splitFields(lb, le, fields, unquoted);
+        if (nf == 1 && fields[0].begin == fields[0].end) continue; // blank line
+        if (lineNo == 1 && looksLikeHeader(fields[0])) continue;
+        int id;
+        NodeType type;
+        double capacity, level;
+        if (nf < 5 || !parseNumber(fields[0], id) || !parseNodeType(fields[2], type) ||
+            !parseNumber(fields[3], capacity) || !parseNumber(fields[4], level) || id < 0) {
+            ++report.malformedRows;
+            report.addError(nodesPath + ":" + to_string(lineNo) + ": malformed node row");
+            continue;
+        }
+        if (id > MAX_NODE_ID) {
+            ++report.malformedRows;
+            report.addError(nodesPath + ":" + to_string(lineNo) + ": node id " + to_string(id) + " above the limit " +
+                            to_string(MAX_NODE_ID));
+            continue;
+        }
+        if (getNodeSlot(id) != -1) {
+            ++report.duplicateNodes;
+            report.addError(nodesPath + ":" + to_string(lineNo) + ": duplicate node id " + to_string(id));
+            continue;
+        }
+        if (id >= static_cast<int>(nodeSlotById.size())) {
+            nodeSlotById.resize(max<size_t>(id + 1, min<size_t>(nodeSlotById.size() * 2, MAX_NODE_ID + 1)), -1);
+        }
+        nodeSlotById[id] = static_cast<int>(nodes.size());
+        nodes.emplace_back(id, type, string(fields[1].begin, fields[1].end), 0);
+        state.push(capacity, type == NodeType::Tank);
+        state.level.back() = level;
+        ++report.nodesImported;
+    }
+
+    CsvChunkReader pipeReader(pipesPath);
+    if (!pipeReader.isOpen()) {
+        report.addError(pipesPath + ": cannot open");
+    } else {
+        size_t expectedEdges = pipeReader.fileSize() / MIN_PIPE_ROW_BYTES;
+        edges.reserve(edges.size() + expectedEdges);
+        edgeIndexByKey.reserve(edgeIndexByKey.size() + expectedEdges);
+        lineNo = 0;
+        while (pipeReader.nextLine(lb, le)) {
+            ++lineNo;
+            int nf = splitFields(lb, le, fields, unquoted);
+            if (nf == 1 && fields[0].begin == fields[0].end) continue;
+            if (lineNo == 1 && looksLikeHeader(fields[0])) continue;
+            int from, to, valve;
+            double capacity, flowRate;
+            if (nf < 5 || !parseNumber(fields[0], from) || !parseNumber(fields[1], to) ||
+                !parseNumber(fields[2], capacity) || !parseNumber(fields[3], flowRate) || !parseNumber(fields[4], valve)) {
+                ++report.malformedRows;
+                report.addError(pipesPath + ":" + to_string(lineNo) + ": malformed pipe row");
+                continue;
+            }
+            if (getNodeSlot(from) == -1 || getNodeSlot(to) == -1) {
+                ++report.danglingEdges;
+                report.addError(pipesPath + ":" + to_string(lineNo) + ": pipe " + to_string(from) + "->" +
+                                to_string(to) + " references a missing node");
+                continue;
+            }
+            if (!edgeIndexByKey.emplace(edgeKey(from, to), static_cast<int>(edges.size())).second) {
+                ++report.duplicateEdges;
+                report.addError(pipesPath + ":" + to_string(lineNo) + ": duplicate pipe " + to_string(from) + "->" + to_string(to));
+                continue;
+            }
+            edges.emplace_back(from, to, capacity, flowRate, true, valve);
+            ++report.edgesImported;
+        }
+    }
+
+    // trim the over-allocation from geometric growth of the id table
+    size_t maxId = 0;
+    for (const auto& n : nodes) maxId = max(maxId, static_cast<size_t>(n.id));
+    nodeSlotById.resize(nodes.empty() ? 0 : maxId + 1);
+
+    rebuildOutgoingEdges(); // single adjacency build; also invalidates the topology snapshot
+    return report;
+}
@@ -0,0 +1,284 @@
+#include "graph.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------- binary network file ----------------
+//
+// Layout (all integers and doubles little-endian, sections 8-byte aligned):
+//   header       72 bytes, see below
+//   node table   nodeCount * 40 bytes: id i32, type u8, pad[3], valveStatus i32, nameLength u32,
+//                nameOffset u64 (into string pool), capacity f64, level f64
+//   edge table   edgeCount * 32 bytes: from i32, to i32, capacity f64, flowRate f64, active u8,
+//                pad[3], valveStatus i32
+//   string pool  node names, concatenated without terminators
+//   CSR section  optional (flag bit 0): usableCount u64, offsets i32[nodeCount + 1],
+//                targets i32[usableCount], edgeIds i32[usableCount]; targets are node slots
+//
+// Header: magic "WNETBIN1", version u32, flags u32, nodeCount u64, edgeCount u64,
+//         stringPoolBytes u64, nodeTableOffset u64, edgeTableOffset u64, stringPoolOffset u64,
+//         csrOffset u64
+
+namespace {
+
+const char NETWORK_MAGIC[8] = {'W', 'N', 'E', 'T', 'B', 'I', 'N', '1'};
+const uint32_t NETWORK_VERSION = 1;
+const uint32_t FLAG_HAS_CSR = 1;
+const size_t HEADER_BYTES = 72;
+const size_t NODE_RECORD_BYTES = 40;
+const size_t EDGE_RECORD_BYTES = 32;
+
+bool hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+size_t align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+// true when [offset, offset + length) lies inside a file of size bytes, without overflowing
+bool fits(uint64_t offset, uint64_t length, size_t size) { return length <= size && offset <= size - length; }
+
+// Makes a completed rename durable by syncing the directory that holds path.
+bool syncParentDirectory(const string& path) {
+    const size_t slash = path.find_last_of('/');
+    const string dir = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+}
+
+template <typename T>
+void put(vector<unsigned char>& buf, size_t at, T value) { memcpy(buf.data() + at, &value, sizeof(T)); }
+
+template <typename T>
+T get(const unsigned char* base, size_t at) {
+    T value;
+    memcpy(&value, base + at, sizeof(T));
+    return value;
+}
+
+} // namespace
+
+// Writes the network (nodes with levels, edges and optionally the CSR snapshot) to a temporary
+// file next to path, syncs it and renames it into place, so readers never see a partial file;
+// the directory is synced afterwards so the rename itself survives a crash.
+bool Graph::saveBinary(const string& path, bool includeCsr) const {
+    if (!hostIsLittleEndian()) {
+        cerr << "saveBinary: big-endian hosts are not supported.\n";
+        return false;
+    }
+    const size_t n = nodes.size(), m = edges.size();
+    size_t poolBytes = 0;
+    for (const auto& node : nodes) poolBytes += node.name.size();
+    const CsrTopology* t = includeCsr ? &topology() : nullptr;
+    const size_t usable = t ? t->targets.size() : 0;
+
+    const size_t nodeOff = HEADER_BYTES;
+    const size_t edgeOff = align8(nodeOff + n * NODE_RECORD_BYTES);
+    const size_t poolOff = align8(edgeOff + m * EDGE_RECORD_BYTES);
+    const size_t csrOff = t ? align8(poolOff + poolBytes) : 0;
+    const size_t total = t ? csrOff + 8 + 4 * (n + 1) + 8 * usable : poolOff + poolBytes;
+
+    vector<unsigned char> buf(total, 0);
+    memcpy(buf.data(), NETWORK_MAGIC, 8);
+    put<uint32_t>(buf, 8, NETWORK_VERSION);
+    put<uint32_t>(buf, 12, t ? FLAG_HAS_CSR : 0);
+    put<uint64_t>(buf, 16, n);
+    put<uint64_t>(buf, 24, m);
+    put<uint64_t>(buf, 32, poolBytes);
+    put<uint64_t>(buf, 40, nodeOff);
+    put<uint64_t>(buf, 48, edgeOff);
+    put<uint64_t>(buf, 56, poolOff);
+    put<uint64_t>(buf, 64, csrOff);
+
+    size_t nameAt = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Node& node = nodes[i];
+        size_t at = nodeOff + i * NODE_RECORD_BYTES;
+        put<int32_t>(buf, at, node.id);
+        put<uint8_t>(buf, at + 4, node.type == NodeType::Tank ? 0 : 1);
+        put<int32_t>(buf, at + 8, node.valveStatus);
+        put<uint32_t>(buf, at + 12, static_cast<uint32_t>(node.name.size()));
+        put<uint64_t>(buf, at + 16, nameAt);
+        put<double>(buf, at + 24, state.capacity[i]);
+        put<double>(buf, at + 32, state.level[i]);
+        memcpy(buf.data() + poolOff + nameAt, node.name.data(), node.name.size());
+        nameAt += node.name.size();
+    }
+    for (size_t i = 0; i < m; ++i) {
+        const Edge& e = edges[i];
+        size_t at = edgeOff + i * EDGE_RECORD_BYTES;
+        put<int32_t>(buf, at, e.from);
+        put<int32_t>(buf, at + 4, e.to);
+        put<double>(buf, at + 8, e.capacity);
+        put<double>(buf, at + 16, e.flowRate);
+        put<uint8_t>(buf, at + 24, e.active ? 1 : 0);
+        put<int32_t>(buf, at + 28, e.valveStatus);
+    }
+    if (t) {
+        put<uint64_t>(buf, csrOff, usable);
+        memcpy(buf.data() + csrOff + 8, t->offsets.data(), 4 * (n + 1));
+        memcpy(buf.data() + csrOff + 8 + 4 * (n + 1), t->targets.data(), 4 * usable);
+        memcpy(buf.data() + csrOff + 8 + 4 * (n + 1) + 4 * usable, t->edgeIds.data(), 4 * usable);
+    }
+
+    const string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "saveBinary: cannot create " << tmp << "\n";
+        return false;
+    }
+    size_t written = 0;
+    while (written < total) {
+        ssize_t w = ::write(fd, buf.data() + written, total - written);
+        if (w <= 0) break;
+        written += static_cast<size_t>(w);
+    }
+    bool ok = written == total && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        cerr << "saveBinary: failed to write " << path << "\n";
+        return false;
+    }
+    if (!syncParentDirectory(path)) {
+        cerr << "saveBinary: cannot sync the directory of " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Replaces this graph's network with the one in path. The file is mapped read-only and the
+// tables are copied straight into the node/edge/state arrays; when the CSR section is present
+// it is installed as the topology snapshot, so nothing goes through addNode/addEdge. Every offset,
+// id and CSR entry is checked against the file before use; a section that does not match the
+// edge table exactly is rejected as corrupt. On failure the graph is left empty.
+bool Graph::loadBinary(const string& path) {
+    if (!hostIsLittleEndian()) {
+        cerr << "loadBinary: big-endian hosts are not supported.\n";
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "loadBinary: cannot open " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < HEADER_BYTES) {
+        ::close(fd);
+        cerr << "loadBinary: " << path << " is too small to be a network file\n";
+        return false;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        cerr << "loadBinary: cannot map " << path << "\n";
+        return false;
+    }
+    const unsigned char* base = static_cast<const unsigned char*>(mapped);
+    auto fail = [&](const string& why) {
+        ::munmap(mapped, size);
+        clearNetwork();
+        cerr << "loadBinary: " << path << ": " << why << "\n";
+        return false;
+    };
+
+    if (memcmp(base, NETWORK_MAGIC, 8) != 0) return fail("bad magic");
+    if (get<uint32_t>(base, 8) != NETWORK_VERSION) return fail("unsupported version");
+    const uint32_t flags = get<uint32_t>(base, 12);
+    const uint64_t n = get<uint64_t>(base, 16), m = get<uint64_t>(base, 24), poolBytes = get<uint64_t>(base, 32);
+    const uint64_t nodeOff = get<uint64_t>(base, 40), edgeOff = get<uint64_t>(base, 48);
+    const uint64_t poolOff = get<uint64_t>(base, 56), csrOff = get<uint64_t>(base, 64);
+    if (n > size / NODE_RECORD_BYTES || m > size / EDGE_RECORD_BYTES || !fits(nodeOff, n * NODE_RECORD_BYTES, size) ||
+        !fits(edgeOff, m * EDGE_RECORD_BYTES, size) || !fits(poolOff, poolBytes, size)) {
+        return fail("truncated tables");
+    }
+
+    clearNetwork();
+    nodes.reserve(n);
+    state.level.reserve(n); state.capacity.reserve(n); state.isTank.reserve(n);
+    edges.reserve(m);
+    edgeIndexByKey.reserve(m);
+
+    for (uint64_t i = 0; i < n; ++i) {
+        const size_t at = nodeOff + i * NODE_RECORD_BYTES;
+        const int id = get<int32_t>(base, at);
+        const NodeType type = get<uint8_t>(base, at + 4) == 0 ? NodeType::Tank : NodeType::Industry;
+        const uint32_t nameLen = get<uint32_t>(base, at + 12);
+        const uint64_t nameAt = get<uint64_t>(base, at + 16);
+        if (id < 0 || id > MAX_NODE_ID || !fits(nameAt, nameLen, poolBytes)) return fail("corrupt node record");
+        if (id >= static_cast<int>(nodeSlotById.size())) nodeSlotById.resize(id + 1, -1);
+        if (nodeSlotById[id] != -1) return fail("duplicate node id " + to_string(id));
+        nodeSlotById[id] = static_cast<int>(i);
+        nodes.emplace_back(id, type, string(reinterpret_cast<const char*>(base + poolOff + nameAt), nameLen),
+                           get<int32_t>(base, at + 8));
+        state.push(get<double>(base, at + 24), type == NodeType::Tank);
+        state.level.back() = get<double>(base, at + 32);
+    }
+    for (uint64_t i = 0; i < m; ++i) {
+        const size_t at = edgeOff + i * EDGE_RECORD_BYTES;
+        edges.emplace_back(get<int32_t>(base, at), get<int32_t>(base, at + 4), get<double>(base, at + 8),
+                           get<double>(base, at + 16), get<uint8_t>(base, at + 24) != 0, get<int32_t>(base, at + 28));
+        if (!edgeIndexByKey.emplace(edgeKey(edges.back().from, edges.back().to), static_cast<int>(i)).second) {
+            return fail("duplicate edge " + to_string(edges.back().from) + "->" + to_string(edges.back().to));
+        }
+    }
+
+    bulkLoading = false;
+    rebuildOutgoingEdges(); // also invalidates the topology snapshot
+
+    if (flags & FLAG_HAS_CSR) {
+        if (!fits(csrOff, 8, size)) return fail("truncated CSR section");
+        const uint64_t usable = get<uint64_t>(base, csrOff);
+        if (usable > m || !fits(csrOff, 8 + 4 * (n + 1) + 8 * usable, size)) return fail("truncated CSR section");
+        const unsigned char* p = base + csrOff + 8;
+        csr.offsets.resize(n + 1);
+        csr.targets.resize(usable);
+        csr.edgeIds.resize(usable);
+        memcpy(csr.offsets.data(), p, 4 * (n + 1));
+        memcpy(csr.targets.data(), p + 4 * (n + 1), 4 * usable);
+        memcpy(csr.edgeIds.data(), p + 4 * (n + 1) + 4 * usable, 4 * usable);
+        csr.edgeToSlot.resize(m);
+        csr.edgeCapacity.resize(m);
+        csr.edgeFlowRate.resize(m);
+        for (uint64_t i = 0; i < m; ++i) {
+            csr.edgeToSlot[i] = getNodeSlot(edges[i].to);
+            csr.edgeCapacity[i] = edges[i].capacity;
+            csr.edgeFlowRate[i] = edges[i].flowRate;
+        }
+        // the section must be exactly what topology() would build: every usable pipe once, in its
+        // source slot's row, rows sorted by edge index, targets matching the edge table
+        uint64_t usableEdges = 0;
+        for (uint64_t i = 0; i < m; ++i) {
+            const Edge& e = edges[i];
+            if (e.active && e.valveStatus != 0 && csr.edgeToSlot[i] != -1 && getNodeSlot(e.from) != -1) ++usableEdges;
+        }
+        bool consistent = csr.offsets[0] == 0 && static_cast<uint64_t>(csr.offsets[n]) == usable && usableEdges == usable;
+        for (uint64_t u = 0; consistent && u < n; ++u) {
+            const int begin = csr.offsets[u], end = csr.offsets[u + 1];
+            if (begin > end || end > static_cast<int>(usable)) { consistent = false; break; }
+            for (int k = begin; k < end; ++k) {
+                const int e = csr.edgeIds[k];
+                if (e < 0 || static_cast<uint64_t>(e) >= m || (k > begin && e <= csr.edgeIds[k - 1]) ||
+                    !edges[e].active || edges[e].valveStatus == 0 || getNodeSlot(edges[e].from) != static_cast<int>(u) ||
+                    csr.edgeToSlot[e] == -1 || csr.targets[k] != csr.edgeToSlot[e]) {
+                    consistent = false;
+                    break;
+                }
+            }
+        }
+        if (!consistent) return fail("corrupt CSR section");
+        csrValid = true;
+    }
+
+    ::munmap(mapped, size);
+    return true;
+}
@@ -0,0 +1,106 @@
+#include "graph_kernels.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRAPH_HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+bool cpuHasAvx2() {
+#ifdef GRAPH_HAVE_AVX2_KERNELS
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+// ---------------- consumption clamp ----------------
+
+void consumeLevelsScalar(double* level, const double* factor, double scale, size_t n) {
+    for (size_t i = 0; i < n; ++i) level[i] = std::max(0.0, level[i] - factor[i] * scale);
+}
+
+#ifdef GRAPH_HAVE_AVX2_KERNELS
+__attribute__((target("avx2")))
+void consumeLevelsAvx2(double* level, const double* factor, double scale, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d s = _mm256_set1_pd(scale);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d l = _mm256_loadu_pd(level + i);
+        __m256d f = _mm256_loadu_pd(factor + i);
+        // max(level - f*scale, 0) keeps the scalar loop's result for finite inputs
+        _mm256_storeu_pd(level + i, _mm256_max_pd(_mm256_sub_pd(l, _mm256_mul_pd(f, s)), zero));
+    }
+    consumeLevelsScalar(level + i, factor + i, scale, n - i);
+}
+#else
+void consumeLevelsAvx2(double* level, const double* factor, double scale, size_t n) {
+    consumeLevelsScalar(level, factor, scale, n);
+}
+#endif
+
+void consumeLevels(double* level, const double* factor, double scale, size_t n) {
+    if (cpuHasAvx2()) consumeLevelsAvx2(level, factor, scale, n);
+    else consumeLevelsScalar(level, factor, scale, n);
+}
+
+// ---------------- below-prescribed filter and priority ----------------
+
+size_t selectTanksBelowScalar(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                              double prescribedLevel, int* outSlots, double* outScores) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!isTank[i] || level[i] >= prescribedLevel) continue;
+        outSlots[count] = static_cast<int>(i);
+        outScores[count] = (1.0 - level[i] / prescribedLevel) * capacity[i];
+        ++count;
+    }
+    return count;
+}
+
+#ifdef GRAPH_HAVE_AVX2_KERNELS
+__attribute__((target("avx2")))
+size_t selectTanksBelowAvx2(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                            double prescribedLevel, int* outSlots, double* outScores) {
+    const __m256d p = _mm256_set1_pd(prescribedLevel);
+    const __m256d one = _mm256_set1_pd(1.0);
+    alignas(32) double scores[4];
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d l = _mm256_loadu_pd(level + i);
+        int below = _mm256_movemask_pd(_mm256_cmp_pd(l, p, _CMP_LT_OQ));
+        int tanks = (isTank[i] ? 1 : 0) | (isTank[i + 1] ? 2 : 0) | (isTank[i + 2] ? 4 : 0) | (isTank[i + 3] ? 8 : 0);
+        int mask = below & tanks;
+        if (!mask) continue;
+        __m256d c = _mm256_loadu_pd(capacity + i);
+        _mm256_store_pd(scores, _mm256_mul_pd(_mm256_sub_pd(one, _mm256_div_pd(l, p)), c));
+        for (int lane = 0; lane < 4; ++lane) {
+            if (!(mask & (1 << lane))) continue;
+            outSlots[count] = static_cast<int>(i + lane);
+            outScores[count] = scores[lane];
+            ++count;
+        }
+    }
+    for (; i < n; ++i) {
+        if (!isTank[i] || level[i] >= prescribedLevel) continue;
+        outSlots[count] = static_cast<int>(i);
+        outScores[count] = (1.0 - level[i] / prescribedLevel) * capacity[i];
+        ++count;
+    }
+    return count;
+}
+#else
+size_t selectTanksBelowAvx2(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                            double prescribedLevel, int* outSlots, double* outScores) {
+    return selectTanksBelowScalar(level, capacity, isTank, n, prescribedLevel, outSlots, outScores);
+}
+#endif
+
+size_t selectTanksBelow(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                        double prescribedLevel, int* outSlots, double* outScores) {
+    if (cpuHasAvx2()) return selectTanksBelowAvx2(level, capacity, isTank, n, prescribedLevel, outSlots, outScores);
+    return selectTanksBelowScalar(level, capacity, isTank, n, prescribedLevel, outSlots, outScores);
+}
@@ -0,0 +1,27 @@
+#ifndef GRAPH_KERNELS_H
+#define GRAPH_KERNELS_H
+
+#include <cstddef>
+
+// Vector kernels over the NodeState columns. The unsuffixed entry points pick the AVX2 version
+// at runtime when the CPU supports it and fall back to the scalar loop otherwise; the explicit
+// variants are exposed for benchmarking.
+
+bool cpuHasAvx2();
+
+// level[i] = max(0, level[i] - factor[i] * scale)
+void consumeLevels(double* level, const double* factor, double scale, size_t n);
+void consumeLevelsScalar(double* level, const double* factor, double scale, size_t n);
+void consumeLevelsAvx2(double* level, const double* factor, double scale, size_t n);
+
+// Collects the tanks with level < prescribedLevel, in slot order, together with their refill
+// priority (1 - level / prescribedLevel) * capacity. Output arrays must hold n entries.
+// Returns the number of tanks selected.
+size_t selectTanksBelow(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                        double prescribedLevel, int* outSlots, double* outScores);
+size_t selectTanksBelowScalar(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                              double prescribedLevel, int* outSlots, double* outScores);
+size_t selectTanksBelowAvx2(const double* level, const double* capacity, const unsigned char* isTank, size_t n,
+                            double prescribedLevel, int* outSlots, double* outScores);
+
+#endif // GRAPH_KERNELS_H
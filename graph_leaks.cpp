@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cmath>
+#include "graph.h"
+
+// ---------------- leak detector ----------------
+
+// Shortfalls below this ratio are treated as total loss, which keeps the log finite.
+static const double MIN_RETENTION = 1e-6;
+
+void LeakDetector::observe(const vector<int>& path, double expected, double actual, vector<int>* newlyFlagged) {
+    if (path.empty() || expected <= 0.0) return;
+    int maxIdx = *max_element(path.begin(), path.end());
+    if (maxIdx >= static_cast<int>(pipes.size())) pipes.resize(maxIdx + 1);
+
+    double retention = min(1.0, max(MIN_RETENTION, actual / expected));
+    double observed = -log(retention);
+    double predicted = 0.0, suspicion = 0.0;
+    for (int eidx : path) {
+        predicted += pipes[eidx].loss;
+        suspicion += 1.0 / (1.0 + pipes[eidx].cleanEvidence);
+    }
+
+    // weighted Kaczmarz step, estimates never go negative: unexplained loss goes to the pipes in
+    // proportion to 1 / (1 + clean evidence), an over-prediction is taken back in proportion to loss
+    const double residual = observed - predicted;
+    const bool lossy = observed > config.allowance;
+    double total = 0.0;
+    for (int eidx : path) {
+        PipeLeakStats& p = pipes[eidx];
+        double weight = residual >= 0.0 ? (1.0 / (1.0 + p.cleanEvidence)) / suspicion
+                                        : (predicted > 0.0 ? p.loss / predicted : 0.0);
+        p.loss = max(0.0, p.loss + config.learningRate * residual * weight);
+        p.cleanEvidence = lossy ? p.cleanEvidence * config.cleanDecay : p.cleanEvidence + 1.0;
+        ++p.observations;
+        total += p.loss;
+    }
+
+    // blame follows each pipe's share of the path estimate on lossy deliveries and decays on clean ones
+    const double a = config.blameSmoothing;
+    for (int eidx : path) {
+        PipeLeakStats& p = pipes[eidx];
+        double share = total > 0.0 ? p.loss / total : 1.0 / static_cast<double>(path.size());
+        p.blame = (1.0 - a) * p.blame + (lossy ? a * share : 0.0);
+        p.cusum = max(0.0, p.cusum + p.loss - config.allowance);
+        if (!p.flagged && p.cusum >= config.threshold && p.blame >= config.minConfidence) {
+            p.flagged = true;
+            ++flaggedPipes;
+            if (newlyFlagged) newlyFlagged->push_back(eidx);
+        }
+    }
+}
+
+double LeakDetector::lossFraction(int edgeIdx) const {
+    if (edgeIdx >= static_cast<int>(pipes.size())) return 0.0;
+    return 1.0 - exp(-pipes[edgeIdx].loss);
+}
+
+bool LeakDetector::empty() const {
+    if (flaggedPipes > 0) return false;
+    for (const PipeLeakStats& p : pipes) {
+        if (p.observations > 0) return false;
+    }
+    return true;
+}
+
+const PipeLeakStats* LeakDetector::stats(int edgeIdx) const {
+    return edgeIdx >= 0 && edgeIdx < static_cast<int>(pipes.size()) ? &pipes[edgeIdx] : nullptr;
+}
+
+void LeakDetector::flaggedOn(const vector<int>& path, vector<int>& out) const {
+    out.clear();
+    if (flaggedPipes == 0) return;
+    for (int eidx : path) {
+        if (flagged(eidx)) out.push_back(eidx);
+    }
+}
+
+void LeakDetector::setStats(int edgeIdx, const PipeLeakStats& s) {
+    if (edgeIdx < 0) return;
+    clearPipe(edgeIdx);
+    if (edgeIdx >= static_cast<int>(pipes.size())) pipes.resize(edgeIdx + 1);
+    pipes[edgeIdx] = s;
+    if (s.flagged) ++flaggedPipes;
+}
+
+void LeakDetector::clearPipe(int edgeIdx) {
+    if (edgeIdx < 0 || edgeIdx >= static_cast<int>(pipes.size())) return;
+    if (pipes[edgeIdx].flagged) --flaggedPipes;
+    pipes[edgeIdx] = PipeLeakStats();
+}
+
+void LeakDetector::movePipe(int fromIdx, int toIdx) {
+    clearPipe(toIdx);
+    if (fromIdx >= static_cast<int>(pipes.size())) return;
+    if (toIdx >= static_cast<int>(pipes.size())) pipes.resize(toIdx + 1);
+    pipes[toIdx] = pipes[fromIdx];
+    pipes[fromIdx] = PipeLeakStats(); // the flag count moves with the stats
+}
+
+void LeakDetector::truncate(size_t edgeCount) {
+    for (size_t i = edgeCount; i < pipes.size(); ++i) {
+        if (pipes[i].flagged) --flaggedPipes;
+    }
+    if (pipes.size() > edgeCount) pipes.resize(edgeCount);
+}
+
+void LeakDetector::reset() {
+    pipes.clear();
+    flaggedPipes = 0;
+}
+
+// ---------------- simulation hooks ----------------
+
+// Fraction of the water entering path that reaches its end, given the pipes' simulated losses.
+double Graph::pathRetention(const vector<int>& path) const {
+    double retention = 1.0;
+    for (int eidx : path) retention *= 1.0 - edges[eidx].lossFraction;
+    return retention;
+}
+
+// Swaps path for a route around the pipes on it that the detector has flagged. When every route
+// crosses one of them the original path is kept. One BFS, and only when a flagged pipe is on the path.
+void Graph::steerAroundLeaks(int sourceId, int targetId, vector<int>& path) const {
+    if (leaks.flaggedCount() == 0) return;
+    vector<int> suspects, detour;
+    leaks.flaggedOn(path, suspects);
+    if (suspects.empty()) return;
+    if (findPath(sourceId, targetId, detour, suspects)) path.swap(detour);
+}
+
+// Feeds a delivery to the detector and reports the pipes it flags.
+void Graph::recordDelivery(const vector<int>& path, double expected, double actual) {
+    vector<int> newlyFlagged;
+    leaks.observe(path, expected, actual, &newlyFlagged);
+    for (int eidx : newlyFlagged) {
+        const Edge& e = edges[eidx];
+        logEvent(LogKind::PipeFlagged, e.from, e.to, 0, leaks.confidence(eidx), leaks.lossFraction(eidx));
+        for (auto* o : observers) o->onPipeFlagged(*this, e.from, e.to, leaks.confidence(eidx));
+    }
+}
+
+// After a suspicious delivery to tankId along path, retries once around the flagged pipes on that path.
+// While nothing on the path is flagged the detector is still narrowing the leak down and no retry is
+// made. claimRate, when given, returns the rate the detour may use and reserves it; a detour with
+// nothing left to use counts as no detour. Returns the volume the retry delivered.
+double Graph::retryAroundLeaks(int sourceId, int tankId, const vector<int>& path, int intervalSec,
+                               const function<double(const vector<int>&)>& claimRate) {
+    vector<int> suspects, altPath;
+    leaks.flaggedOn(path, suspects);
+    if (suspects.empty()) return 0.0;
+
+    double maxRate = numeric_limits<double>::infinity();
+    bool found = findPath(sourceId, tankId, altPath, suspects);
+    if (found && claimRate) {
+        maxRate = claimRate(altPath);
+        found = maxRate > 0.0;
+    }
+    if (!found) {
+        logEvent(LogKind::NoAlternate, tankId);
+        for (auto* o : observers) o->onAlternateRoute(*this, tankId, false, 0.0, 0.0);
+        return 0.0;
+    }
+    auto [expected, actual] = supplyWaterAlongPath(sourceId, altPath, intervalSec, maxRate);
+    recordDelivery(altPath, expected, actual);
+    for (auto* o : observers) o->onAlternateRoute(*this, tankId, true, expected, actual);
+    if (expected > 0 && actual < leakThreshold * expected) {
+        logEvent(LogKind::AlternateLeaking, tankId);
+    } else {
+        logEvent(LogKind::AlternateOk, tankId);
+    }
+    return actual;
+}
@@ -0,0 +1,66 @@
+#ifndef GRAPH_LEAKS_H
+#define GRAPH_LEAKS_H
+
+#include "graph_types.h"
+
+// Rolling statistics for one pipe, indexed like Graph::edges.
+struct PipeLeakStats {
+    double loss = 0.0;          // estimated -ln(fraction that survives the pipe)
+    double cusum = 0.0;         // one-sided CUSUM of loss above the allowance
+    double blame = 0.0;         // EWMA share of the unexplained loss put on this pipe; the confidence
+    double cleanEvidence = 0.0; // clean deliveries through the pipe, halved by every lossy one
+    unsigned observations = 0;  // deliveries that crossed the pipe
+    bool flagged = false;       // sticky until clearPipe (repair) or reset
+};
+
+// Streaming leak localisation. Each delivery gives one equation: the log of the shortfall,
+// -ln(actual / expected), is the sum of the per-pipe log losses along its path. observe() takes one
+// projected, weighted Kaczmarz step on that equation. Unexplained loss goes mostly to the pipes with
+// little clean evidence, i.e. the ones no clean delivery has vouched for; an over-prediction is taken
+// back from the pipes in proportion to their estimates. So the loss settles on the pipes that only
+// the short paths have in common.
+// A pipe is flagged once its CUSUM passes the threshold and it carries at least minConfidence of the
+// loss on the paths through it. Every update is O(path length).
+class LeakDetector {
+public:
+    struct Config {
+        double learningRate = 0.5;   // fraction of the residual corrected per delivery, in (0, 1]
+        double cleanDecay = 0.5;     // factor applied to a pipe's clean evidence by a lossy delivery
+        double allowance = 0.01;     // log loss per pipe treated as noise (about 1%)
+        double threshold = 0.2;      // CUSUM level that flags a pipe
+        double minConfidence = 0.3;  // blame a flagged pipe must carry
+        double blameSmoothing = 0.2; // EWMA weight of the newest delivery in blame
+    };
+
+    Config config;
+
+    // Feeds one delivery along path (edge indices). Pipes flagged by this delivery are appended to
+    // newlyFlagged when it is given. Deliveries with expected <= 0 carry no information and are skipped.
+    void observe(const vector<int>& path, double expected, double actual, vector<int>* newlyFlagged = nullptr);
+
+    bool flagged(int edgeIdx) const { return edgeIdx < static_cast<int>(pipes.size()) && pipes[edgeIdx].flagged; }
+    double confidence(int edgeIdx) const { return edgeIdx < static_cast<int>(pipes.size()) ? pipes[edgeIdx].blame : 0.0; }
+    // estimated fraction of the water entering the pipe that is lost
+    double lossFraction(int edgeIdx) const;
+    const PipeLeakStats* stats(int edgeIdx) const;
+    size_t flaggedCount() const { return flaggedPipes; }
+    // true while no pipe has seen a delivery or carries a flag
+    bool empty() const;
+    // appends the flagged pipes of path to out (out is cleared first)
+    void flaggedOn(const vector<int>& path, vector<int>& out) const;
+
+    // installs saved statistics for a pipe (checkpoint restore)
+    void setStats(int edgeIdx, const PipeLeakStats& s);
+    // the pipe was repaired: forget what was learned about it
+    void clearPipe(int edgeIdx);
+    // Graph::removeEdge moved the last pipe into a freed index
+    void movePipe(int fromIdx, int toIdx);
+    void truncate(size_t edgeCount);
+    void reset();
+
+private:
+    vector<PipeLeakStats> pipes;
+    size_t flaggedPipes = 0;
+};
+
+#endif // GRAPH_LEAKS_H
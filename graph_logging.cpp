@@ -1,34 +1,134 @@
-#include "graph.h"
-#include <iostream>
-
-string LogEntry::toString() const {
-    ostringstream oss;
-    int mm = simTimeSec / 60;
-    int ss = simTimeSec % 60;
-    oss << "[" << setw(2) << setfill('0') << mm << ":" << setw(2) << setfill('0') << ss << "] " << message;
-    return oss.str();
-}
-
-void Graph::pushLog(const string& message) {
-    history.emplace_back(LogEntry{simTimeSec, message});
-}
-
-void Graph::printLastKLogs(int k) const {
-    if (history.empty()) {
-        cout << "(No history yet)\n";
-        return;
-    }
-    int n = static_cast<int>(history.size());
-    int start = max(0, n - k);
-    for (int i = n - 1; i >= start; --i) {
-        cout << history[i].toString() << "\n";
-    }
-}
-
-string Graph::formatTime(int seconds) {
-    int mm = seconds / 60;
-    int ss = seconds % 60;
-    ostringstream oss;
-    oss << setw(2) << setfill('0') << mm << ":" << setw(2) << setfill('0') << ss;
-    return oss.str();
-}
\ No newline at end of file
+#include "graph.h"
+#include "graph_metrics.h"
+#include <iostream>
+
+void Graph::pushLog(const string& message) {
+    METRIC_SCOPE(Logging);
+    history.pushMessage(simTimeSec, message);
+}
+
+void Graph::logEvent(LogKind kind, int nodeId, int aux, int aux2, double v0, double v1, double v2, double v3) {
+    METRIC_SCOPE(Logging);
+    history.push(LogEntry{kind, simTimeSec, nodeId, aux, aux2, {v0, v1, v2, v3}});
+}
+
+// Renders the record's message (without the time prefix). Node names are looked up now,
+// so a record shows the node's current name.
+string Graph::formatLogMessage(const LogEntry& e, const string& text) const {
+    ostringstream oss;
+    const double* v = e.value;
+    switch (e.kind) {
+        case LogKind::Message:
+            return text;
+        case LogKind::Consumption:
+            oss << (e.aux ? "Tank " : "Industry ") << e.nodeId << " consumed " << v[0]
+                << " units (before=" << v[1] << ", after=" << v[2] << ")";
+            break;
+        case LogKind::BelowPrescribed: {
+            const Node* n = getNodeByIdConst(e.nodeId);
+            oss << "Tank " << e.nodeId << " (" << (n ? n->name : string()) << ") below prescribed level: "
+                << v[0] << " < " << v[1] << " | Priority: " << v[2];
+            break;
+        }
+        case LogKind::Supply:
+            oss << "Supplied to Tank " << e.nodeId << " via " << e.aux2 << "-pipe path from " << e.aux
+                << " expected=" << v[0] << " actual=" << v[1]
+                << " (before=" << v[2] << ", after=" << v[3] << ")";
+            break;
+        case LogKind::MaxFlowSupply:
+            oss << "Max-flow supplied to Tank " << e.nodeId << " rate=" << v[0]
+                << " actual=" << v[1] << " (before=" << v[2] << ", after=" << v[3] << ")";
+            break;
+        case LogKind::NoPath:
+            oss << "No available path from source " << e.aux << " to tank " << e.nodeId;
+            break;
+        case LogKind::LeakSuspected:
+            oss << "Leak suspected on path to Tank " << e.nodeId << " (expected=" << v[0] << ", actual=" << v[1] << ")";
+            break;
+        case LogKind::AlternateLeaking:
+            oss << "Alternate route also suspected leaking for Tank " << e.nodeId;
+            break;
+        case LogKind::AlternateOk:
+            oss << "Alternate route delivered adequately to Tank " << e.nodeId;
+            break;
+        case LogKind::NoAlternate:
+            oss << "No alternate route available for Tank " << e.nodeId << ". Please inspect pipes.";
+            break;
+        case LogKind::QueueCarryOver:
+            oss << e.aux << " tanks processed this step. " << e.aux2 << " tanks remaining in queue for next step.";
+            break;
+        case LogKind::NodeRemoved:
+            oss << "Node " << e.nodeId << " removed.";
+            break;
+        case LogKind::NodeCapacitySet:
+            oss << "Node " << e.nodeId << " capacity set to " << v[0];
+            break;
+        case LogKind::NodeTypeChanged:
+            oss << "Node " << e.nodeId << " type changed.";
+            break;
+        case LogKind::NodeValveSet:
+            oss << "Node " << e.nodeId << " valveStatus set to " << e.aux;
+            break;
+        case LogKind::EdgeRemoved:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " removed.";
+            break;
+        case LogKind::EdgeActivated:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " activated by user.";
+            break;
+        case LogKind::EdgeDeactivated:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " deactivated by user.";
+            break;
+        case LogKind::EdgeActiveSet:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " active set to " << (e.aux2 ? "true" : "false");
+            break;
+        case LogKind::EdgeCapacitySet:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " capacity set to " << v[0];
+            break;
+        case LogKind::EdgeFlowRateSet:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " flowRate set to " << v[0];
+            break;
+        case LogKind::EdgeValveSet:
+            oss << "Edge " << e.nodeId << "->" << e.aux << " valve set to " << e.aux2;
+            break;
+        case LogKind::EditBatch:
+            oss << "Batch of " << e.aux << " edits applied (" << v[0] << " node, " << v[1] << " pipe; "
+                << e.aux2 << " changed routing)";
+            break;
+        case LogKind::PipeFlagged:
+            oss << "Pipe " << e.nodeId << "->" << e.aux << " flagged as leaking (confidence=" << v[0]
+                << ", estimated loss=" << v[1] * 100 << "%)";
+            break;
+    }
+    return oss.str();
+}
+
+// i = 0 is the oldest retained record
+string Graph::formatLog(size_t i) const {
+    const LogEntry& e = history[i];
+    return "[" + formatTime(e.simTimeSec) + "] " + formatLogMessage(e, history.text(i));
+}
+
+void Graph::printLastKLogs(int k) const {
+    if (history.empty()) {
+        cout << "(No history yet)\n";
+        return;
+    }
+    int n = static_cast<int>(history.size());
+    int start = max(0, n - k);
+    for (int i = n - 1; i >= start; --i) {
+        cout << formatLog(i) << "\n";
+    }
+}
+
+// Writes every retained record, oldest first, one line each
+void Graph::exportLogs(ostream& out) const {
+    for (size_t i = 0; i < history.size(); ++i) out << formatLog(i) << "\n";
+}
+
+string Graph::formatTime(int seconds) {
+    int mm = seconds / 60;
+    int ss = seconds % 60;
+    ostringstream oss;
+    oss << setw(2) << setfill('0') << mm << ":" << setw(2) << setfill('0') << ss;
+    return oss.str();
+}
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "graph.h"
+#include "graph_metrics.h"
+
+// ---------------- max-flow allocation (Dinic) ----------------
+
+namespace {
+
+const double FLOW_EPS = 1e-9;
+
+// Residual network for Dinic's algorithm. Arcs are stored in pairs so arc ^ 1 is the reverse arc.
+struct FlowNetwork {
+    vector<int> head, next, to;
+    vector<double> cap;
+    vector<int> level, iter, queue, stack;
+
+    void init(int nodeCount, int arcHint) {
+        head.assign(nodeCount, -1);
+        next.clear(); to.clear(); cap.clear();
+        next.reserve(arcHint); to.reserve(arcHint); cap.reserve(arcHint);
+        level.resize(nodeCount);
+        queue.resize(nodeCount);
+    }
+
+    int addArc(int u, int v, double c) {
+        int a = static_cast<int>(to.size());
+        to.push_back(v); cap.push_back(c); next.push_back(head[u]); head[u] = a;
+        to.push_back(u); cap.push_back(0.0); next.push_back(head[v]); head[v] = a + 1;
+        return a;
+    }
+
+    bool buildLevels(int s, int t) {
+        fill(level.begin(), level.end(), -1);
+        int qh = 0, qt = 0;
+        queue[qt++] = s;
+        level[s] = 0;
+        while (qh < qt) {
+            int u = queue[qh++];
+            for (int a = head[u]; a != -1; a = next[a]) {
+                if (cap[a] > FLOW_EPS && level[to[a]] == -1) {
+                    level[to[a]] = level[u] + 1;
+                    queue[qt++] = to[a];
+                }
+            }
+        }
+        return level[t] != -1;
+    }
+
+    // Blocking flow with an explicit arc stack, so long pipe chains cannot overflow the call stack.
+    double blockingFlow(int s, int t) {
+        double total = 0.0;
+        iter = head;
+        stack.clear();
+        int u = s;
+        while (true) {
+            if (u == t) {
+                double f = numeric_limits<double>::infinity();
+                for (int a : stack) f = min(f, cap[a]);
+                size_t cut = stack.size();
+                for (size_t i = 0; i < stack.size(); ++i) {
+                    int a = stack[i];
+                    cap[a] -= f;
+                    cap[a ^ 1] += f;
+                    if (cut == stack.size() && cap[a] <= FLOW_EPS) cut = i;
+                }
+                total += f;
+                stack.resize(cut); // resume from the tail of the first saturated arc
+                u = stack.empty() ? s : to[stack.back()];
+                continue;
+            }
+            int& a = iter[u];
+            while (a != -1 && !(cap[a] > FLOW_EPS && level[to[a]] == level[u] + 1)) a = next[a];
+            if (a == -1) {
+                if (u == s) break;
+                level[u] = -1; // dead end for this phase
+                stack.pop_back();
+                u = stack.empty() ? s : to[stack.back()];
+                continue;
+            }
+            stack.push_back(a);
+            u = to[a];
+        }
+        return total;
+    }
+
+    double maxFlow(int s, int t) {
+        double total = 0.0;
+        while (buildLevels(s, t)) total += blockingFlow(s, t);
+        return total;
+    }
+};
+
+// Splits the flow held in the reverse arcs of net into source-to-sink paths and calls
+// visit(arcs, flow) for each one; flow cycles are cancelled on the way. Consumes the flow.
+template <class Visit>
+void decomposeFlow(FlowNetwork& net, int s, int t, Visit visit) {
+    vector<int> depth(net.head.size(), -1); // arcs on the stack when the node was reached, -1 when off it
+    vector<int>& stack = net.stack;
+    net.iter = net.head;
+    stack.clear();
+    depth[s] = 0;
+    int u = s;
+    while (true) {
+        if (u == t) {
+            double f = numeric_limits<double>::infinity();
+            for (int a : stack) f = min(f, net.cap[a ^ 1]);
+            for (int a : stack) net.cap[a ^ 1] -= f;
+            visit(stack, f);
+            for (int a : stack) depth[net.to[a]] = -1;
+            stack.clear();
+            u = s;
+            continue;
+        }
+        int& a = net.iter[u];
+        while (a != -1 && !((a & 1) == 0 && net.cap[a ^ 1] > FLOW_EPS)) a = net.next[a];
+        if (a == -1) {
+            if (u == s) break;
+            net.cap[stack.back() ^ 1] = 0.0; // rounding residue: nothing leaves u
+            stack.pop_back();
+            depth[u] = -1;
+            u = stack.empty() ? s : net.to[stack.back()];
+            continue;
+        }
+        int v = net.to[a];
+        if (depth[v] != -1) { // a flow cycle through v: cancel it and carry on from v
+            const size_t start = depth[v];
+            double f = net.cap[a ^ 1];
+            for (size_t i = start; i < stack.size(); ++i) f = min(f, net.cap[stack[i] ^ 1]);
+            net.cap[a ^ 1] -= f;
+            for (size_t i = start; i < stack.size(); ++i) {
+                net.cap[stack[i] ^ 1] -= f;
+                depth[net.to[stack[i]]] = -1;
+            }
+            stack.resize(start);
+            u = v;
+            continue;
+        }
+        stack.push_back(a);
+        depth[v] = static_cast<int>(stack.size());
+        u = v;
+    }
+}
+
+} // namespace
+
+// Solves one multi-sink max-flow from the source to every tank in tankIds and applies the result.
+// Pipes carry at most 0.8 * min(capacity, flowRate) (the same supply factor as supplyWaterAlongPath);
+// each tank is a sink whose capacity is the rate that would fill it within the interval, so bigger
+// shortfalls can draw proportionally more flow. Closed or inactive pipes are not in the CSR snapshot.
+// Pipes the leak detector has flagged join the network only after the flow around them is maxed
+// out, so they carry just what no other route can. The flow is then split into source-to-tank
+// paths: each path loses what its pipes' simulated leaks take (pathRetention) and is fed to the
+// leak detector like a greedy delivery. Returns the total volume delivered.
+double Graph::supplyWaterMaxFlow(int sourceId, const vector<int>& tankIds, int intervalSec) {
+    METRIC_SCOPE(MaxFlow);
+    const CsrTopology& t = topology();
+    int sourceSlot = getNodeSlot(sourceId);
+    if (sourceSlot == -1 || intervalSec <= 0 || tankIds.empty()) return 0.0;
+
+    const int n = t.nodeCount();
+    const int sink = n;
+    FlowNetwork net;
+    net.init(n + 1, 2 * (static_cast<int>(t.targets.size()) + static_cast<int>(tankIds.size())));
+
+    vector<pair<int,int>> pipeArcs; // (edge index, arc index), kept only when edge flows are recorded
+    vector<int> arcOwner;           // by arc / 2: edge index of a pipe arc, ~tank index of a sink arc
+    vector<pair<int,int>> flagged;  // (node slot, CSR position) of the pipes added last
+    auto addPipe = [&](int u, int pos) {
+        int eidx = t.edgeIds[pos];
+        int arc = net.addArc(u, t.targets[pos], 0.8 * min(t.edgeCapacity[eidx], t.edgeFlowRate[eidx]));
+        arcOwner.push_back(eidx);
+        if (recordEdgeFlows) pipeArcs.emplace_back(eidx, arc);
+    };
+    for (int u = 0; u < n; ++u) {
+        for (int pos = t.offsets[u]; pos < t.offsets[u + 1]; ++pos) {
+            int eidx = t.edgeIds[pos];
+            if (0.8 * min(t.edgeCapacity[eidx], t.edgeFlowRate[eidx]) <= FLOW_EPS) continue;
+            if (leaks.flagged(eidx)) {
+                flagged.emplace_back(u, pos);
+            } else {
+                addPipe(u, pos);
+            }
+        }
+    }
+
+    vector<pair<int,int>> sinkArcs; // (node slot, arc index)
+    vector<double> demandRate;
+    for (int id : tankIds) {
+        int slot = getNodeSlot(id);
+        if (slot == -1 || id == sourceId) continue;
+        double remaining = max(0.0, state.capacity[slot] - state.level[slot]);
+        if (remaining <= 0.0) continue;
+        double rate = remaining / intervalSec;
+        arcOwner.push_back(~static_cast<int>(sinkArcs.size()));
+        sinkArcs.emplace_back(slot, net.addArc(slot, sink, rate));
+        demandRate.push_back(rate);
+    }
+    if (sinkArcs.empty()) return 0.0;
+
+    net.maxFlow(sourceSlot, sink);
+    if (!flagged.empty()) {
+        // Dinic continues from the flow it has, so the second pass only adds what needs a flagged pipe
+        for (const auto& [u, pos] : flagged) addPipe(u, pos);
+        net.maxFlow(sourceSlot, sink);
+    }
+    if (!pipeArcs.empty()) {
+        if (edgeFlow.size() < edges.size()) edgeFlow.resize(edges.size(), 0.0);
+        for (const auto& [eidx, arc] : pipeArcs) edgeFlow[eidx] += net.cap[arc + 1] * intervalSec; // reverse arc holds the flow
+    }
+    for (size_t i = 0; i < sinkArcs.size(); ++i) demandRate[i] -= net.cap[sinkArcs[i].second]; // now the rate received
+
+    vector<double> lost(sinkArcs.size(), 0.0);
+    vector<int> path;
+    decomposeFlow(net, sourceSlot, sink, [&](const vector<int>& arcs, double f) {
+        path.clear();
+        for (size_t k = 0; k + 1 < arcs.size(); ++k) path.push_back(arcOwner[arcs[k] >> 1]);
+        double expected = f * intervalSec;
+        double actual = expected * pathRetention(path);
+        lost[~arcOwner[arcs.back() >> 1]] += expected - actual;
+        recordDelivery(path, expected, actual);
+    });
+
+    double sent = 0.0, delivered = 0.0;
+    for (size_t i = 0; i < sinkArcs.size(); ++i) {
+        double rate = demandRate[i];
+        if (rate <= FLOW_EPS) continue;
+        int slot = sinkArcs[i].first;
+        double& level = state.level[slot];
+        double before = level;
+        double expected = rate * intervalSec;
+        level = min(level + max(0.0, expected - lost[i]), state.capacity[slot]);
+        double actual = level - before;
+        sent += expected;
+        delivered += actual;
+        logEvent(LogKind::MaxFlowSupply, nodes[slot].id, 0, 0, rate, actual, before, level);
+        if (actual < leakThreshold * expected) {
+            METRIC_ADD(LeakAlerts, 1);
+            logEvent(LogKind::LeakSuspected, nodes[slot].id, 0, 0, expected, actual);
+            for (auto* o : observers) o->onLeakSuspected(*this, nodes[slot].id, expected, actual);
+        }
+    }
+
+    // If source is a normal tank (not reservoir), reduce its level by what left it
+    if (sourceId != 0) {
+        state.level[sourceSlot] = max(0.0, state.level[sourceSlot] - sent);
+    }
+    return delivered;
+}
@@ -0,0 +1,289 @@
+#include "graph_metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+static const char* const PHASE_NAMES[] = {"step", "consumption", "priority_queue", "routing", "supply",
+                                          "max_flow", "batched_refill", "observers", "logging"};
+static const char* const COUNTER_NAMES[] = {"steps", "bfs_nodes_visited", "paths_found", "paths_failed",
+                                            "leak_alerts", "allocations", "allocated_bytes"};
+static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == static_cast<size_t>(MetricPhase::Count),
+              "one name per phase");
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == static_cast<size_t>(MetricCounter::Count),
+              "one name per counter");
+
+const char* metricPhaseName(MetricPhase phase) { return PHASE_NAMES[static_cast<size_t>(phase)]; }
+const char* metricCounterName(MetricCounter counter) { return COUNTER_NAMES[static_cast<size_t>(counter)]; }
+
+#ifdef GRAPH_METRICS
+
+// ---------------- clock ----------------
+
+static uint64_t nowTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+static const uint64_t startTicks = nowTicks();
+static const chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+// TSC rate measured against steady_clock over the whole run so far (at least 20 ms).
+static double ticksPerSecond() {
+#if defined(__x86_64__) || defined(__i386__)
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    if (elapsed < 0.02) {
+        this_thread::sleep_for(chrono::duration<double>(0.02 - elapsed));
+    }
+    elapsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    return static_cast<double>(nowTicks() - startTicks) / elapsed;
+#else
+    return 1e9;
+#endif
+}
+
+// ---------------- per-thread storage ----------------
+
+static const size_t PHASES = static_cast<size_t>(MetricPhase::Count);
+static const size_t COUNTERS = static_cast<size_t>(MetricCounter::Count);
+static const size_t HISTOGRAM_BUCKETS = 65; // bucket b holds per-step times in [2^(b-1), 2^b) ticks
+static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+struct TraceEvent {
+    uint64_t begin;
+    uint64_t end;
+    MetricPhase phase;
+};
+
+struct ThreadMetrics {
+    unsigned tid = 0;
+    uint64_t phaseTicks[PHASES] = {};
+    uint64_t phaseCalls[PHASES] = {};
+    unsigned depth[PHASES] = {};       // open scopes of each phase on this thread
+    uint64_t stepTicks[PHASES] = {};   // time in each phase during the current step
+    uint64_t stepSum[PHASES] = {};     // sum of the values put in the histogram
+    uint64_t histogram[PHASES][HISTOGRAM_BUCKETS] = {};
+    uint64_t counters[COUNTERS] = {};
+    vector<TraceEvent> trace;
+    uint64_t droppedEvents = 0;
+};
+
+// Blocks live until exit, so a thread's figures survive the thread (pool and ensemble workers).
+static mutex registryMtx;
+static vector<unique_ptr<ThreadMetrics>> registry;
+static thread_local ThreadMetrics* localMetrics = nullptr;
+
+// Allocation counts come from operator new, which must not allocate itself; they are global atomics.
+static atomic<uint64_t> allocationCount{0};
+static atomic<uint64_t> allocatedBytes{0};
+
+static ThreadMetrics& local() {
+    if (!localMetrics) {
+        lock_guard<mutex> lock(registryMtx);
+        registry.emplace_back(new ThreadMetrics);
+        localMetrics = registry.back().get();
+        localMetrics->tid = static_cast<unsigned>(registry.size());
+    }
+    return *localMetrics;
+}
+
+static size_t bucketOf(uint64_t ticks) {
+    size_t b = 0;
+    while (ticks) {
+        ++b;
+        ticks >>= 1;
+    }
+    return b;
+}
+
+MetricScope::MetricScope(MetricPhase phase, bool stepOnly) : phase(phase), stepOnly(stepOnly), begin(nowTicks()) {
+    ThreadMetrics& m = local();
+    if (phase == MetricPhase::Step && m.depth[static_cast<size_t>(MetricPhase::Step)] == 0) {
+        for (size_t p = 0; p < PHASES; ++p) m.stepTicks[p] = 0;
+    }
+    ++m.depth[static_cast<size_t>(phase)];
+}
+
+MetricScope::~MetricScope() {
+    uint64_t end = nowTicks();
+    uint64_t ticks = end - begin;
+    ThreadMetrics& m = local();
+    size_t p = static_cast<size_t>(phase);
+    if (!stepOnly) {
+        m.phaseTicks[p] += ticks;
+        m.phaseCalls[p] += 1;
+    }
+    // per-step figures: wall time on the stepping thread, outermost scope of each phase only
+    if (--m.depth[p] == 0 && (phase == MetricPhase::Step || m.depth[static_cast<size_t>(MetricPhase::Step)] > 0)) {
+        m.stepTicks[p] += ticks;
+    }
+    if (phase != MetricPhase::Logging && !stepOnly) {
+        if (m.trace.size() < MAX_TRACE_EVENTS) {
+            m.trace.push_back(TraceEvent{begin, end, phase});
+        } else {
+            ++m.droppedEvents;
+        }
+    }
+    if (phase == MetricPhase::Step && m.depth[p] == 0) {
+        for (size_t q = 0; q < PHASES; ++q) {
+            if (m.stepTicks[q] == 0) continue;
+            m.histogram[q][bucketOf(m.stepTicks[q])] += 1;
+            m.stepSum[q] += m.stepTicks[q];
+            m.stepTicks[q] = 0;
+        }
+    }
+}
+
+void metricAdd(MetricCounter counter, uint64_t n) {
+    local().counters[static_cast<size_t>(counter)] += n;
+}
+
+// ---------------- allocation counting ----------------
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---------------- export ----------------
+// The exporters read other threads' blocks without synchronisation; call them when no simulation
+// is running.
+
+uint64_t metricCounterValue(MetricCounter counter) {
+    if (counter == MetricCounter::Allocations) return allocationCount.load();
+    if (counter == MetricCounter::AllocatedBytes) return allocatedBytes.load();
+    lock_guard<mutex> lock(registryMtx);
+    uint64_t total = 0;
+    for (const auto& m : registry) total += m->counters[static_cast<size_t>(counter)];
+    return total;
+}
+
+bool writeMetricsPrometheus(const string& path) {
+    ofstream out(path);
+    if (!out) {
+        cerr << "Cannot write " << path << "\n";
+        return false;
+    }
+    out.precision(9);
+    const double tps = ticksPerSecond();
+    uint64_t ticks[PHASES] = {}, calls[PHASES] = {}, stepSum[PHASES] = {};
+    uint64_t histogram[PHASES][HISTOGRAM_BUCKETS] = {};
+    {
+        lock_guard<mutex> lock(registryMtx);
+        for (const auto& m : registry) {
+            for (size_t p = 0; p < PHASES; ++p) {
+                ticks[p] += m->phaseTicks[p];
+                calls[p] += m->phaseCalls[p];
+                stepSum[p] += m->stepSum[p];
+                for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) histogram[p][b] += m->histogram[p][b];
+            }
+        }
+    }
+
+    out << "# HELP graph_phase_seconds_total Inclusive time spent in each phase.\n"
+        << "# TYPE graph_phase_seconds_total counter\n";
+    for (size_t p = 0; p < PHASES; ++p) {
+        out << "graph_phase_seconds_total{phase=\"" << PHASE_NAMES[p] << "\"} " << ticks[p] / tps << "\n";
+    }
+    out << "# HELP graph_phase_calls_total Timed scopes entered per phase.\n"
+        << "# TYPE graph_phase_calls_total counter\n";
+    for (size_t p = 0; p < PHASES; ++p) {
+        out << "graph_phase_calls_total{phase=\"" << PHASE_NAMES[p] << "\"} " << calls[p] << "\n";
+    }
+    for (size_t c = 0; c < COUNTERS; ++c) {
+        out << "# TYPE graph_" << COUNTER_NAMES[c] << "_total counter\n"
+            << "graph_" << COUNTER_NAMES[c] << "_total " << metricCounterValue(static_cast<MetricCounter>(c)) << "\n";
+    }
+    out << "# HELP graph_step_phase_seconds Time per simulateStep spent in each phase.\n"
+        << "# TYPE graph_step_phase_seconds histogram\n";
+    for (size_t p = 0; p < PHASES; ++p) {
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            if (histogram[p][b] == 0 && cumulative == 0) continue; // skip the empty low buckets
+            cumulative += histogram[p][b];
+            double upper = static_cast<double>(b < 64 ? (1ULL << b) : ~0ULL) / tps;
+            out << "graph_step_phase_seconds_bucket{phase=\"" << PHASE_NAMES[p] << "\",le=\"" << upper << "\"} "
+                << cumulative << "\n";
+        }
+        out << "graph_step_phase_seconds_bucket{phase=\"" << PHASE_NAMES[p] << "\",le=\"+Inf\"} " << cumulative << "\n"
+            << "graph_step_phase_seconds_sum{phase=\"" << PHASE_NAMES[p] << "\"} " << stepSum[p] / tps << "\n"
+            << "graph_step_phase_seconds_count{phase=\"" << PHASE_NAMES[p] << "\"} " << cumulative << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool writeMetricsTrace(const string& path) {
+    ofstream out(path);
+    if (!out) {
+        cerr << "Cannot write " << path << "\n";
+        return false;
+    }
+    out << fixed << setprecision(3);
+    const double usPerTick = 1e6 / ticksPerSecond();
+    lock_guard<mutex> lock(registryMtx);
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    uint64_t dropped = 0;
+    for (const auto& m : registry) {
+        dropped += m->droppedEvents;
+        for (const TraceEvent& e : m->trace) {
+            out << (first ? "" : ",\n") << "{\"name\": \"" << PHASE_NAMES[static_cast<size_t>(e.phase)]
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << m->tid
+                << ", \"ts\": " << static_cast<double>(e.begin - startTicks) * usPerTick
+                << ", \"dur\": " << static_cast<double>(e.end - e.begin) * usPerTick << "}";
+            first = false;
+        }
+    }
+    out << "\n], \"displayTimeUnit\": \"ns\", \"otherData\": {\"droppedEvents\": " << dropped << "}}\n";
+    return static_cast<bool>(out);
+}
+
+void resetMetrics() {
+    lock_guard<mutex> lock(registryMtx);
+    for (auto& m : registry) {
+        unsigned tid = m->tid;
+        m->trace.clear();
+        *m = ThreadMetrics();
+        m->tid = tid;
+    }
+    allocationCount = 0;
+    allocatedBytes = 0;
+}
+
+#else
+
+uint64_t metricCounterValue(MetricCounter) { return 0; }
+
+bool writeMetricsPrometheus(const string&) {
+    cerr << "Metrics are compiled out; rebuild with make METRICS=1\n";
+    return false;
+}
+
+bool writeMetricsTrace(const string&) {
+    cerr << "Metrics are compiled out; rebuild with make METRICS=1\n";
+    return false;
+}
+
+void resetMetrics() {}
+
+#endif // GRAPH_METRICS
@@ -0,0 +1,94 @@
+#ifndef GRAPH_METRICS_H
+#define GRAPH_METRICS_H
+
+#include <cstdint>
+#include <string>
+
+// Hot-path instrumentation, compiled in only with -DGRAPH_METRICS (`make METRICS=1`). Without it
+// METRIC_SCOPE and METRIC_ADD expand to nothing and the engine carries no cost.
+//
+// METRIC_SCOPE(Phase) times the enclosing block with the TSC (steady_clock off x86). Phase times
+// are inclusive: a Logging scope inside Supply counts toward both. Every thread keeps its own
+// totals, per-step histograms and trace buffer, so the pool and ensemble workers never contend;
+// the exporters merge them. Counters are plain per-thread sums.
+//
+// Per-step histograms hold wall time on the thread running the Step scope. Scopes on threads with
+// no open Step (pool workers extracting batched paths) count toward the totals only, so a caller
+// that hands a phase to the pool wraps the hand-off in METRIC_STEP_SCOPE, which feeds the step
+// figures alone. A scope nested in an open scope of the same phase adds nothing to the step
+// figures, so the caller's own share of the work is not counted twice.
+
+enum class MetricPhase : unsigned char {
+    Step,          // one simulateStep
+    Consumption,   // updateTankLevels
+    PriorityQueue, // selecting and queueing the tanks below the prescribed level
+    Routing,       // findPath, routeTree, widestTree, extractPath, zoned queries
+    Supply,        // supplyWaterAlongPath
+    MaxFlow,       // supplyWaterMaxFlow
+    BatchedRefill, // supplyWaterBatched
+    Observers,     // end-of-step observer callbacks (console snapshot printing)
+    Logging,       // logEvent / pushLog and the staged consumption records
+    Count
+};
+
+enum class MetricCounter : unsigned char {
+    Steps,
+    BfsNodesVisited,
+    PathsFound,
+    PathsFailed,
+    LeakAlerts,
+    Allocations,    // global operator new calls
+    AllocatedBytes,
+    Count
+};
+
+const char* metricPhaseName(MetricPhase phase);
+const char* metricCounterName(MetricCounter counter);
+
+#ifdef GRAPH_METRICS
+
+class MetricScope {
+public:
+    explicit MetricScope(MetricPhase phase, bool stepOnly = false);
+    ~MetricScope();
+    MetricScope(const MetricScope&) = delete;
+    MetricScope& operator=(const MetricScope&) = delete;
+
+private:
+    MetricPhase phase;
+    bool stepOnly; // no totals or trace event, see METRIC_STEP_SCOPE
+    uint64_t begin;
+};
+
+void metricAdd(MetricCounter counter, uint64_t n = 1);
+
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+#define METRIC_SCOPE(phase) MetricScope METRIC_CONCAT(metricScope, __LINE__)(MetricPhase::phase)
+#define METRIC_STEP_SCOPE(phase) MetricScope METRIC_CONCAT(metricScope, __LINE__)(MetricPhase::phase, true)
+#define METRIC_ADD(counter, n) metricAdd(MetricCounter::counter, (n))
+
+#else
+
+#define METRIC_SCOPE(phase) ((void)0)
+#define METRIC_STEP_SCOPE(phase) ((void)0)
+#define METRIC_ADD(counter, n) ((void)0)
+
+#endif // GRAPH_METRICS
+
+// Current merged value of a counter; 0 when metrics are compiled out.
+uint64_t metricCounterValue(MetricCounter counter);
+
+// Prometheus text exposition: per-phase seconds and call totals, counters, and per-step phase-time
+// histograms. Returns false (with a message on cerr) when the file cannot be written or metrics are
+// compiled out.
+bool writeMetricsPrometheus(const std::string& path);
+
+// Chrome trace-event JSON (load in chrome://tracing or Perfetto). Logging scopes are not traced,
+// and each thread keeps at most the first 1M events.
+bool writeMetricsTrace(const std::string& path);
+
+// Drops every total, histogram and trace event recorded so far.
+void resetMetrics();
+
+#endif // GRAPH_METRICS_H
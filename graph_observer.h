@@ -0,0 +1,52 @@
+#ifndef GRAPH_OBSERVER_H
+#define GRAPH_OBSERVER_H
+
+#include <cstddef>
+
+class Graph;
+struct EditBatch;
+
+// Receives progress notifications from Graph::simulateStep. Every callback defaults to a no-op,
+// so an observer only overrides what it needs. With no observers attached the engine is silent.
+class SimulationObserver {
+public:
+    virtual ~SimulationObserver() = default;
+
+    virtual void onStepBegin(const Graph& /*g*/) {}
+    virtual void onMaxFlowAllocation(const Graph& /*g*/, size_t /*tanks*/, double /*delivered*/) {}
+    // after the per-tank callbacks of a batched refill
+    virtual void onBatchedRefill(const Graph& /*g*/, size_t /*tanks*/, size_t /*batches*/, double /*delivered*/) {}
+    virtual void onTankProcessing(const Graph& /*g*/, int /*tankId*/, double /*priority*/,
+                                  double /*level*/, double /*capacity*/) {}
+    virtual void onNoPath(const Graph& /*g*/, int /*sourceId*/, int /*tankId*/) {}
+    virtual void onDelivery(const Graph& /*g*/, int /*tankId*/, double /*expected*/, double /*actual*/) {}
+    virtual void onLeakSuspected(const Graph& /*g*/, int /*tankId*/, double /*expected*/, double /*actual*/) {}
+    // found == false means no route avoiding the suspect pipes exists; expected/actual are then 0
+    virtual void onAlternateRoute(const Graph& /*g*/, int /*tankId*/, bool /*found*/,
+                                  double /*expected*/, double /*actual*/) {}
+    virtual void onQueueCarryOver(const Graph& /*g*/, int /*processed*/, size_t /*remaining*/) {}
+    // the leak detector has localised a leak to pipe from->to
+    virtual void onPipeFlagged(const Graph& /*g*/, int /*from*/, int /*to*/, double /*confidence*/) {}
+    virtual void onStepEnd(const Graph& /*g*/) {}
+    // after Graph::applyEdits has applied a batch (also between steps)
+    virtual void onEdits(const Graph& /*g*/, const EditBatch& /*batch*/) {}
+};
+
+// Prints the refill sequence and an end-of-step snapshot of every node and edge to cout;
+// this is what the interactive console attaches.
+class ConsoleObserver : public SimulationObserver {
+public:
+    void onStepBegin(const Graph& g) override;
+    void onMaxFlowAllocation(const Graph& g, size_t tanks, double delivered) override;
+    void onBatchedRefill(const Graph& g, size_t tanks, size_t batches, double delivered) override;
+    void onTankProcessing(const Graph& g, int tankId, double priority, double level, double capacity) override;
+    void onNoPath(const Graph& g, int sourceId, int tankId) override;
+    void onDelivery(const Graph& g, int tankId, double expected, double actual) override;
+    void onLeakSuspected(const Graph& g, int tankId, double expected, double actual) override;
+    void onAlternateRoute(const Graph& g, int tankId, bool found, double expected, double actual) override;
+    void onQueueCarryOver(const Graph& g, int processed, size_t remaining) override;
+    void onPipeFlagged(const Graph& g, int from, int to, double confidence) override;
+    void onStepEnd(const Graph& g) override;
+};
+
+#endif // GRAPH_OBSERVER_H
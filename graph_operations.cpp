@@ -1,208 +1,416 @@
-#include "graph.h"
-#include <iostream>
-// ---------------- node and edge operations ----------------
-void Graph::addNode(int id, const string& name, NodeType type, double capacity){
-    //adds a new node (tank or industry) to the graph if the id is unique.
-    for (const auto& n : nodes){
-        if (n.id == id){
-            cerr << "Node with ID " << id << " already exists.\n";
-            return;
-        }
-    }
-    nodes.emplace_back(id, type, name, capacity, 0.0, 0);
-}
-
-void Graph::addEdge(int from, int to, double capacity, double flowRate, bool active, int valveStatus){
-    //adds a pipe (edge) between two nodes if not already present.
-    for (const auto& e : edges){
-        if (e.from == from && e.to == to){
-            cerr << "Edge from " << from << " to " << to << " already exists.\n";
-            return;
-        }
-    }
-    edges.emplace_back(from, to, capacity, flowRate, active, valveStatus);
-    rebuildOutgoingEdges();
-}
-
-void Graph::rebuildOutgoingEdges(){
-    //rebuilds each node’s outgoing edge list after updates so valve selections always match current connections
-    for (auto& n : nodes) n.outgoingEdges.clear();
-    for (size_t i = 0; i < edges.size(); ++i){
-        const auto& e = edges[i];
-        if(!e.active) continue;
-        for (auto& n : nodes){
-            if (n.id == e.from){
-                n.outgoingEdges.push_back(static_cast<int>(i));
-                break;
-            }
-        }
-    }
-}
-
-void Graph::deactivateEdge(int from, int to){
-    //Deactivates(if pipe is damaged or not usable) the edge from one node to another, rebuilds adjacency, and logs the change.
-    for (auto& e : edges){
-        if (e.from == from && e.to == to){
-            e.active = false;
-            rebuildOutgoingEdges();
-            pushLog("Edge " + to_string(from) + "->" + to_string(to) + " deactivated by user.");
-            return;
-        }
-    }
-}
-
-void Graph::activateEdge(int from, int to){
-    //activates(if pipe is repaired) the edge from one node to another, rebuilds adjacency, and logs the change.
-    for (auto& e : edges) {
-        if (e.from == from && e.to == to){
-            e.active = true;
-            rebuildOutgoingEdges();
-            pushLog("Edge " + to_string(from) + "->" + to_string(to) + " activated by user.");
-            return;
-        }
-    }
-}
-
-void Graph::displayNode(int id) const{
-    // to print the present details of the node
-    for (const auto& n : nodes){
-        if (n.id == id){
-            cout << "Node ID: " << n.id << "\n"
-                 << "Name: " << n.name << "\n"
-                 << "Type: " << (n.type == NodeType::Tank ? "Tank" : "Industry") << "\n"
-                 << "Capacity: " << n.storageCapacity << "\n"
-                 << "Current Level: " << n.currentLevel << "\n"
-                 << "Valve Status: " << n.valveStatus << "\n"
-                 << "Outgoing edges count: " << n.outgoingEdges.size() << "\n";
-            return;
-        }
-    }
-    cout << "Node with ID " << id << " not found.\n";
-}
-
-void Graph::displayEdge(int from, int to) const{
-    for (const auto& e : edges){
-        if (e.from == from && e.to == to){
-            cout << "Edge from " << e.from << " to " << e.to << "\n"
-                 << "Capacity (units/sec): " << e.capacity << "\n"
-                 << "Flow Rate (units/sec): " << e.flowRate << "\n"
-                 << "Active: " << (e.active ? "Yes" : "No") << "\n"
-                 << "Valve Status: " << e.valveStatus << "\n";
-            return;
-        }
-    }
-    cout << "Edge from " << from << " to " << to << " not found.\n";
-}
-
-bool Graph::editNodeCapacity(int id, double newCapacity){
-    //to edit the capacity of the node
-    for (auto& n : nodes){
-        if (n.id == id) {
-            n.storageCapacity = newCapacity;
-            pushLog("Node " + to_string(id) + " capacity set to " + to_string(newCapacity));
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editNodeName(int id, const string& newName){
-    // to change name of the node
-    for (auto& n : nodes){
-        if (n.id == id){
-            n.name = newName;
-            pushLog("Node " + to_string(id) + " name changed to " + newName);
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editNodeType(int id, NodeType newType){
-    // to change the type of the node
-    for (auto& n : nodes){
-        if (n.id == id) {
-            n.type = newType;
-            pushLog("Node " + to_string(id) + " type changed.");
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editNodeValveStatus(int id, int newValveStatus){
-    // to edit the valve status whether to fill the tank or to pass on to others
-    for (auto& n : nodes){
-        if (n.id == id){
-            n.valveStatus = newValveStatus;
-            pushLog("Node " + to_string(id) + " valveStatus set to " + to_string(newValveStatus));
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editEdgeCapacity(int from, int to, double newCapacity) {
-    for (auto& e : edges) {
-        if (e.from == from && e.to == to) {
-            e.capacity = newCapacity;
-            pushLog("Edge " + to_string(from) + "->" + to_string(to) + " capacity set to " + to_string(newCapacity));
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editEdgeFlowRate(int from, int to, double newFlowRate) {
-    for (auto& e : edges) {
-        if (e.from == from && e.to == to) {
-            e.flowRate = newFlowRate;
-            pushLog("Edge " + to_string(from) + "->" + to_string(to) + " flowRate set to " + to_string(newFlowRate));
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editEdgeStatus(int from, int to, bool newStatus) {
-    for (auto& e : edges) {
-        if (e.from == from && e.to == to) {
-            e.active = newStatus;
-            rebuildOutgoingEdges();
-            pushLog("Edge " + to_string(from) + "->" + to_string(to) + " active set to " + (newStatus ? "true":"false"));
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Graph::editEdgeValve(int from, int to, int newValveStatus) {
-    for (auto& e : edges) {
-        if (e.from == from && e.to == to) {
-            e.valveStatus = newValveStatus;
-            pushLog("Edge " + to_string(from) + "->" + to_string(to) + " valve set to " + to_string(newValveStatus));
-            return true;
-        }
-    }
-    return false;
-}
-
-// ---------------- helpers ----------------
-Node* Graph::getNodeById(int id) {
-    for (auto& n : nodes) if (n.id == id) return &n;
-    return nullptr;
-}
-const Node* Graph::getNodeByIdConst(int id) const {
-    for (const auto& n : nodes) if (n.id == id) return &n;
-    return nullptr;
-}
-Edge* Graph::getEdgeByIndex(int idx) {
-    if (idx < 0 || idx >= static_cast<int>(edges.size())) return nullptr;
-    return &edges[idx];
-}
-int Graph::getEdgeIndex(int from, int to) const {
-    for (size_t i = 0; i < edges.size(); ++i) {
-        if (edges[i].from == from && edges[i].to == to) return static_cast<int>(i);
-    }
-    return -1;
+#include "graph.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+// ---------------- node and edge operations ----------------
+void Graph::addNode(int id, const string& name, NodeType type, double capacity){
+    //adds a new node (tank or industry) to the graph if the id is unique.
+    if (id < 0 || id > MAX_NODE_ID){
+        cerr << "Node ID " << id << " is invalid (ids must be between 0 and " << MAX_NODE_ID << ").\n";
+        return;
+    }
+    if (getNodeSlot(id) != -1){
+        cerr << "Node with ID " << id << " already exists.\n";
+        return;
+    }
+    if (id >= static_cast<int>(nodeSlotById.size())) nodeSlotById.resize(id + 1, -1);
+    nodeSlotById[id] = static_cast<int>(nodes.size());
+    nodes.emplace_back(id, type, name, 0);
+    state.push(capacity, type == NodeType::Tank);
+    invalidateTopology();
+}
+
+void Graph::addEdge(int from, int to, double capacity, double flowRate, bool active, int valveStatus){
+    //adds a pipe (edge) between two nodes if not already present. Both nodes must exist, so every
+    //pipe is on its source node's outgoing list from the start (removeNode drops its pipes likewise).
+    if (getNodeSlot(from) == -1 || getNodeSlot(to) == -1){
+        cerr << "Cannot add edge from " << from << " to " << to << ": unknown node.\n";
+        return;
+    }
+    if (edgeIndexByKey.count(edgeKey(from, to))){
+        cerr << "Edge from " << from << " to " << to << " already exists.\n";
+        return;
+    }
+    edgeIndexByKey[edgeKey(from, to)] = static_cast<int>(edges.size());
+    edges.emplace_back(from, to, capacity, flowRate, active, valveStatus);
+    invalidateTopology();
+    if (!bulkLoading) attachOutgoingEdge(static_cast<int>(edges.size()) - 1);
+}
+
+void Graph::clearNetwork(){
+    //drops every node and edge (levels and indexes included); history and sim time are kept
+    nodes.clear();
+    edges.clear();
+    state = NodeState();
+    nodeSlotById.clear();
+    edgeIndexByKey.clear();
+    leaks.reset();
+    invalidateTopology();
+}
+
+void Graph::beginBulkLoad(){
+    //while bulk loading, addEdge only records pipes; adjacency is built once in endBulkLoad
+    bulkLoading = true;
+}
+
+void Graph::endBulkLoad(){
+    bulkLoading = false;
+    rebuildOutgoingEdges();
+}
+
+bool Graph::removeEdge(int from, int to){
+    //removes a pipe by moving the last edge into its slot, so only the moved edge needs re-indexing
+    int idx = getEdgeIndex(from, to);
+    if (idx == -1) return false;
+    int last = static_cast<int>(edges.size()) - 1;
+    edgeIndexByKey.erase(edgeKey(from, to));
+    detachOutgoingEdge(idx);
+    leaks.clearPipe(idx);
+    if (idx != last){
+        detachOutgoingEdge(last);
+        edges[idx] = edges[last];
+        edgeIndexByKey[edgeKey(edges[idx].from, edges[idx].to)] = idx;
+        attachOutgoingEdge(idx);
+        leaks.movePipe(last, idx);
+    }
+    edges.pop_back();
+    leaks.truncate(edges.size());
+    invalidateTopology();
+    logEvent(LogKind::EdgeRemoved, from, to);
+    return true;
+}
+
+bool Graph::removeNode(int id){
+    //removes a node together with every pipe touching it
+    int slot = getNodeSlot(id);
+    if (slot == -1) return false;
+    vector<pair<int,int>> incident;
+    for (const auto& e : edges){
+        if (e.from == id || e.to == id) incident.emplace_back(e.from, e.to);
+    }
+    for (const auto& fe : incident) removeEdge(fe.first, fe.second);
+
+    int last = static_cast<int>(nodes.size()) - 1;
+    nodeSlotById[id] = -1;
+    if (slot != last){
+        nodes[slot] = std::move(nodes[last]);
+        state.moveSlot(last, slot);
+        nodeSlotById[nodes[slot].id] = slot;
+    }
+    nodes.pop_back();
+    state.pop();
+    invalidateTopology();
+    logEvent(LogKind::NodeRemoved, id);
+    return true;
+}
+
+void Graph::rebuildOutgoingEdges(){
+    //rebuilds each node’s outgoing edge list after updates so valve selections always match current connections
+    for (auto& n : nodes) n.outgoingEdges.clear();
+    for (size_t i = 0; i < edges.size(); ++i){
+        const auto& e = edges[i];
+        if(!e.active) continue;
+        Node* n = getNodeById(e.from);
+        if (n) n->outgoingEdges.push_back(static_cast<int>(i));
+    }
+    invalidateTopology();
+}
+
+void Graph::attachOutgoingEdge(int idx){
+    //adds an active edge to its source node's list, keeping the list sorted by edge index
+    //so the order matches what rebuildOutgoingEdges would produce
+    const Edge& e = edges[idx];
+    if (!e.active) return;
+    Node* n = getNodeById(e.from);
+    if (!n) return;
+    auto& out = n->outgoingEdges;
+    auto it = lower_bound(out.begin(), out.end(), idx);
+    if (it == out.end() || *it != idx) out.insert(it, idx);
+}
+
+void Graph::detachOutgoingEdge(int idx){
+    //removes an edge from its source node's list, O(degree)
+    Node* n = getNodeById(edges[idx].from);
+    if (!n) return;
+    auto& out = n->outgoingEdges;
+    auto it = lower_bound(out.begin(), out.end(), idx);
+    if (it != out.end() && *it == idx) out.erase(it);
+}
+
+void Graph::setEdgeActive(int idx, bool active){
+    //updates the active flag and patches only the affected adjacency list
+    if (edges[idx].active == active) return;
+    if (!active) detachOutgoingEdge(idx);
+    edges[idx].active = active;
+    invalidateEdge(idx);
+    if (active) attachOutgoingEdge(idx);
+}
+
+void Graph::deactivateEdge(int from, int to){
+    //Deactivates(if pipe is damaged or not usable) the edge from one node to another, rebuilds adjacency, and logs the change.
+    int idx = getEdgeIndex(from, to);
+    if (idx == -1) return;
+    setEdgeActive(idx, false);
+    logEvent(LogKind::EdgeDeactivated, from, to);
+}
+
+void Graph::activateEdge(int from, int to){
+    //activates(if pipe is repaired) the edge from one node to another, rebuilds adjacency, and logs the change.
+    int idx = getEdgeIndex(from, to);
+    if (idx == -1) return;
+    setEdgeActive(idx, true);
+    logEvent(LogKind::EdgeActivated, from, to);
+}
+
+void Graph::displayNode(int id) const{
+    // to print the present details of the node
+    const Node* n = getNodeByIdConst(id);
+    if (n){
+        cout << "Node ID: " << n->id << "\n"
+             << "Name: " << n->name << "\n"
+             << "Type: " << (n->type == NodeType::Tank ? "Tank" : "Industry") << "\n"
+             << "Capacity: " << state.capacity[getNodeSlot(id)] << "\n"
+             << "Current Level: " << state.level[getNodeSlot(id)] << "\n"
+             << "Valve Status: " << n->valveStatus << "\n"
+             << "Outgoing edges count: " << n->outgoingEdges.size() << "\n";
+        return;
+    }
+    cout << "Node with ID " << id << " not found.\n";
+}
+
+void Graph::displayEdge(int from, int to) const{
+    int idx = getEdgeIndex(from, to);
+    if (idx != -1){
+        const Edge& e = edges[idx];
+        cout << "Edge from " << e.from << " to " << e.to << "\n"
+             << "Capacity (units/sec): " << e.capacity << "\n"
+             << "Flow Rate (units/sec): " << e.flowRate << "\n"
+             << "Active: " << (e.active ? "Yes" : "No") << "\n"
+             << "Valve Status: " << e.valveStatus << "\n";
+        return;
+    }
+    cout << "Edge from " << from << " to " << to << " not found.\n";
+}
+
+bool Graph::editNodeCapacity(int id, double newCapacity){
+    //to edit the capacity of the node
+    int slot = getNodeSlot(id);
+    if (slot != -1){
+        state.capacity[slot] = newCapacity;
+        logEvent(LogKind::NodeCapacitySet, id, 0, 0, newCapacity);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editNodeName(int id, const string& newName){
+    // to change name of the node
+    Node* n = getNodeById(id);
+    if (n){
+        n->name = newName;
+        pushLog("Node " + to_string(id) + " name changed to " + newName);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editNodeType(int id, NodeType newType){
+    // to change the type of the node
+    Node* n = getNodeById(id);
+    if (n){
+        n->type = newType;
+        state.isTank[getNodeSlot(id)] = newType == NodeType::Tank ? 1 : 0;
+        logEvent(LogKind::NodeTypeChanged, id);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editNodeValveStatus(int id, int newValveStatus){
+    // to edit the valve status whether to fill the tank or to pass on to others
+    Node* n = getNodeById(id);
+    if (n){
+        n->valveStatus = newValveStatus;
+        logEvent(LogKind::NodeValveSet, id, newValveStatus);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editEdgeCapacity(int from, int to, double newCapacity) {
+    int idx = getEdgeIndex(from, to);
+    if (idx != -1){
+        Edge& e = edges[idx];
+        e.capacity = newCapacity;
+        invalidateEdge(idx);
+        logEvent(LogKind::EdgeCapacitySet, from, to, 0, newCapacity);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editEdgeFlowRate(int from, int to, double newFlowRate) {
+    int idx = getEdgeIndex(from, to);
+    if (idx != -1){
+        Edge& e = edges[idx];
+        e.flowRate = newFlowRate;
+        invalidateEdge(idx);
+        logEvent(LogKind::EdgeFlowRateSet, from, to, 0, newFlowRate);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editEdgeStatus(int from, int to, bool newStatus) {
+    int idx = getEdgeIndex(from, to);
+    if (idx != -1){
+        setEdgeActive(idx, newStatus);
+        logEvent(LogKind::EdgeActiveSet, from, to, newStatus ? 1 : 0);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::editEdgeValve(int from, int to, int newValveStatus) {
+    int idx = getEdgeIndex(from, to);
+    if (idx != -1){
+        Edge& e = edges[idx];
+        e.valveStatus = newValveStatus;
+        invalidateEdge(idx);
+        logEvent(LogKind::EdgeValveSet, from, to, newValveStatus);
+        return true;
+    }
+    return false;
+}
+
+bool Graph::setEdgeLoss(int from, int to, double lossFraction) {
+    //simulated leak on a pipe; routing is unaffected, deliveries through it arrive short
+    int idx = getEdgeIndex(from, to);
+    if (idx == -1 || lossFraction < 0.0 || lossFraction > 1.0) return false;
+    edges[idx].lossFraction = lossFraction;
+    return true;
+}
+
+bool Graph::applyEdits(const EditBatch& batch){
+    //applies a batch of edits all-or-nothing: every target is resolved and checked first, then the
+    //changes are written in one pass, adjacency and routing caches are refreshed once, and a single
+    //EditBatch record is logged instead of one record per edit
+    const vector<GraphEdit>& edits = batch.edits;
+    vector<int> target(edits.size());
+    for (size_t i = 0; i < edits.size(); ++i){
+        const GraphEdit& ed = edits[i];
+        bool nodeEdit = ed.kind == EditKind::NodeCapacity || ed.kind == EditKind::NodeValve;
+        target[i] = nodeEdit ? getNodeSlot(ed.a) : getEdgeIndex(ed.a, ed.b);
+        if (target[i] == -1){
+            cerr << "applyEdits: edit " << i << " refers to missing "
+                 << (nodeEdit ? "node " + to_string(ed.a) : "pipe " + to_string(ed.a) + "->" + to_string(ed.b)) << "\n";
+            return false;
+        }
+        bool amount = ed.kind == EditKind::NodeCapacity || ed.kind == EditKind::EdgeCapacity || ed.kind == EditKind::EdgeFlowRate;
+        bool fraction = ed.kind == EditKind::EdgeLoss;
+        if (!isfinite(ed.value) || (amount && ed.value < 0) || (fraction && (ed.value < 0 || ed.value > 1))){
+            cerr << "applyEdits: edit " << i << " has invalid value " << ed.value << "\n";
+            return false;
+        }
+    }
+
+    //flip active flags first and decide how to refresh adjacency: patching each touched list costs
+    //O(degree) per change, a full rebuild O(N+E), so large batches take the rebuild
+    vector<int> flipped;
+    for (size_t i = 0; i < edits.size(); ++i){
+        if (edits[i].kind != EditKind::EdgeActive) continue;
+        Edge& e = edges[target[i]];
+        bool active = edits[i].value != 0;
+        if (e.active == active) continue;
+        if (!active) detachOutgoingEdge(target[i]);
+        e.active = active;
+        flipped.push_back(target[i]);
+    }
+    bool rebuild = flipped.size() * 8 > edges.size();
+    if (!rebuild){
+        for (int idx : flipped) attachOutgoingEdge(idx); //no-op for edges that ended up inactive
+    }
+
+    int nodeEdits = 0, routingEdits = static_cast<int>(flipped.size());
+    vector<int>& routed = flipped; //every pipe whose routing fields changed
+    for (size_t i = 0; i < edits.size(); ++i){
+        const GraphEdit& ed = edits[i];
+        switch (ed.kind){
+            case EditKind::NodeCapacity:
+                state.capacity[target[i]] = ed.value;
+                ++nodeEdits;
+                break;
+            case EditKind::NodeValve:
+                nodes[target[i]].valveStatus = static_cast<int>(ed.value);
+                ++nodeEdits;
+                break;
+            case EditKind::EdgeActive:
+                break;
+            case EditKind::EdgeValve:
+                if (edges[target[i]].valveStatus != static_cast<int>(ed.value)){
+                    ++routingEdits;
+                    routed.push_back(target[i]);
+                }
+                edges[target[i]].valveStatus = static_cast<int>(ed.value);
+                break;
+            case EditKind::EdgeCapacity:
+                edges[target[i]].capacity = ed.value;
+                ++routingEdits;
+                routed.push_back(target[i]);
+                break;
+            case EditKind::EdgeFlowRate:
+                edges[target[i]].flowRate = ed.value;
+                ++routingEdits;
+                routed.push_back(target[i]);
+                break;
+            case EditKind::EdgeLoss:
+                edges[target[i]].lossFraction = ed.value;
+                if (ed.value == 0.0) leaks.clearPipe(target[i]);
+                break;
+        }
+    }
+
+    if (rebuild) rebuildOutgoingEdges();
+    else for (int idx : routed) invalidateEdge(idx);
+    logEvent(LogKind::EditBatch, -1, static_cast<int>(edits.size()), routingEdits,
+             nodeEdits, static_cast<double>(edits.size()) - nodeEdits);
+    for (auto* o : observers) o->onEdits(*this, batch);
+    return true;
+}
+
+// ---------------- helpers ----------------
+// Lookups go through nodeSlotById (dense, indexed by node id) and edgeIndexByKey ((from,to) -> edge index),
+// both kept in sync by addNode/addEdge/removeNode/removeEdge, so every accessor is O(1).
+long long Graph::edgeKey(int from, int to) {
+    return (static_cast<long long>(static_cast<uint32_t>(from)) << 32) | static_cast<uint32_t>(to);
+}
+int Graph::getNodeSlot(int id) const {
+    if (id < 0 || id >= static_cast<int>(nodeSlotById.size())) return -1;
+    return nodeSlotById[id];
+}
+double Graph::getNodeLevel(int id) const {
+    int slot = getNodeSlot(id);
+    return slot == -1 ? 0.0 : state.level[slot];
+}
+bool Graph::setNodeLevel(int id, double level) {
+    int slot = getNodeSlot(id);
+    if (slot == -1) return false;
+    state.level[slot] = level;
+    return true;
+}
+Node* Graph::getNodeById(int id) {
+    int slot = getNodeSlot(id);
+    return slot == -1 ? nullptr : &nodes[slot];
+}
+const Node* Graph::getNodeByIdConst(int id) const {
+    int slot = getNodeSlot(id);
+    return slot == -1 ? nullptr : &nodes[slot];
+}
+Edge* Graph::getEdgeByIndex(int idx) {
+    if (idx < 0 || idx >= static_cast<int>(edges.size())) return nullptr;
+    return &edges[idx];
+}
+int Graph::getEdgeIndex(int from, int to) const {
+    auto it = edgeIndexByKey.find(edgeKey(from, to));
+    return it == edgeIndexByKey.end() ? -1 : it->second;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef GRAPH_RANDOM_H
+#define GRAPH_RANDOM_H
+
+#include <cstdint>
+
+// SplitMix64: small, fast generator. mix() is its finaliser and is also used on its own to
+// derive statistically independent stream seeds from (key, index) pairs.
+struct SplitMix64 {
+    uint64_t state;
+
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    uint64_t next() { return mix(state += 0x9E3779B97F4A7C15ULL); }
+    double nextUnit() { return static_cast<double>(next() >> 11) * 0x1.0p-53; } // [0,1)
+};
+
+// Counter-based generator in the style of Philox: every value is a pure function of
+// (seed, stream, counter), a keyed SplitMix64 finaliser applied to the counter. Draws can be made in
+// any order and on any thread, so a node's stream (keyed by its id) does not depend on how the
+// nodes are visited or chunked. operator() walks a sequential stream of its own; reserve() hands
+// out counter values for keyed batches such as one consumption step.
+struct CounterRng {
+    static const uint64_t SEQUENTIAL_STREAM = ~0ULL;
+
+    uint64_t key = 0;     // the seed
+    uint64_t counter = 0; // counter values used so far
+
+    CounterRng() = default;
+    explicit CounterRng(uint64_t seed) : key(seed) {}
+
+    void seed(uint64_t s) {
+        key = s;
+        counter = 0;
+    }
+    uint64_t operator()() { return at(key, SEQUENTIAL_STREAM, counter++); }
+    uint64_t reserve() { return counter++; }
+
+    static uint64_t at(uint64_t seed, uint64_t stream, uint64_t counter) {
+        uint64_t streamKey = SplitMix64::mix(seed ^ (stream * 0x9E3779B97F4A7C15ULL));
+        return SplitMix64::mix(streamKey + (counter + 1) * 0xD1B54A32D192ED03ULL);
+    }
+    static double unitAt(uint64_t seed, uint64_t stream, uint64_t counter) {
+        return static_cast<double>(at(seed, stream, counter) >> 11) * 0x1.0p-53; // [0,1)
+    }
+};
+
+#endif // GRAPH_RANDOM_H
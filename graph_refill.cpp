@@ -0,0 +1,231 @@
+#include <algorithm>
+#include "graph.h"
+#include "graph_metrics.h"
+#include "thread_pool.h"
+
+// ---------------- batched parallel refills ----------------
+
+// Requests are handed to the pool in chunks; below PARALLEL_MIN_REQUESTS a phase runs serially.
+static const size_t REFILL_CHUNK = 256;
+static const size_t PARALLEL_MIN_REQUESTS = 4 * REFILL_CHUNK;
+
+// Rate a single pipe can carry; the same supply factor as pathSupplyRate.
+static double pipeRate(const CsrTopology& t, int eidx) {
+    return 0.8 * min(t.edgeCapacity[eidx], t.edgeFlowRate[eidx]);
+}
+
+// Refills every requested tank along its own path in one step. Paths come from the routing mode's
+// tree (or the zone router) and are extracted concurrently. A pipe is capacity-constrained when the
+// paths crossing it ask for more than it carries; only those pipes are shared state. Each request is
+// placed in the batch after the last one that crossed any of its constrained pipes, so within a
+// batch no two requests share one, and requests earlier in priority order always draw first.
+// Batches are applied one after another, each spread over the thread pool. A request gets its path
+// rate capped by what is left on its constrained pipes; when nothing is left it is deferred to the
+// next step. Logs, observer callbacks, source draw-down and the leak check run afterwards in
+// priority order, so the outcome does not depend on the thread count. A retry around flagged pipes
+// draws only on the rate its pipes have left after the batches and the earlier retries.
+RefillStats Graph::supplyWaterBatched(int sourceId, const vector<RefillRequest>& requests, int intervalSec) {
+    METRIC_SCOPE(BatchedRefill);
+    RefillStats stats;
+    stats.tanks = requests.size();
+    int sourceSlot = getNodeSlot(sourceId);
+    if (sourceSlot == -1 || intervalSec <= 0 || requests.empty()) return stats;
+
+    const CsrTopology& t = topology();
+    const RouteTree* routes = routingMode == RoutingMode::Tree   ? &routeTree(sourceId)
+                            : routingMode == RoutingMode::Widest ? &widestTree(sourceId)
+                                                                 : nullptr;
+    RefillScratch& rs = refillScratch;
+    const size_t count = requests.size();
+    if (rs.paths.size() < count) rs.paths.resize(count);
+    rs.pathRate.assign(count, 0.0);
+    rs.batchOf.assign(count, -1);
+    rs.outcome.assign(count, RefillScratch::Outcome{0.0, 0.0, 0.0, 0.0, false, false});
+    if (rs.edgeDemand.size() != edges.size()) {
+        rs.edgeDemand.assign(edges.size(), 0.0);
+        rs.edgeResidual.assign(edges.size(), -1.0);
+        rs.edgeBatch.assign(edges.size(), -1);
+    }
+
+    ThreadPool& pool = workerPool ? *workerPool : ThreadPool::shared();
+    auto forEachChunk = [&](size_t begin, size_t end, const function<void(size_t)>& fn) {
+        size_t len = end - begin;
+        if (len < PARALLEL_MIN_REQUESTS) {
+            for (size_t i = begin; i < end; ++i) fn(i);
+            return;
+        }
+        pool.parallelFor((len + REFILL_CHUNK - 1) / REFILL_CHUNK, [&](size_t c) {
+            size_t from = begin + c * REFILL_CHUNK;
+            size_t to = min(end, from + REFILL_CHUNK);
+            for (size_t i = from; i < to; ++i) fn(i);
+        });
+    };
+
+    // 1) Paths; the trees are read-only here, the zone router keeps caches and runs serially
+    auto extract = [&](size_t k) {
+        vector<int>& path = rs.paths[k];
+        bool routed = routes ? extractPath(*routes, requests[k].nodeId, path)
+                             : findZonedPath(sourceId, requests[k].nodeId, path);
+        if (!routed) {
+            path.clear();
+            rs.pathRate[k] = -1.0;
+            return;
+        }
+        rs.pathRate[k] = pathSupplyRate(path);
+    };
+    if (routes) {
+        METRIC_STEP_SCOPE(Routing); // pool workers' routing is invisible to the step histograms
+        forEachChunk(0, count, extract);
+    } else {
+        for (size_t k = 0; k < count; ++k) extract(k);
+    }
+    if (leaks.flaggedCount() > 0) { // detours around flagged pipes, serially through pathScratch
+        for (size_t k = 0; k < count; ++k) {
+            if (rs.pathRate[k] < 0.0) continue;
+            steerAroundLeaks(sourceId, requests[k].nodeId, rs.paths[k]);
+            rs.pathRate[k] = pathSupplyRate(rs.paths[k]);
+        }
+    }
+
+    // 2) Demand per pipe, then batches: a request goes after the last batch on its constrained pipes
+    for (size_t k = 0; k < count; ++k) {
+        if (rs.pathRate[k] <= 0.0) continue;
+        for (int eidx : rs.paths[k]) {
+            if (rs.edgeDemand[eidx] == 0.0) rs.touchedEdges.push_back(eidx);
+            rs.edgeDemand[eidx] += rs.pathRate[k];
+        }
+    }
+    for (int eidx : rs.touchedEdges) {
+        if (rs.edgeDemand[eidx] > pipeRate(t, eidx)) rs.edgeResidual[eidx] = pipeRate(t, eidx);
+    }
+    int batchCount = 0;
+    for (size_t k = 0; k < count; ++k) {
+        if (rs.pathRate[k] < 0.0) continue;
+        ++stats.routed;
+        int batch = 0;
+        for (int eidx : rs.paths[k]) {
+            if (rs.edgeResidual[eidx] >= 0.0) batch = max(batch, rs.edgeBatch[eidx] + 1);
+        }
+        for (int eidx : rs.paths[k]) {
+            if (rs.edgeResidual[eidx] >= 0.0) rs.edgeBatch[eidx] = batch;
+        }
+        rs.batchOf[k] = batch;
+        batchCount = max(batchCount, batch + 1);
+    }
+    // counting sort by batch keeps priority order inside each batch
+    rs.batchStart.assign(batchCount + 1, 0);
+    for (size_t k = 0; k < count; ++k) {
+        if (rs.batchOf[k] >= 0) ++rs.batchStart[rs.batchOf[k] + 1];
+    }
+    for (int b = 0; b < batchCount; ++b) rs.batchStart[b + 1] += rs.batchStart[b];
+    rs.order.resize(rs.batchStart[batchCount]);
+    {
+        vector<int> cursor(rs.batchStart.begin(), rs.batchStart.end() - 1);
+        for (size_t k = 0; k < count; ++k) {
+            if (rs.batchOf[k] >= 0) rs.order[cursor[rs.batchOf[k]]++] = static_cast<int>(k);
+        }
+    }
+
+    // 3) Apply the batches. Within one batch the targets and the constrained pipes are all distinct,
+    // so every request writes only its own tank level and its own residuals.
+    auto apply = [&](size_t i) {
+        int k = rs.order[i];
+        const vector<int>& path = rs.paths[k];
+        double rate = rs.pathRate[k];
+        for (int eidx : path) {
+            if (rs.edgeResidual[eidx] >= 0.0) rate = min(rate, rs.edgeResidual[eidx]);
+        }
+        int targetSlot = getNodeSlot(requests[k].nodeId);
+        double& level = state.level[targetSlot];
+        const double capacity = state.capacity[targetSlot];
+        RefillScratch::Outcome& out = rs.outcome[k];
+        out.before = out.after = level;
+        double remaining = max(0.0, capacity - level);
+        if (path.empty() || remaining <= FULL_TOLERANCE * capacity) return; // nothing to route, or already full
+        if (rs.pathRate[k] > 0.0 && rate <= FULL_TOLERANCE * rs.pathRate[k]) { // only rounding residue left
+            out.deferred = true;
+            return;
+        }
+
+        out.supplied = true;
+        out.expected = min(rate * static_cast<double>(intervalSec), remaining);
+        level = min(level + out.expected * pathRetention(path), capacity);
+        out.after = level;
+        out.actual = out.after - out.before;
+        double used = out.expected / static_cast<double>(intervalSec);
+        for (int eidx : path) {
+            if (rs.edgeResidual[eidx] >= 0.0) rs.edgeResidual[eidx] = max(0.0, rs.edgeResidual[eidx] - used);
+        }
+    };
+    for (int b = 0; b < batchCount; ++b) forEachChunk(rs.batchStart[b], rs.batchStart[b + 1], apply);
+    stats.batches = static_cast<size_t>(batchCount);
+
+    // A retry's detour may cross any pipe: an unconstrained one has its rate less the demand on it
+    // left, and becomes constrained once a retry draws on it.
+    auto claimRate = [&](const vector<int>& path) {
+        int targetSlot = getNodeSlot(edges[path.back()].to);
+        double rate = min(pathSupplyRate(path),
+                          (state.capacity[targetSlot] - state.level[targetSlot]) / static_cast<double>(intervalSec));
+        for (int eidx : path) {
+            if (rs.edgeResidual[eidx] < 0.0) {
+                if (rs.edgeDemand[eidx] == 0.0) rs.touchedEdges.push_back(eidx);
+                rs.edgeResidual[eidx] = max(0.0, pipeRate(t, eidx) - rs.edgeDemand[eidx]);
+            }
+            rate = min(rate, rs.edgeResidual[eidx]);
+        }
+        rate = max(0.0, rate);
+        for (int eidx : path) rs.edgeResidual[eidx] -= rate;
+        return rate;
+    };
+
+    // 4) Records, observers and the leak check, in priority order as the serial loop does them
+    for (size_t k = 0; k < count; ++k) {
+        const RefillRequest& req = requests[k];
+        for (auto* o : observers) o->onTankProcessing(*this, req.nodeId, req.priority, req.level, req.capacity);
+        if (rs.batchOf[k] < 0) {
+            METRIC_ADD(PathsFailed, 1);
+            logEvent(LogKind::NoPath, req.nodeId, sourceId);
+            for (auto* o : observers) o->onNoPath(*this, sourceId, req.nodeId);
+            continue;
+        }
+        METRIC_ADD(PathsFound, 1);
+        const RefillScratch::Outcome& out = rs.outcome[k];
+        if (out.deferred) {
+            ++stats.deferred;
+            continue;
+        }
+        if (!out.supplied) {
+            for (auto* o : observers) o->onDelivery(*this, req.nodeId, 0.0, 0.0);
+            continue;
+        }
+        if (sourceId != 0) state.level[sourceSlot] = max(0.0, state.level[sourceSlot] - out.expected);
+        stats.delivered += out.actual;
+        addPathFlow(rs.paths[k], out.expected);
+        logEvent(LogKind::Supply, req.nodeId, sourceId, static_cast<int>(rs.paths[k].size()),
+                 out.expected, out.actual, out.before, out.after);
+        for (auto* o : observers) o->onDelivery(*this, req.nodeId, out.expected, out.actual);
+        recordDelivery(rs.paths[k], out.expected, out.actual);
+
+        if (out.expected > 0 && out.actual < leakThreshold * out.expected) {
+            METRIC_ADD(LeakAlerts, 1);
+            logEvent(LogKind::LeakSuspected, req.nodeId, 0, 0, out.expected, out.actual);
+            for (auto* o : observers) o->onLeakSuspected(*this, req.nodeId, out.expected, out.actual);
+
+            stats.delivered += retryAroundLeaks(sourceId, req.nodeId, rs.paths[k], intervalSec, claimRate);
+        }
+    }
+
+    for (int eidx : rs.touchedEdges) {
+        rs.edgeDemand[eidx] = 0.0;
+        rs.edgeResidual[eidx] = -1.0;
+        rs.edgeBatch[eidx] = -1;
+    }
+    rs.touchedEdges.clear();
+
+    if (stats.deferred > 0) {
+        int processed = static_cast<int>(count - stats.deferred);
+        logEvent(LogKind::QueueCarryOver, -1, processed, static_cast<int>(stats.deferred));
+        for (auto* o : observers) o->onQueueCarryOver(*this, processed, stats.deferred);
+    }
+    return stats;
+}
@@ -0,0 +1,220 @@
+#include "graph_replay.h"
+#include "graph.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// ---------------- run script ----------------
+
+namespace {
+
+const char RUN_MAGIC[8] = {'W', 'N', 'E', 'T', 'R', 'U', 'N', '1'};
+const uint32_t RUN_VERSION = 1;
+
+template <typename T>
+void put(ofstream& out, T value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+template <typename T>
+bool get(ifstream& in, T& value) { return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T))); }
+
+string networkPath(const string& path) { return path + ".net"; }
+
+} // namespace
+
+uint64_t levelDigest(const Graph& g) {
+    uint64_t h = 1469598103934665603ULL;
+    for (double level : g.state.level) {
+        uint64_t bits;
+        memcpy(&bits, &level, sizeof bits);
+        for (int b = 0; b < 64; b += 8) {
+            h ^= (bits >> b) & 0xFF;
+            h *= 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+bool RunRecorder::begin(const Graph& g, const RunParams& runParams, const string& scriptPath) {
+    if (!g.leaks.empty()) {
+        // a replay starts with an empty detector and would steer differently
+        cerr << "Cannot record a run whose leak detector has already observed deliveries\n";
+        return false;
+    }
+    if (!g.saveBinary(networkPath(scriptPath))) return false;
+    path = scriptPath;
+    params = runParams;
+    seed = g.rng.key;
+    counter = g.rng.counter;
+    startTimeSec = g.simTimeSec;
+    allocationMode = g.allocationMode;
+    routingMode = g.routingMode;
+    leakThreshold = g.leakThreshold;
+    losses.clear();
+    for (size_t i = 0; i < g.edges.size(); ++i) {
+        if (g.edges[i].lossFraction != 0.0) losses.emplace_back(static_cast<int>(i), g.edges[i].lossFraction);
+    }
+    edits.clear();
+    batches = 0;
+    digests.clear();
+    return true;
+}
+
+void RunRecorder::onStepEnd(const Graph& g) {
+    if (!path.empty()) digests.push_back(levelDigest(g));
+}
+
+void RunRecorder::onEdits(const Graph&, const EditBatch& batch) {
+    if (path.empty()) return;
+    for (const GraphEdit& ed : batch.edits) edits.push_back(TimedEdit{steps(), batches, ed});
+    ++batches;
+}
+
+bool RunRecorder::finish() const {
+    if (path.empty()) return false;
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Cannot write " << path << "\n";
+        return false;
+    }
+    out.write(RUN_MAGIC, 8);
+    put<uint32_t>(out, RUN_VERSION);
+    put<uint32_t>(out, 0);
+    put<uint64_t>(out, seed);
+    put<uint64_t>(out, counter);
+    put<int32_t>(out, startTimeSec);
+    put<int32_t>(out, params.intervalSec);
+    put<int32_t>(out, params.sourceId);
+    put<uint8_t>(out, static_cast<uint8_t>(allocationMode));
+    put<uint8_t>(out, static_cast<uint8_t>(routingMode));
+    put<uint16_t>(out, 0);
+    put<double>(out, params.maxReductionPerHour);
+    put<double>(out, params.prescribedLevel);
+    put<double>(out, leakThreshold);
+    put<uint64_t>(out, losses.size());
+    for (const auto& [edge, fraction] : losses) {
+        put<uint32_t>(out, static_cast<uint32_t>(edge));
+        put<uint32_t>(out, 0);
+        put<double>(out, fraction);
+    }
+    put<uint64_t>(out, edits.size());
+    for (const TimedEdit& t : edits) {
+        put<uint64_t>(out, static_cast<uint64_t>(t.step));
+        put<uint32_t>(out, static_cast<uint32_t>(t.edit.kind));
+        put<int32_t>(out, t.edit.a);
+        put<int32_t>(out, t.edit.b);
+        put<uint32_t>(out, t.batch);
+        put<double>(out, t.edit.value);
+    }
+    put<uint64_t>(out, digests.size());
+    out.write(reinterpret_cast<const char*>(digests.data()), static_cast<streamsize>(digests.size() * sizeof(uint64_t)));
+    out.flush();
+    if (!out) {
+        cerr << "Error writing " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// ---------------- replay ----------------
+
+bool replayRun(const string& path, ReplayReport& report) {
+    report = ReplayReport();
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) {
+        cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    const uint64_t fileBytes = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+
+    char magic[8];
+    uint32_t version = 0, pad32 = 0;
+    uint64_t seed = 0, counter = 0, lossCount = 0, editCount = 0, stepCount = 0;
+    int32_t startTimeSec = 0;
+    uint8_t allocationMode = 0, routingMode = 0;
+    uint16_t pad16 = 0;
+    RunParams params;
+    double leakThreshold = 0.0;
+    bool ok = in.read(magic, 8) && memcmp(magic, RUN_MAGIC, 8) == 0 && get(in, version) && version == RUN_VERSION &&
+              get(in, pad32) && get(in, seed) && get(in, counter) && get(in, startTimeSec) &&
+              get(in, params.intervalSec) && get(in, params.sourceId) && get(in, allocationMode) &&
+              get(in, routingMode) && get(in, pad16) && get(in, params.maxReductionPerHour) &&
+              get(in, params.prescribedLevel) && get(in, leakThreshold) && get(in, lossCount) &&
+              lossCount <= fileBytes / 16;
+    if (!ok) {
+        cerr << path << ": not a run script\n";
+        return false;
+    }
+
+    Graph g;
+    if (!g.loadBinary(networkPath(path))) return false;
+    for (uint64_t i = 0; ok && i < lossCount; ++i) {
+        uint32_t edge = 0;
+        double fraction = 0.0;
+        ok = get(in, edge) && get(in, pad32) && get(in, fraction) && edge < g.edges.size();
+        if (ok) g.edges[edge].lossFraction = fraction;
+    }
+    struct ScriptEdit {
+        long long step;
+        uint32_t batch;
+        GraphEdit edit;
+    };
+    vector<ScriptEdit> edits;
+    ok = ok && get(in, editCount) && editCount <= fileBytes / 32;
+    for (uint64_t i = 0; ok && i < editCount; ++i) {
+        uint64_t step = 0;
+        uint32_t kind = 0, batchNo = 0;
+        GraphEdit ed{};
+        ok = get(in, step) && get(in, kind) && get(in, ed.a) && get(in, ed.b) && get(in, batchNo) && get(in, ed.value) &&
+             kind <= static_cast<uint32_t>(EditKind::EdgeLoss);
+        ed.kind = static_cast<EditKind>(kind);
+        edits.push_back(ScriptEdit{static_cast<long long>(step), batchNo, ed});
+    }
+    vector<uint64_t> digests;
+    ok = ok && get(in, stepCount) && stepCount <= fileBytes / 8;
+    if (ok) {
+        digests.resize(static_cast<size_t>(stepCount));
+        ok = static_cast<bool>(in.read(reinterpret_cast<char*>(digests.data()), static_cast<streamsize>(stepCount * 8)));
+    }
+    if (!ok || allocationMode > static_cast<uint8_t>(AllocationMode::Batched) ||
+        routingMode > static_cast<uint8_t>(RoutingMode::Zoned)) {
+        cerr << path << ": truncated or corrupt run script\n";
+        return false;
+    }
+
+    g.rng.key = seed;
+    g.rng.counter = counter;
+    g.simTimeSec = startTimeSec;
+    g.allocationMode = static_cast<AllocationMode>(allocationMode);
+    g.routingMode = static_cast<RoutingMode>(routingMode);
+    g.leakThreshold = leakThreshold;
+    report.recordedSteps = static_cast<long long>(stepCount);
+
+    auto start = chrono::steady_clock::now();
+    size_t next = 0;
+    EditBatch batch;
+    bool editsOk = true;
+    for (long long step = 0; editsOk && step < report.recordedSteps; ++step) {
+        while (editsOk && next < edits.size() && edits[next].step == step) {
+            batch.clear();
+            const uint32_t batchNo = edits[next].batch;
+            while (next < edits.size() && edits[next].step == step && edits[next].batch == batchNo) {
+                batch.edits.push_back(edits[next++].edit);
+            }
+            editsOk = g.applyEdits(batch);
+        }
+        if (!editsOk) {
+            cerr << path << ": edit before step " << step << " could not be applied\n";
+            break;
+        }
+        g.simulateStep(params.intervalSec, params.sourceId, params.maxReductionPerHour, params.prescribedLevel);
+        report.steps = step + 1;
+        if (levelDigest(g) != digests[static_cast<size_t>(step)]) {
+            report.firstMismatchStep = step;
+            break;
+        }
+    }
+    report.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef GRAPH_REPLAY_H
+#define GRAPH_REPLAY_H
+
+#include "graph_types.h"
+#include "graph_observer.h"
+
+class Graph;
+
+// Fixed parameters of a stepped run, passed to every simulateStep call.
+struct RunParams {
+    int intervalSec = 30;
+    int sourceId = 0;
+    double maxReductionPerHour = 10000.0;
+    double prescribedLevel = 200.0;
+};
+
+// Outcome of replayRun.
+struct ReplayReport {
+    long long steps = 0;               // steps re-executed
+    long long recordedSteps = 0;
+    long long firstMismatchStep = -1;  // 0-based step whose levels differed, -1 if none did
+    double wallSeconds = 0.0;
+
+    bool ok() const { return firstMismatchStep < 0 && steps == recordedSteps; }
+};
+
+// Records a stepped run so replayRun can re-execute it. begin() saves the starting network (with
+// levels) to <path>.net and notes the seed, time, modes and simulated pipe losses; after that the
+// recorder, attached as an observer, logs every applyEdits batch at the step it preceded and a
+// digest of the level column after every step. finish() writes the script to <path>.
+//
+// Script: magic "WNETRUN1", version u32, pad u32, seed u64, rng counter u64, simTimeSec i32,
+//         intervalSec i32, sourceId i32, allocationMode u8, routingMode u8, pad u16,
+//         maxReductionPerHour f64, prescribedLevel f64, leakThreshold f64,
+//         lossCount u64 + lossCount * (edge u32, pad u32, fraction f64),
+//         editCount u64 + editCount * (step u64, kind u32, a i32, b i32, batch u32, value f64),
+//         stepCount u64 + stepCount * digest u64
+// Consecutive edits with the same batch number were one applyEdits call and are replayed as one.
+// The leak detector is not saved, so begin() refuses to record once it has learned anything; start
+// recording before the first step (or after --restore only when the detector is still empty).
+class RunRecorder : public SimulationObserver {
+public:
+    bool begin(const Graph& g, const RunParams& params, const string& path);
+    bool finish() const;
+    long long steps() const { return static_cast<long long>(digests.size()); }
+
+    void onStepEnd(const Graph& g) override;
+    void onEdits(const Graph& g, const EditBatch& batch) override;
+
+private:
+    struct TimedEdit {
+        long long step;
+        uint32_t batch;
+        GraphEdit edit;
+    };
+
+    string path;
+    RunParams params;
+    uint64_t seed = 0;
+    uint64_t counter = 0;
+    int startTimeSec = 0;
+    AllocationMode allocationMode = AllocationMode::GreedyPath;
+    RoutingMode routingMode = RoutingMode::Tree;
+    double leakThreshold = 0.0;
+    vector<pair<int, double>> losses; // edge index -> simulated loss at the start
+    vector<TimedEdit> edits;
+    uint32_t batches = 0;
+    vector<uint64_t> digests;
+};
+
+// FNV-1a over the bits of every node level, in slot order.
+uint64_t levelDigest(const Graph& g);
+
+// Loads <path>.net, restores the recorded seed and settings, re-applies the edits before their
+// steps and re-runs every step, comparing each level digest with the recorded one. Stops at the
+// first mismatch. Returns false (with a message on cerr) when the files cannot be read.
+bool replayRun(const string& path, ReplayReport& report);
+
+#endif // GRAPH_REPLAY_H
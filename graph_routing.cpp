@@ -0,0 +1,130 @@
+#include <algorithm>
+#include "graph.h"
+#include "graph_metrics.h"
+
+// ---------------- single-source routing ----------------
+
+// Returns the BFS tree rooted at sourceId. The tree is cached and only rebuilt when the
+// source changes or an edit has bumped topologyVersion, so a step that refills many tanks
+// pays for one traversal instead of one per tank.
+const RouteTree& Graph::routeTree(int sourceId) const {
+    const CsrTopology& t = topology();
+    int sourceSlot = getNodeSlot(sourceId);
+    if (routeCache.sourceSlot == sourceSlot && routeCache.topologyVersion == topologyVersion &&
+        static_cast<int>(routeCache.parentEdge.size()) == t.nodeCount()) {
+        return routeCache;
+    }
+    METRIC_SCOPE(Routing);
+
+    routeCache.sourceSlot = sourceSlot;
+    routeCache.topologyVersion = topologyVersion;
+    routeCache.parentEdge.assign(t.nodeCount(), -1);
+    if (sourceSlot == -1) return routeCache;
+
+    PathWorkspace& ws = pathScratch;
+    ws.begin(t.nodeCount(), static_cast<int>(edges.size()));
+    int head = 0, tail = 0;
+    ws.queue[tail++] = sourceSlot;
+    ws.visit(sourceSlot, -1);
+    while (head < tail) {
+        int current = ws.queue[head++];
+        for (int pos = t.offsets[current]; pos < t.offsets[current + 1]; ++pos) {
+            int neighbor = t.targets[pos];
+            if (ws.visited(neighbor)) continue;
+            ws.visit(neighbor, t.edgeIds[pos]);
+            routeCache.parentEdge[neighbor] = t.edgeIds[pos];
+            ws.queue[tail++] = neighbor;
+        }
+    }
+    METRIC_ADD(BfsNodesVisited, tail);
+    return routeCache;
+}
+
+// Returns the maximum-bottleneck tree rooted at sourceId: every slot is reached through the path
+// whose narrowest pipe, min(capacity, flowRate), is as wide as possible. Pipe rates are ranked
+// once per topology version, so the search is a bucket queue over ranks: widths only shrink along
+// a path, and the scan moves from the widest bucket down, O(E + distinct rates) per tree.
+// Within a bucket slots are taken first-in first-out, which prefers fewer pipes among equally
+// wide paths. Cached like routeTree.
+const RouteTree& Graph::widestTree(int sourceId) const {
+    const CsrTopology& t = topology();
+    int sourceSlot = getNodeSlot(sourceId);
+    if (widestCache.sourceSlot == sourceSlot && widestCache.topologyVersion == topologyVersion &&
+        static_cast<int>(widestCache.parentEdge.size()) == t.nodeCount()) {
+        return widestCache;
+    }
+    METRIC_SCOPE(Routing);
+
+    WidestScratch& w = widestScratch;
+    if (!w.ranked || w.topologyVersion != topologyVersion) {
+        vector<double> rates;
+        rates.reserve(t.edgeIds.size());
+        for (int eidx : t.edgeIds) rates.push_back(min(t.edgeCapacity[eidx], t.edgeFlowRate[eidx]));
+        sort(rates.begin(), rates.end());
+        rates.erase(unique(rates.begin(), rates.end()), rates.end());
+        w.edgeRank.assign(edges.size(), -1);
+        for (int eidx : t.edgeIds) {
+            double r = min(t.edgeCapacity[eidx], t.edgeFlowRate[eidx]);
+            w.edgeRank[eidx] = static_cast<int>(lower_bound(rates.begin(), rates.end(), r) - rates.begin());
+        }
+        w.rankCount = static_cast<int>(rates.size());
+        w.topologyVersion = topologyVersion;
+        w.ranked = true;
+    }
+
+    widestCache.sourceSlot = sourceSlot;
+    widestCache.topologyVersion = topologyVersion;
+    widestCache.parentEdge.assign(t.nodeCount(), -1);
+    if (sourceSlot == -1) return widestCache;
+
+    // the source sits in an extra top bucket standing for an infinitely wide pipe
+    const int top = w.rankCount;
+    w.bestRank.assign(t.nodeCount(), -1);
+    w.buckets.resize(top + 1);
+    for (auto& b : w.buckets) b.clear();
+    w.bestRank[sourceSlot] = top;
+    w.buckets[top].push_back(sourceSlot);
+    for (int r = top; r >= 0; --r) {
+        vector<int>& bucket = w.buckets[r];
+        for (size_t i = 0; i < bucket.size(); ++i) { // the bucket can grow while it is scanned
+            int current = bucket[i];
+            if (w.bestRank[current] != r) continue;   // settled in a wider bucket already
+            for (int pos = t.offsets[current]; pos < t.offsets[current + 1]; ++pos) {
+                int neighbor = t.targets[pos];
+                int eidx = t.edgeIds[pos];
+                int nr = min(r, w.edgeRank[eidx]);
+                if (nr <= w.bestRank[neighbor]) continue;
+                w.bestRank[neighbor] = nr;
+                widestCache.parentEdge[neighbor] = eidx;
+                w.buckets[nr].push_back(neighbor);
+            }
+        }
+        bucket.clear();
+    }
+    widestCache.parentEdge[sourceSlot] = -1;
+    return widestCache;
+}
+
+// Walks the tree from targetId back to the source; O(path length).
+bool Graph::extractPath(const RouteTree& tree, int targetId, vector<int>& path) const {
+    METRIC_SCOPE(Routing);
+    int slot = getNodeSlot(targetId);
+    if (slot == -1 || tree.sourceSlot == -1) return false;
+    path.clear();
+    if (slot == tree.sourceSlot) return true;
+    if (tree.parentEdge[slot] == -1) return false;
+
+    while (slot != tree.sourceSlot) {
+        int eidx = tree.parentEdge[slot];
+        path.push_back(eidx);
+        slot = getNodeSlot(edges[eidx].from);
+    }
+    reverse(path.begin(), path.end());
+    return true;
+}
+
+// Same shortest path as findPath, answered by the zone router (see graph_zones.h).
+bool Graph::findZonedPath(int sourceId, int targetId, vector<int>& path) const {
+    METRIC_SCOPE(Routing);
+    return zoneRouter.findPath(*this, sourceId, targetId, path);
+}
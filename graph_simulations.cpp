@@ -1,295 +1,345 @@
-#include <algorithm>
-#include <cmath>
-#include <iostream>
-#include <limits>
-#include <unordered_map>
-#include "graph.h"
-
-void Graph::updateTankLevels(int intervalSec, double maxReductionPerHour){
-    // convert maxReductionPerHour units/hour to units/sec
-    double maxReductionPerSec = maxReductionPerHour / 3600.0;
-    uniform_real_distribution<double> dist(0.0, 1.0);
-
-    for (auto& n : nodes){
-        if(n.id==0) continue;
-        double r = dist(rng); // random factor in [0,1)
-        double reduction = r * maxReductionPerSec * intervalSec;
-        double before = n.currentLevel;
-
-        n.currentLevel = max(0.0, n.currentLevel - reduction);
-
-        if (reduction > 0.0) {
-            ostringstream oss;
-            oss << (n.type == NodeType::Tank ? "Tank " : "Industry ")
-                << n.id << " consumed " << reduction
-                << " units (before=" << before
-                << ", after=" << n.currentLevel << ")";
-                pushLog(oss.str());
-        }
-    }
-}
-
-// BFS pathfinding; bannededges is set of edge indices to avoid because they might be broken
-bool Graph::findPath(int sourceId, int targetId, vector<int>& path, const unordered_set<int>& bannedEdges) const {
-    unordered_map<int,int> parentNode;
-    unordered_map<int,int> parentEdge; // edge index used to reach node
-    queue<int> q;
-    unordered_set<int> visited;
-
-    q.push(sourceId);
-    visited.insert(sourceId);
-
-    while (!q.empty()) {
-        int current = q.front(); q.pop();
-
-        if (current == targetId) {
-            // reconstruct path as list of edge indices
-            path.clear();
-            int node = targetId;
-            while (node != sourceId){
-                int eidx = parentEdge[node];
-                path.push_back(eidx);
-                node = parentNode[node];
-            }
-            reverse(path.begin(), path.end());
-            return true;
-        }
-
-        // explore outgoing edges from current
-        const Node* cn = getNodeByIdConst(current);
-        if (!cn) continue;
-        for (int eidx : cn->outgoingEdges) {
-            if (bannedEdges.count(eidx)) continue;
-            const Edge& e = edges[eidx];
-            if (!e.active) continue;
-            if (e.valveStatus == 0) continue; // pipe closed
-            int neighbor = e.to;
-            if (!visited.count(neighbor)) {
-                visited.insert(neighbor);
-                parentNode[neighbor] = current;
-                parentEdge[neighbor] = eidx;
-                q.push(neighbor);
-            }
-        }
-    }
-    return false;
-}
-
-// Supply water along a path of edge indices.
-// Returns (expectedDelivered, actualDelivered).
-pair<double,double> Graph::supplyWaterAlongPath(int sourceId, const vector<int>& path, int intervalSec) {
-    if (path.empty()) return {0,0};
-
-    Node* source = getNodeById(sourceId);
-    if (!source) return {0,0};
-    int targetNodeId = edges[path.back()].to;
-    Node* target = getNodeById(targetNodeId);
-    if (!target) return {0,0};
-
-    // Find bottleneck supply rate across the entire path
-    double bottleneck = numeric_limits<double>::infinity();
-    for (int idx : path) {
-        const Edge& e = edges[idx];
-        double r = min(e.capacity, e.flowRate);
-        if (r < bottleneck) bottleneck = r;
-    }
-    if (!isfinite(bottleneck)) return {0,0};
-
-    double supplyRate = 0.8 * bottleneck; // units/sec
-    double expected = supplyRate * static_cast<double>(intervalSec);
-
-    // How much target tank can actually accept
-    double remaining = max(0.0, target->storageCapacity - target->currentLevel);
-    if (remaining <= 0.0) {
-        return {0,0}; // tank already full
-    }
-
-    // Adjust interval if expected would overshoot
-    if (expected > remaining) {
-        intervalSec = static_cast<int>(remaining / supplyRate);
-        expected = remaining;
-    }
-
-    // Amount that will be transferred
-    double transfer = min(remaining, expected);
-
-    // If source is a normal tank (not reservoir), reduce its level
-    if (source->id !=0) {
-        source->currentLevel = max(0.0, source->currentLevel - transfer);
-    }
-
-    double before = target->currentLevel;
-    target->currentLevel = min(target->currentLevel + transfer, target->storageCapacity);
-    double actualDelivered = target->currentLevel - before;
-
-    // Log supply event
-    {
-        ostringstream oss;
-        oss << "Supplied to Tank " << target->id << " via path (";
-        for (size_t i = 0; i < path.size(); ++i) {
-            if (i) oss << "->";
-            oss << edges[path[i]].from;
-        }
-        oss << "->" << target->id << ") expected=" << expected
-            << " actual=" << actualDelivered
-            << " (before=" << before << ", after=" << target->currentLevel << ")";
-        pushLog(oss.str());
-    }
-
-    return {expected, actualDelivered};
-}
-
-
-// Simulate single time step (intervalSec seconds)
-// Simulate single time step (intervalSec seconds) with priority-based tank filling
-void Graph::simulateStep(int intervalSec, int sourceId, double maxReductionPerHour, double prescribedLevel) {
-    // Advance simulation time
-    simTimeSec += intervalSec;
-
-    // 1) Reduce tank/industry levels due to consumption/leak
-    updateTankLevels(intervalSec, maxReductionPerHour);
-
-    // 2) Create priority queue of tanks that need refilling
-    // Priority criteria:
-    // - Lower current level (more empty tanks get higher priority)
-    // - Higher storage capacity (larger tanks get higher priority when equally empty)
-    // - You can add other criteria like tank importance/type if needed
-
-    // Using a max-heap based on priority score
-    struct TankPriority {
-        int nodeId;
-        double currentLevel;
-        double storageCapacity;
-        double priorityScore;
-
-        // Higher priority score means more urgent
-        bool operator<(const TankPriority& other) const {
-            return priorityScore < other.priorityScore;
-        }
-    };
-
-    priority_queue<TankPriority> tankQueue;
-
-    // Calculate priority for each tank below prescribed level
-    for (auto& n : nodes) {
-        if (n.type != NodeType::Tank) continue;
-        if (n.currentLevel >= prescribedLevel) continue;
-
-        TankPriority tp;
-        tp.nodeId = n.id;
-        tp.currentLevel = n.currentLevel;
-        tp.storageCapacity = n.storageCapacity;
-
-        // Priority calculation:
-        // - Higher priority for more empty tanks (lower current level)
-        // - Higher priority for larger tanks when equally empty
-        // - You can customize this formula based on your needs
-        double emptinessRatio = 1.0 - (n.currentLevel / prescribedLevel);
-        tp.priorityScore = emptinessRatio * n.storageCapacity;
-
-        tankQueue.push(tp);
-
-        ostringstream preMsg;
-        preMsg << "Tank " << n.id << " (" << n.name << ") below prescribed level: "
-               << n.currentLevel << " < " << prescribedLevel << " | Priority: " << tp.priorityScore;
-        pushLog(preMsg.str());
-    }
-
-    cout << "\n--- Priority-based refill sequence at " << Graph::formatTime(simTimeSec) << " ---\n";
-
-    // 3) Process tanks in priority order
-    int tanksProcessed = 0;
-    const int MAX_TANKS_PER_STEP = 3; // Limit tanks processed per step to avoid starvation
-
-    while (!tankQueue.empty() && tanksProcessed < MAX_TANKS_PER_STEP) {
-        TankPriority currentTank = tankQueue.top();
-        tankQueue.pop();
-
-        Node* tankNode = getNodeById(currentTank.nodeId);
-        if (!tankNode) continue;
-
-        cout << "Processing Tank " << currentTank.nodeId << " (" << tankNode->name
-             << ") - Priority: " << currentTank.priorityScore
-             << " Level: " << currentTank.currentLevel << "/" << currentTank.storageCapacity << "\n";
-
-        vector<int> path;
-        if (!findPath(sourceId, currentTank.nodeId, path)) {
-            string msg = "No available path from source " + to_string(sourceId) +
-                         " to tank " + to_string(currentTank.nodeId);
-            pushLog(msg);
-            cout << "  " << msg << "\n";
-            tanksProcessed++;
-            continue;
-        }
-
-        // Attempt filling along found path
-        auto [expected, actual] = supplyWaterAlongPath(sourceId, path, intervalSec);
-
-        cout << "  Expected delivered (units): " << expected
-             << " | Actual delivered: " << actual << "\n";
-
-        // If expected > 0 and actual < threshold*expected => leak suspected
-        if (expected > 0 && actual < leakThreshold * expected) {
-            ostringstream leakMsg;
-            leakMsg << "Leak suspected on path to Tank " << currentTank.nodeId
-                    << " (expected=" << expected << ", actual=" << actual << ")";
-            pushLog(leakMsg.str());
-            cout << "  >>> Leak suspected on path to Tank " << currentTank.nodeId
-                 << " (actual < " << leakThreshold*100 << "% of expected).\n";
-
-            // Try alternate route (ban edges in current path)
-            unordered_set<int> banned;
-            for (int idx : path) banned.insert(idx);
-
-            vector<int> altPath;
-            if (findPath(sourceId, currentTank.nodeId, altPath, banned)) {
-                cout << "  Alternate route found. Attempting alternate route...\n";
-                auto [exp2, act2] = supplyWaterAlongPath(sourceId, altPath, intervalSec);
-                cout << "    Alternate expected: " << exp2 << " | Actual: " << act2 << "\n";
-                if (exp2 > 0 && act2 < leakThreshold * exp2) {
-                    string altMsg = "Alternate route also suspected leaking for Tank " + to_string(currentTank.nodeId);
-                    pushLog(altMsg);
-                    cout << "    >>> Alternate route also under-delivered.\n";
-                } else {
-                    string okMsg = "Alternate route delivered adequately to Tank " + to_string(currentTank.nodeId);
-                    pushLog(okMsg);
-                    cout << "    Alternate route delivered adequately.\n";
-                }
-            } else {
-                string noneMsg = "No alternate route available for Tank " + to_string(currentTank.nodeId) +
-                                 ". Please inspect pipes.";
-                pushLog(noneMsg);
-                cout << "  No alternate route available. Please inspect pipes or mark leak repaired.\n";
-            }
-        }
-
-        tanksProcessed++;
-    }
-
-    // Log if some tanks weren't processed due to limit
-    if (!tankQueue.empty()) {
-        ostringstream limitMsg;
-        limitMsg << tanksProcessed << " tanks processed this step. "
-                 << tankQueue.size() << " tanks remaining in queue for next step.";
-        pushLog(limitMsg.str());
-        cout << limitMsg.str() << "\n";
-    }
-
-    // 4) Print snapshot
-    cout << "\n--- Snapshot at " << Graph::formatTime(simTimeSec) << " ---\n";
-    cout << fixed << setprecision(2);
-    for (const auto& no : nodes) {
-        cout << "Node " << no.id << " (" << no.name << "): level=" << no.currentLevel
-             << " / " << no.storageCapacity << " | valveStatus=" << no.valveStatus
-             << " | outgoing=" << no.outgoingEdges.size() << "\n";
-    }
-    cout << "Edges:\n";
-    for (size_t i = 0; i < edges.size(); ++i) {
-        const auto& e = edges[i];
-        cout << "  Edge[" << i << "] " << e.from << "->" << e.to
-             << " cap=" << e.capacity << " flowRate=" << e.flowRate
-             << " active=" << (e.active ? "Y":"N")
-             << " valve=" << e.valveStatus << "\n";
-    }
-    cout << "----------------------------------------\n";
-}
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "graph.h"
+#include "graph_kernels.h"
+#include "graph_metrics.h"
+#include "graph_random.h"
+#include "thread_pool.h"
+
+// Consumption is computed over fixed-size chunks of nodes. The step reserves one counter value of
+// the graph's CounterRng and each node's factor is the draw at (seed, node id, that counter), so the
+// result for a given seed does not depend on chunking, thread count or node order.
+static const size_t CONSUMPTION_CHUNK = 4096;
+static const size_t PARALLEL_MIN_NODES = 4 * CONSUMPTION_CHUNK;
+
+void Graph::updateTankLevels(int intervalSec, double maxReductionPerHour){
+    METRIC_SCOPE(Consumption);
+    // convert maxReductionPerHour units/hour to units/sec
+    double maxReductionPerSec = maxReductionPerHour / 3600.0;
+    const uint64_t seedKey = rng.key, draw = rng.reserve();
+    const size_t chunkCount = (nodes.size() + CONSUMPTION_CHUNK - 1) / CONSUMPTION_CHUNK;
+
+    // Records per chunk, merged in chunk order below. They live in the step arena, which the
+    // workers must not touch, so every chunk's room is reserved here first.
+    StepArena::Scope scope(stepArena);
+    pmr::vector<pmr::vector<LogEntry>> staged(chunkCount, stepArena.resource());
+    for (size_t c = 0; c < chunkCount; ++c) {
+        staged[c].reserve(min(nodes.size(), (c + 1) * CONSUMPTION_CHUNK) - c * CONSUMPTION_CHUNK);
+    }
+
+    const double scale = maxReductionPerSec * intervalSec;
+    const int reservoirSlot = getNodeSlot(0); // the reservoir is never drawn down
+
+    auto consumeChunk = [&](size_t c) {
+        size_t begin = c * CONSUMPTION_CHUNK;
+        size_t len = min(nodes.size(), begin + CONSUMPTION_CHUNK) - begin;
+        double factor[CONSUMPTION_CHUNK] = {}; // random factor in [0,1) per node
+        double before[CONSUMPTION_CHUNK];
+        double* level = state.level.data() + begin;
+
+        for (size_t i = 0; i < len; ++i) {
+            factor[i] = static_cast<int>(begin + i) == reservoirSlot
+                            ? 0.0
+                            : CounterRng::unitAt(seedKey, static_cast<uint64_t>(nodes[begin + i].id), draw);
+        }
+        copy(level, level + len, before);
+        consumeLevels(level, factor, scale, len);
+
+        const unsigned char* isTank = state.isTank.data() + begin;
+        for (size_t i = 0; i < len; ++i) {
+            double reduction = factor[i] * scale;
+            if (reduction > 0.0) {
+                staged[c].push_back(LogEntry{LogKind::Consumption, simTimeSec, nodes[begin + i].id, isTank[i], 0,
+                                             {reduction, before[i], level[i], 0.0}});
+            }
+        }
+    };
+
+    if (nodes.size() >= PARALLEL_MIN_NODES) {
+        ThreadPool& pool = workerPool ? *workerPool : ThreadPool::shared();
+        pool.parallelFor(chunkCount, consumeChunk);
+    } else {
+        for (size_t c = 0; c < chunkCount; ++c) consumeChunk(c);
+    }
+
+    METRIC_SCOPE(Logging);
+    for (const auto& chunk : staged) {
+        for (const auto& entry : chunk) history.push(entry);
+    }
+}
+
+// BFS pathfinding over the CSR snapshot; bannedEdges lists edge indices to avoid because they might be broken.
+// Uses the graph's own scratch workspace; concurrent callers should pass their own PathWorkspace.
+bool Graph::findPath(int sourceId, int targetId, vector<int>& path, const vector<int>& bannedEdges) const {
+    return findPath(sourceId, targetId, path, pathScratch, bannedEdges);
+}
+
+bool Graph::findPath(int sourceId, int targetId, vector<int>& path, PathWorkspace& ws, const vector<int>& bannedEdges) const {
+    METRIC_SCOPE(Routing);
+    const CsrTopology& t = topology();
+    int sourceSlot = getNodeSlot(sourceId);
+    int targetSlot = getNodeSlot(targetId);
+    if (sourceSlot == -1 || targetSlot == -1) return false;
+
+    ws.begin(t.nodeCount(), static_cast<int>(edges.size()));
+    for (int eidx : bannedEdges) ws.ban(eidx);
+
+    int head = 0, tail = 0;
+    ws.queue[tail++] = sourceSlot;
+    ws.visit(sourceSlot, -1);
+
+    while (head < tail) {
+        int current = ws.queue[head++];
+
+        if (current == targetSlot) {
+            // reconstruct path as list of edge indices
+            path.clear();
+            int slot = targetSlot;
+            while (slot != sourceSlot){
+                int eidx = ws.parentEdge[slot];
+                path.push_back(eidx);
+                slot = getNodeSlot(edges[eidx].from);
+            }
+            reverse(path.begin(), path.end());
+            METRIC_ADD(BfsNodesVisited, head);
+            return true;
+        }
+
+        // explore usable pipes leaving current (inactive and closed pipes are not in the snapshot)
+        for (int pos = t.offsets[current]; pos < t.offsets[current + 1]; ++pos) {
+            int neighbor = t.targets[pos];
+            if (ws.visited(neighbor)) continue;
+            int eidx = t.edgeIds[pos];
+            if (ws.banned(eidx)) continue;
+            ws.visit(neighbor, eidx);
+            ws.queue[tail++] = neighbor;
+        }
+    }
+    METRIC_ADD(BfsNodesVisited, head);
+    return false;
+}
+
+// Rate water can be pushed along a path: 80% of the bottleneck min(capacity, flowRate).
+double Graph::pathSupplyRate(const vector<int>& path) const {
+    if (path.empty()) return 0.0;
+    const CsrTopology& t = topology();
+    double bottleneck = numeric_limits<double>::infinity();
+    for (int idx : path) {
+        double r = min(t.edgeCapacity[idx], t.edgeFlowRate[idx]);
+        if (r < bottleneck) bottleneck = r;
+    }
+    return 0.8 * bottleneck;
+}
+
+// Adds volume, sent into the start of path, to the flow of every pipe on it; each pipe gets what
+// survived the simulated leaks before it. No-op unless recordEdgeFlows is set.
+void Graph::addPathFlow(const vector<int>& path, double volume) {
+    if (!recordEdgeFlows) return;
+    if (edgeFlow.size() < edges.size()) edgeFlow.resize(edges.size(), 0.0);
+    for (int eidx : path) {
+        edgeFlow[eidx] += volume;
+        volume *= 1.0 - edges[eidx].lossFraction;
+    }
+}
+
+// Supply water along a path of edge indices, at no more than maxRate units/sec.
+// Returns (expectedDelivered, actualDelivered).
+pair<double,double> Graph::supplyWaterAlongPath(int sourceId, const vector<int>& path, int intervalSec, double maxRate) {
+    METRIC_SCOPE(Supply);
+    if (path.empty()) return {0,0};
+
+    int sourceSlot = getNodeSlot(sourceId);
+    if (sourceSlot == -1) return {0,0};
+    int targetNodeId = edges[path.back()].to;
+    int targetSlot = getNodeSlot(targetNodeId);
+    if (targetSlot == -1) return {0,0};
+    double& targetLevel = state.level[targetSlot];
+    const double targetCapacity = state.capacity[targetSlot];
+
+    double supplyRate = min(pathSupplyRate(path), maxRate); // units/sec
+    double expected = supplyRate * static_cast<double>(intervalSec);
+
+    // How much target tank can actually accept
+    double remaining = max(0.0, targetCapacity - targetLevel);
+    if (remaining <= FULL_TOLERANCE * targetCapacity) {
+        return {0,0}; // tank already full
+    }
+
+    // Adjust interval if expected would overshoot
+    if (expected > remaining) {
+        intervalSec = static_cast<int>(remaining / supplyRate);
+        expected = remaining;
+    }
+
+    // Amount that will be transferred
+    double transfer = min(remaining, expected);
+
+    // If source is a normal tank (not reservoir), reduce its level
+    if (sourceId !=0) {
+        state.level[sourceSlot] = max(0.0, state.level[sourceSlot] - transfer);
+    }
+
+    // Pipes with a simulated leak lose part of it on the way
+    double before = targetLevel;
+    targetLevel = min(targetLevel + transfer * pathRetention(path), targetCapacity);
+    double actualDelivered = targetLevel - before;
+    addPathFlow(path, transfer);
+
+    // Log supply event
+    logEvent(LogKind::Supply, targetNodeId, sourceId, static_cast<int>(path.size()),
+             expected, actualDelivered, before, targetLevel);
+
+    return {expected, actualDelivered};
+}
+
+
+// Simulate single time step (intervalSec seconds)
+// Simulate single time step (intervalSec seconds) with priority-based tank filling
+void Graph::simulateStep(int intervalSec, int sourceId, double maxReductionPerHour, double prescribedLevel) {
+    METRIC_SCOPE(Step);
+    METRIC_ADD(Steps, 1);
+    StepArena::Scope scope(stepArena); // the step's transient containers are released on return
+    // Advance simulation time
+    simTimeSec += intervalSec;
+    if (recordEdgeFlows) edgeFlow.assign(edges.size(), 0.0);
+
+    // 1) Reduce tank/industry levels due to consumption/leak
+    updateTankLevels(intervalSec, maxReductionPerHour);
+
+    // 2) Create priority queue of tanks that need refilling
+    // Priority criteria:
+    // - Lower current level (more empty tanks get higher priority)
+    // - Higher storage capacity (larger tanks get higher priority when equally empty)
+    // - You can add other criteria like tank importance/type if needed
+
+    // Using a max-heap based on priority score
+    struct TankPriority {
+        int nodeId;
+        double currentLevel;
+        double storageCapacity;
+        double priorityScore;
+
+        // Higher priority score means more urgent
+        bool operator<(const TankPriority& other) const {
+            return priorityScore < other.priorityScore;
+        }
+    };
+
+    priority_queue<TankPriority, pmr::vector<TankPriority>> tankQueue{less<TankPriority>(),
+                                                                      pmr::vector<TankPriority>(stepArena.resource())};
+
+    // Calculate priority for each tank below prescribed level. The filter and the score
+    // (1 - level / prescribedLevel) * capacity run as one vector kernel over the NodeState columns:
+    // - Higher priority for more empty tanks (lower current level)
+    // - Higher priority for larger tanks when equally empty
+    {
+        METRIC_SCOPE(PriorityQueue);
+        pmr::vector<int> belowSlots(state.size(), stepArena.resource());
+        pmr::vector<double> belowScores(state.size(), stepArena.resource());
+        size_t belowCount = selectTanksBelow(state.level.data(), state.capacity.data(), state.isTank.data(),
+                                             state.size(), prescribedLevel, belowSlots.data(), belowScores.data());
+        for (size_t k = 0; k < belowCount; ++k) {
+            int slot = belowSlots[k];
+            const Node& n = nodes[slot];
+
+            TankPriority tp;
+            tp.nodeId = n.id;
+            tp.currentLevel = state.level[slot];
+            tp.storageCapacity = state.capacity[slot];
+            tp.priorityScore = belowScores[k];
+
+            tankQueue.push(tp);
+
+            logEvent(LogKind::BelowPrescribed, n.id, 0, 0, tp.currentLevel, prescribedLevel, tp.priorityScore);
+        }
+    }
+
+    for (auto* o : observers) o->onStepBegin(*this);
+
+    // 3a) Max-flow mode serves every queued tank with a single flow solve
+    if (allocationMode == AllocationMode::MaxFlow && !tankQueue.empty()) {
+        stepTargets.clear();
+        while (!tankQueue.empty()) {
+            stepTargets.push_back(tankQueue.top().nodeId);
+            tankQueue.pop();
+        }
+        double delivered = supplyWaterMaxFlow(sourceId, stepTargets, intervalSec);
+        for (auto* o : observers) o->onMaxFlowAllocation(*this, stepTargets.size(), delivered);
+    }
+
+    // Batched mode takes every queued tank and applies them in conflict-free parallel batches
+    if (allocationMode == AllocationMode::Batched && !tankQueue.empty()) {
+        stepRequests.clear();
+        while (!tankQueue.empty()) {
+            const TankPriority& tp = tankQueue.top();
+            stepRequests.push_back(RefillRequest{tp.nodeId, tp.currentLevel, tp.storageCapacity, tp.priorityScore});
+            tankQueue.pop();
+        }
+        RefillStats refill = supplyWaterBatched(sourceId, stepRequests, intervalSec);
+        for (auto* o : observers) o->onBatchedRefill(*this, refill.tanks, refill.batches, refill.delivered);
+    }
+
+    // 3b) Otherwise process tanks in priority order; all paths come from one cached tree rooted at the
+    // source (fewest pipes, or widest bottleneck), or from the zone router's overlay in zoned mode.
+    // The tree is only built when tanks are left, i.e. not after the max-flow and batched modes.
+    const RouteTree* routes = tankQueue.empty()                  ? nullptr
+                            : routingMode == RoutingMode::Tree   ? &routeTree(sourceId)
+                            : routingMode == RoutingMode::Widest ? &widestTree(sourceId)
+                                                                 : nullptr;
+    vector<int>& path = stepPath; // kept across tanks and steps so its capacity is reused
+    int tanksProcessed = 0;
+    const int MAX_TANKS_PER_STEP = 3; // Limit tanks processed per step to avoid starvation
+
+    while (!tankQueue.empty() && tanksProcessed < MAX_TANKS_PER_STEP) {
+        TankPriority currentTank = tankQueue.top();
+        tankQueue.pop();
+
+        if (getNodeSlot(currentTank.nodeId) == -1) continue;
+
+        for (auto* o : observers) {
+            o->onTankProcessing(*this, currentTank.nodeId, currentTank.priorityScore,
+                                currentTank.currentLevel, currentTank.storageCapacity);
+        }
+
+        bool routed = routes ? extractPath(*routes, currentTank.nodeId, path)
+                             : findZonedPath(sourceId, currentTank.nodeId, path);
+        if (!routed) {
+            METRIC_ADD(PathsFailed, 1);
+            logEvent(LogKind::NoPath, currentTank.nodeId, sourceId);
+            for (auto* o : observers) o->onNoPath(*this, sourceId, currentTank.nodeId);
+            tanksProcessed++;
+            continue;
+        }
+
+        // Attempt filling along found path, around any pipe the leak detector has flagged
+        METRIC_ADD(PathsFound, 1);
+        steerAroundLeaks(sourceId, currentTank.nodeId, path);
+        auto [expected, actual] = supplyWaterAlongPath(sourceId, path, intervalSec);
+        recordDelivery(path, expected, actual);
+
+        for (auto* o : observers) o->onDelivery(*this, currentTank.nodeId, expected, actual);
+
+        // If expected > 0 and actual < threshold*expected => leak suspected
+        if (expected > 0 && actual < leakThreshold * expected) {
+            METRIC_ADD(LeakAlerts, 1);
+            logEvent(LogKind::LeakSuspected, currentTank.nodeId, 0, 0, expected, actual);
+            for (auto* o : observers) o->onLeakSuspected(*this, currentTank.nodeId, expected, actual);
+
+            // Try an alternate route that bans only the pipes the detector has flagged
+            retryAroundLeaks(sourceId, currentTank.nodeId, path, intervalSec);
+        }
+
+        tanksProcessed++;
+    }
+
+    // Log if some tanks weren't processed due to limit
+    if (!tankQueue.empty()) {
+        logEvent(LogKind::QueueCarryOver, -1, tanksProcessed, static_cast<int>(tankQueue.size()));
+        for (auto* o : observers) o->onQueueCarryOver(*this, tanksProcessed, tankQueue.size());
+    }
+
+    // 4) Let observers render the end-of-step snapshot
+    METRIC_SCOPE(Observers);
+    for (auto* o : observers) o->onStepEnd(*this);
+}
@@ -0,0 +1,504 @@
+#include "graph_timeseries.h"
+#include "graph.h"
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// ---------------- bit streams ----------------
+
+void BitStream::write(uint64_t value, int n) {
+    if (n <= 0) return;
+    if (n < 64) value &= (1ULL << n) - 1;
+    int off = static_cast<int>(bits & 63);
+    if (off == 0) {
+        words.push_back(value);
+    } else {
+        words.back() |= value << off;
+        if (off + n > 64) words.push_back(value >> (64 - off));
+    }
+    bits += static_cast<size_t>(n);
+}
+
+namespace {
+
+struct BitReader {
+    const uint64_t* words;
+    size_t pos = 0;
+
+    uint64_t read(int n) {
+        if (n <= 0) return 0;
+        size_t w = pos >> 6;
+        int off = static_cast<int>(pos & 63);
+        uint64_t v = words[w] >> off;
+        if (off + n > 64) v |= words[w + 1] << (64 - off);
+        pos += static_cast<size_t>(n);
+        return n < 64 ? v & ((1ULL << n) - 1) : v;
+    }
+    bool bit() { return read(1) != 0; }
+};
+
+// BitReader that refuses to read past limit bits; load() decodes every chunk with it once, so the
+// unchecked readers of the queries never meet a stream that runs off its column.
+struct CheckedBitReader {
+    BitReader in;
+    size_t limit;
+    bool ok = true;
+
+    uint64_t read(int n) {
+        if (!ok || limit - in.pos < static_cast<size_t>(max(n, 0))) {
+            ok = false;
+            return 0;
+        }
+        return in.read(n);
+    }
+    bool bit() { return read(1) != 0; }
+};
+
+// Delta-of-delta of the timestamps: '0' for a repeat of the previous interval, else a prefix
+// selecting a 7, 9 or 12 bit biased field, or '1111' and the full 32 bits.
+void writeTimeDelta(BitStream& out, int dod) {
+    if (dod == 0) {
+        out.write(0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        out.write(0x1, 2); // '10', least significant bit first
+        out.write(static_cast<uint64_t>(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        out.write(0x3, 3); // '110'
+        out.write(static_cast<uint64_t>(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        out.write(0x7, 4); // '1110'
+        out.write(static_cast<uint64_t>(dod + 2047), 12);
+    } else {
+        out.write(0xF, 4); // '1111'
+        out.write(static_cast<uint32_t>(dod), 32);
+    }
+}
+
+template <typename Reader>
+int readTimeDelta(Reader& in) {
+    if (!in.bit()) return 0;
+    if (!in.bit()) return static_cast<int>(in.read(7)) - 63;
+    if (!in.bit()) return static_cast<int>(in.read(9)) - 255;
+    if (!in.bit()) return static_cast<int>(in.read(12)) - 2047;
+    return static_cast<int>(static_cast<uint32_t>(in.read(32)));
+}
+
+uint64_t bitsOf(double v) {
+    uint64_t b;
+    memcpy(&b, &v, sizeof b);
+    return b;
+}
+
+double doubleOf(uint64_t b) {
+    double v;
+    memcpy(&v, &b, sizeof v);
+    return v;
+}
+
+// Decodes a column written by TimeSeriesRecorder::appendValue, one value per call.
+template <typename Reader>
+struct XorReader {
+    Reader in;
+    uint64_t prev = 0;
+    int leading = 0, trailing = 0;
+    bool first = true;
+    bool valid = true; // false once a window claimed more than 64 bits (a corrupt stream)
+
+    double next() {
+        if (first) {
+            first = false;
+            prev = in.read(64);
+        } else if (in.bit()) {
+            if (in.bit()) {
+                leading = static_cast<int>(in.read(5));
+                int significant = static_cast<int>(in.read(6));
+                if (significant == 0) significant = 64;
+                if (leading + significant > 64) {
+                    valid = false;
+                    significant = 64 - leading;
+                }
+                trailing = 64 - leading - significant;
+            }
+            prev ^= in.read(64 - leading - trailing) << trailing;
+        }
+        return doubleOf(prev);
+    }
+};
+
+} // namespace
+
+// ---------------- recording ----------------
+
+TimeSeriesRecorder::TimeSeriesRecorder(size_t chunkSamples) : chunkSamples(chunkSamples ? chunkSamples : 1) {}
+
+// XOR with the previous value: '0' when equal; '1','0' and the meaningful bits when they fit the
+// previous leading/trailing-zero window; '1','1', 5 bits of leading zeros, 6 bits of length and the
+// meaningful bits otherwise. The first value of a column is stored whole.
+void TimeSeriesRecorder::appendValue(size_t column, double value) {
+    BitStream& out = open.columns[column];
+    XorState& st = open.xors[column];
+    uint64_t b = bitsOf(value);
+    if (open.samples == 0) {
+        out.write(b, 64);
+        st = XorState{b, -1, 0};
+        return;
+    }
+    uint64_t x = b ^ st.prev;
+    st.prev = b;
+    if (x == 0) {
+        out.write(0, 1);
+        return;
+    }
+    int leading = min(__builtin_clzll(x), 31);
+    int trailing = __builtin_ctzll(x);
+    if (st.leading >= 0 && leading >= st.leading && trailing >= st.trailing) {
+        out.write(0x1, 2); // '1','0'
+        out.write(x >> st.trailing, 64 - st.leading - st.trailing);
+        return;
+    }
+    int significant = 64 - leading - trailing;
+    out.write(0x3, 2); // '1','1'
+    out.write(static_cast<uint64_t>(leading), 5);
+    out.write(static_cast<uint64_t>(significant & 63), 6);
+    out.write(x >> trailing, significant);
+    st.leading = leading;
+    st.trailing = trailing;
+}
+
+bool TimeSeriesRecorder::sameShape(const Graph& g, const SeriesLayout& layout) const {
+    if (layout.nodeIds.size() != g.nodes.size() || layout.edgeKeys.size() != g.edges.size()) return false;
+    if (g.topologyVersion == topologySeen) return true;
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        if (layout.nodeIds[i] != g.nodes[i].id) return false;
+    }
+    for (size_t i = 0; i < g.edges.size(); ++i) {
+        if (layout.edgeKeys[i] != Graph::edgeKey(g.edges[i].from, g.edges[i].to)) return false;
+    }
+    return true;
+}
+
+void TimeSeriesRecorder::startChunk(const Graph& g, int timeSec) {
+    if (!open.layout || !sameShape(g, *open.layout)) {
+        auto layout = make_shared<SeriesLayout>();
+        int maxId = -1;
+        for (const Node& n : g.nodes) {
+            layout->nodeIds.push_back(n.id);
+            maxId = max(maxId, n.id);
+        }
+        layout->columnByNodeId.assign(static_cast<size_t>(maxId + 1), -1);
+        for (size_t i = 0; i < layout->nodeIds.size(); ++i) layout->columnByNodeId[layout->nodeIds[i]] = static_cast<int>(i);
+        layout->columnByEdge.reserve(g.edges.size());
+        for (const Edge& e : g.edges) {
+            long long key = Graph::edgeKey(e.from, e.to);
+            layout->columnByEdge[key] = static_cast<int>(layout->nodeIds.size() + layout->edgeKeys.size());
+            layout->edgeKeys.push_back(key);
+        }
+        open.layout = layout;
+    }
+    topologySeen = g.topologyVersion;
+    open.startSec = open.endSec = timeSec;
+    open.samples = 0;
+    open.prevDelta = 0;
+    open.time.clear();
+    open.columns.resize(open.layout->columns());
+    for (BitStream& c : open.columns) c.clear();
+    open.xors.assign(open.layout->columns(), XorState());
+}
+
+void TimeSeriesRecorder::sample(const Graph& g) {
+    const int t = g.simTimeSec;
+    if (open.samples >= chunkSamples || (open.samples > 0 && !sameShape(g, *open.layout))) seal();
+    if (open.samples == 0) {
+        startChunk(g, t);
+    } else {
+        int delta = t - open.endSec;
+        writeTimeDelta(open.time, delta - open.prevDelta);
+        open.prevDelta = delta;
+        open.endSec = t;
+    }
+    topologySeen = g.topologyVersion;
+
+    const size_t n = g.state.size();
+    for (size_t slot = 0; slot < n; ++slot) appendValue(slot, g.state.level[slot]);
+    const size_t m = g.edges.size();
+    for (size_t i = 0; i < m; ++i) appendValue(n + i, i < g.edgeFlow.size() ? g.edgeFlow[i] : 0.0);
+    ++open.samples;
+    values += n + m;
+}
+
+// Packs the open chunk's columns into one word array; the per-column streams keep their capacity
+// for the next chunk.
+void TimeSeriesRecorder::seal() {
+    if (open.samples == 0) return;
+    Chunk c;
+    c.startSec = open.startSec;
+    c.endSec = open.endSec;
+    c.samples = open.samples;
+    c.layout = open.layout;
+    c.timeWords = open.time.words;
+    size_t total = 0;
+    for (const BitStream& s : open.columns) total += s.words.size();
+    c.words.reserve(total);
+    c.columnStart.reserve(open.columns.size() + 1);
+    for (const BitStream& s : open.columns) {
+        c.columnStart.push_back(static_cast<uint32_t>(c.words.size()));
+        c.words.insert(c.words.end(), s.words.begin(), s.words.end());
+    }
+    c.columnStart.push_back(static_cast<uint32_t>(c.words.size()));
+    chunks.push_back(move(c));
+    open.samples = 0;
+}
+
+void TimeSeriesRecorder::clear() {
+    chunks.clear();
+    open = OpenChunk();
+    topologySeen = 0;
+    values = 0;
+}
+
+size_t TimeSeriesRecorder::compressedBytes() const {
+    size_t words = 0;
+    for (const Chunk& c : chunks) words += c.timeWords.size() + c.words.size();
+    if (open.samples > 0) {
+        words += open.time.words.size();
+        for (const BitStream& s : open.columns) words += s.words.size();
+    }
+    return words * sizeof(uint64_t);
+}
+
+// ---------------- range queries ----------------
+
+template <typename ColumnOf>
+size_t TimeSeriesRecorder::query(ColumnOf columnOf, int fromSec, int toSec, vector<SeriesSample>& out) const {
+    size_t added = 0;
+    auto scan = [&](int startSec, uint32_t samples, const uint64_t* timeWords, const uint64_t* column) {
+        BitReader time{timeWords};
+        XorReader<BitReader> value{BitReader{column}};
+        int t = startSec, delta = 0;
+        for (uint32_t i = 0; i < samples; ++i) {
+            if (i > 0) {
+                delta += readTimeDelta(time);
+                t += delta;
+            }
+            if (t > toSec) break;
+            double v = value.next();
+            if (t >= fromSec) {
+                out.push_back(SeriesSample{t, v});
+                ++added;
+            }
+        }
+    };
+
+    // chunks are in time order: skip the ones that end before the window
+    auto it = lower_bound(chunks.begin(), chunks.end(), fromSec,
+                          [](const Chunk& c, int sec) { return c.endSec < sec; });
+    for (; it != chunks.end() && it->startSec <= toSec; ++it) {
+        int column = columnOf(*it->layout);
+        if (column < 0) continue;
+        scan(it->startSec, it->samples, it->timeWords.data(), it->words.data() + it->columnStart[column]);
+    }
+    if (open.samples > 0 && open.endSec >= fromSec && open.startSec <= toSec) {
+        int column = columnOf(*open.layout);
+        if (column >= 0) scan(open.startSec, open.samples, open.time.words.data(), open.columns[column].words.data());
+    }
+    return added;
+}
+
+size_t TimeSeriesRecorder::levels(int nodeId, int fromSec, int toSec, vector<SeriesSample>& out) const {
+    return query([nodeId](const SeriesLayout& l) {
+        return nodeId >= 0 && nodeId < static_cast<int>(l.columnByNodeId.size()) ? l.columnByNodeId[nodeId] : -1;
+    }, fromSec, toSec, out);
+}
+
+size_t TimeSeriesRecorder::flows(int from, int to, int fromSec, int toSec, vector<SeriesSample>& out) const {
+    const long long key = Graph::edgeKey(from, to);
+    return query([key](const SeriesLayout& l) {
+        auto it = l.columnByEdge.find(key);
+        return it == l.columnByEdge.end() ? -1 : it->second;
+    }, fromSec, toSec, out);
+}
+
+// ---------------- time-series file ----------------
+//
+// File:   magic "WTSERIE1", version u32, chunkSamples u32, layoutCount u64, chunkCount u64,
+//         then the layouts, then the chunks.
+// Layout: nodeCount u64, edgeCount u64, node ids i32[nodeCount], edge keys i64[edgeCount]
+// Chunk:  layout index u64, startSec i32, endSec i32, samples u32, pad u32,
+//         timeWords u64 + u64[timeWords], columns u64 + u32[columns + 1] start offsets,
+//         words u64 + u64[words]
+// Integers and words are written in host byte order (little-endian in practice).
+
+namespace {
+
+const char SERIES_MAGIC[8] = {'W', 'T', 'S', 'E', 'R', 'I', 'E', '1'};
+const uint32_t SERIES_VERSION = 1;
+
+template <typename T>
+void put(ofstream& out, T value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+template <typename T>
+void putArray(ofstream& out, const vector<T>& v) {
+    put<uint64_t>(out, v.size());
+    out.write(reinterpret_cast<const char*>(v.data()), static_cast<streamsize>(v.size() * sizeof(T)));
+}
+
+template <typename T>
+bool get(ifstream& in, T& value) { return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T))); }
+
+// Reads a length-prefixed array, refusing lengths that run past the end of the file.
+template <typename T>
+bool getArray(ifstream& in, vector<T>& v, uint64_t fileBytes) {
+    uint64_t n;
+    if (!get(in, n) || n > fileBytes / sizeof(T)) return false;
+    v.resize(static_cast<size_t>(n));
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(v.data()), static_cast<streamsize>(n * sizeof(T))));
+}
+
+// Checks a loaded chunk: column offsets in order and inside words, every stream at least as long
+// as its samples need (a 64 bit first value, then one bit per sample), and every stream decoding
+// within its own bits to timestamps that end at endSec.
+bool chunkDecodes(int startSec, int endSec, uint32_t samples, const vector<uint64_t>& timeWords,
+                  const vector<uint64_t>& words, const vector<uint32_t>& columnStart) {
+    if (samples == 0 || startSec > endSec) return false;
+    const uint64_t minTimeBits = samples - 1, minColumnBits = 64 + minTimeBits;
+    if (timeWords.size() * 64 < minTimeBits) return false;
+    for (size_t k = 0; k + 1 < columnStart.size(); ++k) {
+        if (columnStart[k] > columnStart[k + 1] || columnStart[k + 1] > words.size()) return false;
+        if (static_cast<uint64_t>(columnStart[k + 1] - columnStart[k]) * 64 < minColumnBits) return false;
+    }
+
+    CheckedBitReader time{BitReader{timeWords.data()}, timeWords.size() * 64};
+    long long t = startSec, delta = 0;
+    for (uint32_t i = 1; i < samples && time.ok; ++i) {
+        delta += readTimeDelta(time);
+        t += delta;
+        // queries accumulate in int
+        if (delta < INT_MIN || delta > INT_MAX || t < INT_MIN || t > INT_MAX) return false;
+    }
+    if (!time.ok || t != endSec) return false;
+
+    for (size_t k = 0; k + 1 < columnStart.size(); ++k) {
+        size_t bits = static_cast<size_t>(columnStart[k + 1] - columnStart[k]) * 64;
+        XorReader<CheckedBitReader> value{CheckedBitReader{BitReader{words.data() + columnStart[k]}, bits}};
+        for (uint32_t i = 0; i < samples && value.in.ok; ++i) value.next();
+        if (!value.in.ok || !value.valid) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool TimeSeriesRecorder::save(const string& path) {
+    seal();
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Cannot write " << path << "\n";
+        return false;
+    }
+    vector<const SeriesLayout*> layouts;
+    vector<uint64_t> layoutOf;
+    for (const Chunk& c : chunks) {
+        if (layouts.empty() || layouts.back() != c.layout.get()) layouts.push_back(c.layout.get());
+        layoutOf.push_back(layouts.size() - 1);
+    }
+
+    out.write(SERIES_MAGIC, 8);
+    put<uint32_t>(out, SERIES_VERSION);
+    put<uint32_t>(out, static_cast<uint32_t>(chunkSamples));
+    put<uint64_t>(out, layouts.size());
+    put<uint64_t>(out, chunks.size());
+    for (const SeriesLayout* l : layouts) {
+        put<uint64_t>(out, l->nodeIds.size());
+        put<uint64_t>(out, l->edgeKeys.size());
+        out.write(reinterpret_cast<const char*>(l->nodeIds.data()), static_cast<streamsize>(l->nodeIds.size() * sizeof(int)));
+        out.write(reinterpret_cast<const char*>(l->edgeKeys.data()), static_cast<streamsize>(l->edgeKeys.size() * sizeof(long long)));
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const Chunk& c = chunks[i];
+        put<uint64_t>(out, layoutOf[i]);
+        put<int32_t>(out, c.startSec);
+        put<int32_t>(out, c.endSec);
+        put<uint32_t>(out, c.samples);
+        put<uint32_t>(out, 0);
+        putArray(out, c.timeWords);
+        put<uint64_t>(out, c.columnStart.size() - 1);
+        out.write(reinterpret_cast<const char*>(c.columnStart.data()), static_cast<streamsize>(c.columnStart.size() * sizeof(uint32_t)));
+        putArray(out, c.words);
+    }
+    out.flush();
+    if (!out) {
+        cerr << "Error writing " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool TimeSeriesRecorder::load(const string& path) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) {
+        cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    const uint64_t fileBytes = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    char magic[8];
+    uint32_t version = 0, samples = 0;
+    uint64_t layoutCount = 0, chunkCount = 0;
+    if (!in.read(magic, 8) || memcmp(magic, SERIES_MAGIC, 8) != 0 || !get(in, version) || version != SERIES_VERSION ||
+        !get(in, samples) || !get(in, layoutCount) || !get(in, chunkCount)) {
+        cerr << path << ": not a time-series file\n";
+        return false;
+    }
+
+    vector<shared_ptr<const SeriesLayout>> layouts;
+    vector<Chunk> loaded;
+    bool ok = layoutCount <= fileBytes && chunkCount <= fileBytes;
+    for (uint64_t i = 0; ok && i < layoutCount; ++i) {
+        auto l = make_shared<SeriesLayout>();
+        uint64_t nodeCount = 0, edgeCount = 0;
+        ok = get(in, nodeCount) && get(in, edgeCount) && nodeCount <= fileBytes / sizeof(int) &&
+             edgeCount <= fileBytes / sizeof(long long);
+        if (!ok) break;
+        l->nodeIds.resize(static_cast<size_t>(nodeCount));
+        l->edgeKeys.resize(static_cast<size_t>(edgeCount));
+        ok = in.read(reinterpret_cast<char*>(l->nodeIds.data()), static_cast<streamsize>(nodeCount * sizeof(int))) &&
+             in.read(reinterpret_cast<char*>(l->edgeKeys.data()), static_cast<streamsize>(edgeCount * sizeof(long long)));
+        int maxId = -1;
+        for (int id : l->nodeIds) {
+            if (id < 0 || id > MAX_NODE_ID) ok = false;
+            maxId = max(maxId, id);
+        }
+        if (!ok) break;
+        l->columnByNodeId.assign(static_cast<size_t>(maxId + 1), -1);
+        for (size_t k = 0; k < l->nodeIds.size(); ++k) l->columnByNodeId[l->nodeIds[k]] = static_cast<int>(k);
+        for (size_t k = 0; k < l->edgeKeys.size(); ++k) l->columnByEdge[l->edgeKeys[k]] = static_cast<int>(nodeCount + k);
+        layouts.push_back(l);
+    }
+    for (uint64_t i = 0; ok && i < chunkCount; ++i) {
+        Chunk c;
+        uint64_t layout = 0, columns = 0;
+        uint32_t pad = 0;
+        ok = get(in, layout) && layout < layouts.size() && get(in, c.startSec) && get(in, c.endSec) &&
+             get(in, c.samples) && get(in, pad) && getArray(in, c.timeWords, fileBytes) &&
+             get(in, columns) && columns == layouts[layout]->columns();
+        if (!ok) break;
+        c.layout = layouts[layout];
+        c.columnStart.resize(static_cast<size_t>(columns + 1));
+        ok = in.read(reinterpret_cast<char*>(c.columnStart.data()), static_cast<streamsize>((columns + 1) * sizeof(uint32_t))) &&
+             getArray(in, c.words, fileBytes) &&
+             chunkDecodes(c.startSec, c.endSec, c.samples, c.timeWords, c.words, c.columnStart) &&
+             (loaded.empty() || loaded.back().endSec <= c.startSec); // queries rely on time order
+        loaded.push_back(move(c));
+    }
+    if (!ok) {
+        cerr << path << ": truncated or corrupt time-series file\n";
+        return false;
+    }
+
+    clear();
+    chunkSamples = samples ? samples : DEFAULT_CHUNK_SAMPLES;
+    chunks = move(loaded);
+    for (const Chunk& c : chunks) values += static_cast<unsigned long long>(c.samples) * c.layout->columns();
+    return true;
+}
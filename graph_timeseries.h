@@ -0,0 +1,119 @@
+#ifndef GRAPH_TIMESERIES_H
+#define GRAPH_TIMESERIES_H
+
+#include "graph_types.h"
+#include "graph_observer.h"
+#include <memory>
+#include <unordered_map>
+
+class Graph;
+
+// One point of a recorded series.
+struct SeriesSample {
+    int timeSec;
+    double value;
+};
+
+// Series present in a run of chunks: one level column per node and one flow column per pipe.
+// Chunks share a layout until the network changes shape.
+struct SeriesLayout {
+    vector<int> nodeIds;                        // level columns, in node slot order
+    vector<long long> edgeKeys;                 // flow columns, in edge index order (Graph::edgeKey)
+    vector<int> columnByNodeId;                 // node id -> level column, -1 if absent
+    unordered_map<long long, int> columnByEdge; // edge key -> flow column (offset by nodeIds.size())
+
+    size_t columns() const { return nodeIds.size() + edgeKeys.size(); }
+};
+
+// Append-only bit buffer, least significant bit first.
+struct BitStream {
+    vector<uint64_t> words;
+    size_t bits = 0;
+
+    void write(uint64_t value, int n);
+    void clear() { words.clear(); bits = 0; }
+};
+
+// Samples every node level and every pipe flow (Graph::edgeFlow) at the end of each step into
+// columnar chunks of chunkSamples time points. Timestamps are stored delta-of-delta and values
+// XOR-against-previous with the leading/trailing zero window of Gorilla (Pelkonen et al., 2015):
+// a level that did not change costs one bit, a pipe that carried nothing one bit. Each column is
+// compressed on its own, so a range query decodes only the time column and the one series it asks
+// for, and only in the chunks that overlap the window.
+//
+// Attach it with Graph::addObserver and set Graph::recordEdgeFlows so pipe flows are tracked; the
+// recorder can also be fed from elsewhere (e.g. the event-driven engine) by calling sample().
+class TimeSeriesRecorder : public SimulationObserver {
+public:
+    static const size_t DEFAULT_CHUNK_SAMPLES = 120; // one hour of 30-second steps
+
+    explicit TimeSeriesRecorder(size_t chunkSamples = DEFAULT_CHUNK_SAMPLES);
+
+    void onStepEnd(const Graph& g) override { sample(g); }
+
+    // Appends one time point (g.simTimeSec) of every series. Starts a new chunk when the open one
+    // is full or the network gained or lost nodes or pipes. Times must not go backwards.
+    void sample(const Graph& g);
+    // closes the open chunk so it is compacted; sample() opens a new one
+    void seal();
+    void clear();
+
+    // Samples of one node's level / one pipe's flow with fromSec <= time <= toSec, appended to out
+    // in time order. Returns how many were appended.
+    size_t levels(int nodeId, int fromSec, int toSec, vector<SeriesSample>& out) const;
+    size_t flows(int from, int to, int fromSec, int toSec, vector<SeriesSample>& out) const;
+
+    size_t chunkCount() const { return chunks.size() + (open.samples > 0 ? 1 : 0); }
+    unsigned long long valuesRecorded() const { return values; }
+    size_t compressedBytes() const;                               // time and value columns
+    size_t rawBytes() const { return static_cast<size_t>(values) * (sizeof(int) + sizeof(double)); }
+
+    // Binary file of every chunk (the open one is sealed first). load replaces the recorder's contents.
+    bool save(const string& path);
+    bool load(const string& path);
+
+private:
+    struct XorState {
+        uint64_t prev = 0;
+        int leading = -1; // -1 until a window has been written
+        int trailing = 0;
+    };
+
+    // A sealed chunk: its columns are packed back to back, each starting on a word boundary.
+    struct Chunk {
+        int startSec = 0;
+        int endSec = 0;
+        uint32_t samples = 0;
+        shared_ptr<const SeriesLayout> layout;
+        vector<uint64_t> timeWords;
+        vector<uint64_t> words;
+        vector<uint32_t> columnStart; // word offset of each column, plus the end
+    };
+
+    // The chunk being written, one bit stream per column.
+    struct OpenChunk {
+        int startSec = 0;
+        int endSec = 0;
+        uint32_t samples = 0;
+        int prevDelta = 0;
+        shared_ptr<const SeriesLayout> layout;
+        BitStream time;
+        vector<BitStream> columns;
+        vector<XorState> xors;
+    };
+
+    // column(layout) gives the series' column in a chunk, or -1 when the chunk does not have it
+    template <typename ColumnOf>
+    size_t query(ColumnOf column, int fromSec, int toSec, vector<SeriesSample>& out) const;
+    bool sameShape(const Graph& g, const SeriesLayout& layout) const;
+    void startChunk(const Graph& g, int timeSec);
+    void appendValue(size_t column, double value);
+
+    size_t chunkSamples;
+    vector<Chunk> chunks; // in time order
+    OpenChunk open;
+    unsigned topologySeen = 0;
+    unsigned long long values = 0;
+};
+
+#endif // GRAPH_TIMESERIES_H
@@ -0,0 +1,61 @@
+#include "graph.h"
+
+// ---------------- CSR topology snapshot ----------------
+
+void Graph::invalidateTopology() {
+    // called by every structural edit, and by bulk changes that do not say which pipes they touched
+    csrValid = false;
+    ++topologyVersion;
+    ++structureVersion;
+    changedEdges.clear();
+}
+
+void Graph::invalidateEdge(int idx) {
+    // journals the pipe so incremental consumers (ZoneRouter) revisit only it; a journal longer
+    // than the pipe count is no cheaper to replay than a full rebuild, so it turns into one
+    csrValid = false;
+    ++topologyVersion;
+    changedEdges.push_back(idx);
+    if (changedEdges.size() > edges.size() + 64) {
+        ++structureVersion;
+        changedEdges.clear();
+    }
+}
+
+const CsrTopology& Graph::topology() const {
+    if (csrValid) return csr;
+
+    const int n = static_cast<int>(nodes.size());
+    const int m = static_cast<int>(edges.size());
+    csr.offsets.assign(n + 1, 0);
+    csr.edgeToSlot.assign(m, -1);
+    csr.edgeCapacity.resize(m);
+    csr.edgeFlowRate.resize(m);
+
+    // counting pass: pipe i lands in its source slot's bucket if it is usable
+    vector<int> fromSlot(m, -1);
+    for (int i = 0; i < m; ++i) {
+        const Edge& e = edges[i];
+        csr.edgeToSlot[i] = getNodeSlot(e.to);
+        csr.edgeCapacity[i] = e.capacity;
+        csr.edgeFlowRate[i] = e.flowRate;
+        if (!e.active || e.valveStatus == 0 || csr.edgeToSlot[i] == -1) continue;
+        fromSlot[i] = getNodeSlot(e.from);
+        if (fromSlot[i] != -1) ++csr.offsets[fromSlot[i] + 1];
+    }
+    for (int s = 0; s < n; ++s) csr.offsets[s + 1] += csr.offsets[s];
+
+    // fill pass in edge order, so each bucket is sorted by edge index like Node::outgoingEdges
+    csr.targets.resize(csr.offsets[n]);
+    csr.edgeIds.resize(csr.offsets[n]);
+    vector<int> cursor(csr.offsets.begin(), csr.offsets.end() - 1);
+    for (int i = 0; i < m; ++i) {
+        if (fromSlot[i] == -1) continue;
+        int pos = cursor[fromSlot[i]]++;
+        csr.targets[pos] = csr.edgeToSlot[i];
+        csr.edgeIds[pos] = i;
+    }
+
+    csrValid = true;
+    return csr;
+}
@@ -1,54 +1,328 @@
-#ifndef GRAPH_TYPES_H
-#define GRAPH_TYPES_H
-
-#include <string>
-#include <vector>
-#include <sstream>
-#include <iomanip>
-
-using namespace std;
-
-// Enum to define the type of a node
-enum class NodeType {
-    Tank,
-    Industry
-};
-
-// Represents a node in the graph (e.g., a tank or an industrial facility)
-struct Node {
-    int id;
-    NodeType type;
-    string name;
-    double storageCapacity;
-    double currentLevel;
-    int valveStatus;
-    vector<int> outgoingEdges; // Indices into the main Graph::edges vector
-
-    Node(int id = -1, NodeType type = NodeType::Tank, const string& name = "",
-         double storageCapacity = 0, double currentLevel = 0, int valveStatus = 0)
-        : id(id), type(type), name(name),
-          storageCapacity(storageCapacity), currentLevel(currentLevel), valveStatus(valveStatus) {}
-};
-
-// Represents a directed edge in the graph (e.g., a pipe)
-struct Edge {
-    int from;
-    int to;
-    double capacity;
-    double flowRate;
-    bool active;
-    int valveStatus;
-
-    Edge(int from = -1, int to = -1, double capacity = 0, double flowRate = 0, bool active = true, int valveStatus = 1)
-        : from(from), to(to), capacity(capacity), flowRate(flowRate), active(active), valveStatus(valveStatus) {}
-};
-
-// Represents a single log entry for simulation history
-struct LogEntry {
-    int simTimeSec;
-    string message;
-
-    string toString() const;
-};
-
+#ifndef GRAPH_TYPES_H
+#define GRAPH_TYPES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+
+using namespace std;
+
+// Enum to define the type of a node
+enum class NodeType {
+    Tank,
+    Industry
+};
+
+// How simulateStep distributes water to tanks below the prescribed level
+enum class AllocationMode {
+    GreedyPath, // up to MAX_TANKS_PER_STEP tanks, one BFS path each, in priority order
+    MaxFlow,    // one multi-sink max-flow to every queued tank
+    Batched     // every queued tank, one path each, applied in parallel conflict-free batches
+};
+
+// How simulateStep finds the path to each tank in GreedyPath mode
+enum class RoutingMode {
+    Tree,   // one cached BFS tree over the whole network per source
+    Widest, // cached maximum-bottleneck tree per source (widest min(capacity, flowRate) path)
+    Zoned   // ZoneRouter: per-zone trees joined by a boundary overlay, refreshed per touched zone
+};
+
+// Represents a node in the graph (e.g., a tank or an industrial facility).
+// Its storage capacity and current level live in Graph::state, at the same slot as the node.
+struct Node {
+    int id;
+    NodeType type;
+    string name;
+    int valveStatus;
+    vector<int> outgoingEdges; // Indices into the main Graph::edges vector
+
+    Node(int id = -1, NodeType type = NodeType::Tank, const string& name = "", int valveStatus = 0)
+        : id(id), type(type), name(name), valveStatus(valveStatus) {}
+};
+
+// Largest accepted node id. Ids index a dense table (Graph::nodeSlotById), so the bound keeps one
+// stray id from sizing that table in gigabytes: at this limit it takes 256 MB.
+const int MAX_NODE_ID = (1 << 26) - 1;
+
+// Headroom below this fraction of a tank's capacity counts as full. Without it a rounding residue left
+// by an earlier fill reads as a delivery of 1e-14 units that arrives as 0, i.e. a false leak alarm.
+const double FULL_TOLERANCE = 1e-9;
+
+// Hot per-node simulation state, stored column-wise and indexed by node slot (parallel to Graph::nodes)
+// so the per-step kernels stream over contiguous doubles instead of whole Node records.
+struct NodeState {
+    vector<double> level;         // current water level
+    vector<double> capacity;      // storage capacity
+    vector<unsigned char> isTank; // 1 for NodeType::Tank, mirrors Node::type
+
+    size_t size() const { return level.size(); }
+    void push(double cap, bool tank) {
+        level.push_back(0.0);
+        capacity.push_back(cap);
+        isTank.push_back(tank ? 1 : 0);
+    }
+    void moveSlot(size_t from, size_t to) {
+        level[to] = level[from];
+        capacity[to] = capacity[from];
+        isTank[to] = isTank[from];
+    }
+    void pop() {
+        level.pop_back();
+        capacity.pop_back();
+        isTank.pop_back();
+    }
+};
+
+// Represents a directed edge in the graph (e.g., a pipe)
+struct Edge {
+    int from;
+    int to;
+    double capacity;
+    double flowRate;
+    bool active;
+    int valveStatus;
+    double lossFraction; // simulated leak: share of the water entering the pipe that never arrives (checkpointed, not in network files)
+
+    Edge(int from = -1, int to = -1, double capacity = 0, double flowRate = 0, bool active = true, int valveStatus = 1)
+        : from(from), to(to), capacity(capacity), flowRate(flowRate), active(active), valveStatus(valveStatus),
+          lossFraction(0.0) {}
+};
+
+// Immutable compressed-sparse-row snapshot of the usable pipe network (active pipes with an open valve).
+// Nodes are addressed by slot (index into Graph::nodes). Built on demand by Graph::topology() and
+// discarded by any topology edit, so traversals never see stale data.
+struct CsrTopology {
+    vector<int> offsets;        // pipes leaving slot s are [offsets[s], offsets[s+1])
+    vector<int> targets;        // target slot of each pipe, in CSR order
+    vector<int> edgeIds;        // index into Graph::edges of each pipe, in CSR order
+
+    // per-edge attributes, indexed by Graph::edges index
+    vector<int> edgeToSlot;
+    vector<double> edgeCapacity;
+    vector<double> edgeFlowRate;
+
+    int nodeCount() const { return static_cast<int>(offsets.size()) - 1; }
+};
+
+// Reusable scratch space for path queries. Arrays are indexed by node slot (or edge index for the
+// banned set) and are reset by bumping epoch instead of clearing, so steady-state queries allocate nothing.
+struct PathWorkspace {
+    unsigned epoch = 0;
+    vector<unsigned> visitedStamp; // slot visited in the current query iff visitedStamp[slot] == epoch
+    vector<int> parentEdge;        // valid only for visited slots
+    vector<int> queue;             // BFS queue; every slot is enqueued at most once, so nodeCount entries suffice
+    vector<unsigned> bannedStamp;  // edge banned in the current query iff bannedStamp[edge] == epoch
+
+    void begin(int nodeCount, int edgeCount) {
+        if (static_cast<int>(visitedStamp.size()) < nodeCount) {
+            visitedStamp.resize(nodeCount, 0);
+            parentEdge.resize(nodeCount, -1);
+            queue.resize(nodeCount);
+        }
+        if (static_cast<int>(bannedStamp.size()) < edgeCount) bannedStamp.resize(edgeCount, 0);
+        if (++epoch == 0) { // stamps wrapped around: wipe them once and start over
+            fill(visitedStamp.begin(), visitedStamp.end(), 0u);
+            fill(bannedStamp.begin(), bannedStamp.end(), 0u);
+            epoch = 1;
+        }
+    }
+    bool visited(int slot) const { return visitedStamp[slot] == epoch; }
+    void visit(int slot, int viaEdge) { visitedStamp[slot] = epoch; parentEdge[slot] = viaEdge; }
+    void ban(int edge) { bannedStamp[edge] = epoch; }
+    bool banned(int edge) const { return bannedStamp[edge] == epoch; }
+};
+
+// Shortest-path (fewest pipes) tree from one source over the CSR snapshot.
+// Built once per source by Graph::routeTree() and reused until the topology changes.
+struct RouteTree {
+    int sourceSlot = -1;
+    unsigned topologyVersion = 0;
+    vector<int> parentEdge; // per slot: edge index used to reach it, -1 for the source and unreachable slots
+};
+
+// Scratch for Graph::widestTree: pipe rates ranked among the distinct usable rates (so the search
+// can use a bucket queue indexed by rank), recomputed once per topology version.
+struct WidestScratch {
+    unsigned topologyVersion = 0;
+    bool ranked = false;
+    vector<int> edgeRank;          // per edge index; rank of min(capacity, flowRate)
+    int rankCount = 0;
+    vector<int> bestRank;          // per slot during a search: widest bottleneck found so far, -1 none
+    vector<vector<int>> buckets;   // slots waiting at each rank
+};
+
+// A tank queued for refilling, as ranked by simulateStep (highest priority first).
+struct RefillRequest {
+    int nodeId;
+    double level;
+    double capacity;
+    double priority;
+};
+
+// Summary of one Graph::supplyWaterBatched call.
+struct RefillStats {
+    size_t tanks = 0;       // requests received
+    size_t routed = 0;      // requests with a path from the source
+    size_t deferred = 0;    // routed, but every constrained pipe on the path was used up
+    size_t batches = 0;     // conflict-free batches applied
+    double delivered = 0.0; // volume added to the tanks
+};
+
+// Scratch for Graph::supplyWaterBatched, kept between steps so refills allocate nothing once warm.
+// Per-edge arrays are indexed by Graph::edges index; only the edges in touchedEdges are non-default.
+struct RefillScratch {
+    struct Outcome {
+        double expected, actual, before, after;
+        bool supplied; // the tank took water (or would have, at a zero rate) as in supplyWaterAlongPath
+        bool deferred; // its constrained pipes were used up by earlier requests
+    };
+
+    vector<vector<int>> paths;     // per request
+    vector<double> pathRate;       // per request: pathSupplyRate of its path, 0 if unrouted
+    vector<int> batchOf;           // per request: batch index, -1 if unrouted
+    vector<int> order;             // requests grouped by batch, priority order within a batch
+    vector<int> batchStart;        // batch b is order[batchStart[b], batchStart[b+1])
+    vector<Outcome> outcome;       // per request
+    vector<double> edgeDemand;     // summed path rates crossing the pipe this step, 0 if unused
+    vector<double> edgeResidual;   // rate left on a constrained pipe, -1 on unconstrained pipes
+    vector<int> edgeBatch;         // last batch that crossed the constrained pipe, -1 none
+    vector<int> touchedEdges;
+};
+
+// Throughput figures reported by Graph::runBatch
+struct BatchStats {
+    long long steps = 0;
+    double wallSeconds = 0.0;
+    double simulatedSeconds = 0.0;
+    double stepsPerSecond = 0.0;
+    double simSecondsPerWallSecond = 0.0;
+};
+
+// Scenario for Graph::runEnsemble: `runs` independent copies of the current state, each
+// simulated for `steps` steps with its own seed derived from (baseSeed, run index)
+struct EnsembleConfig {
+    size_t runs = 1000;
+    long long steps = 100;
+    int intervalSec = 30;
+    int sourceId = 0;
+    double maxReductionPerHour = 10000.0;
+    double prescribedLevel = 200.0;
+    double emptyLevel = 0.0;   // a tank at or below this level counts as empty
+    uint64_t baseSeed = 1;
+};
+
+// Per-tank outcome over all runs of an ensemble
+struct TankEnsembleStats {
+    int tankId = -1;
+    size_t runsBelowPrescribed = 0;       // runs in which the tank dropped below prescribedLevel
+    double probabilityBelowPrescribed = 0.0;
+    size_t runsEmptied = 0;
+    double meanTimeToEmptySec = -1.0;     // over the runs that emptied it; -1 if none did
+    unsigned long long leakAlerts = 0;    // leak suspicions raised while refilling this tank
+    double leakAlertsPerRun = 0.0;
+};
+
+struct EnsembleResult {
+    size_t runs = 0;
+    double wallSeconds = 0.0;
+    double runsPerSecond = 0.0;
+    size_t steals = 0;                    // work-stealing events in the scheduler
+    vector<TankEnsembleStats> tanks;      // every tank except the source, in node order
+};
+
+// Edits that can be queued in an EditBatch
+enum class EditKind : unsigned char {
+    NodeCapacity, // a=node id, value=capacity
+    NodeValve,    // a=node id, value=valve status
+    EdgeActive,   // a=from, b=to, value=0/1
+    EdgeValve,    // a=from, b=to, value=valve status
+    EdgeCapacity, // a=from, b=to, value=capacity
+    EdgeFlowRate, // a=from, b=to, value=flowRate
+    EdgeLoss      // a=from, b=to, value=simulated loss fraction; 0 marks the pipe repaired and also
+                  // clears what the leak detector learned about it
+};
+
+struct GraphEdit {
+    EditKind kind;
+    int a;
+    int b;
+    double value;
+};
+
+// Node and pipe edits collected for Graph::applyEdits, which checks all of them before changing
+// anything and then applies them in one pass with a single log record.
+struct EditBatch {
+    vector<GraphEdit> edits;
+
+    void setNodeCapacity(int id, double capacity) { edits.push_back({EditKind::NodeCapacity, id, -1, capacity}); }
+    void setNodeValve(int id, int valveStatus) { edits.push_back({EditKind::NodeValve, id, -1, static_cast<double>(valveStatus)}); }
+    void setEdgeActive(int from, int to, bool active) { edits.push_back({EditKind::EdgeActive, from, to, active ? 1.0 : 0.0}); }
+    void setEdgeValve(int from, int to, int valveStatus) { edits.push_back({EditKind::EdgeValve, from, to, static_cast<double>(valveStatus)}); }
+    void setEdgeCapacity(int from, int to, double capacity) { edits.push_back({EditKind::EdgeCapacity, from, to, capacity}); }
+    void setEdgeFlowRate(int from, int to, double flowRate) { edits.push_back({EditKind::EdgeFlowRate, from, to, flowRate}); }
+    void setEdgeLoss(int from, int to, double lossFraction) { edits.push_back({EditKind::EdgeLoss, from, to, lossFraction}); }
+    size_t size() const { return edits.size(); }
+    bool empty() const { return edits.empty(); }
+    void clear() { edits.clear(); }
+};
+
+// Outcome of Graph::importCsv: counts of what was imported and skipped, plus the first
+// error messages ("file:line: reason"); further messages are only counted.
+struct ImportReport {
+    size_t nodesImported = 0;
+    size_t edgesImported = 0;
+    size_t malformedRows = 0;
+    size_t duplicateNodes = 0;
+    size_t duplicateEdges = 0;
+    size_t danglingEdges = 0;
+    size_t suppressedErrors = 0;
+    vector<string> errors;
+
+    bool ok() const { return errors.empty(); }
+    void addError(const string& message);
+};
+
+// Kind of a history record. Graph::formatLog turns each kind back into its text line;
+// the comment lists how the LogEntry fields are used.
+enum class LogKind : unsigned char {
+    Message,          // free text, stored beside the record in EventLog
+    Consumption,      // nodeId, aux=1 for tanks, value = {reduction, before, after}
+    BelowPrescribed,  // nodeId, value = {level, prescribedLevel, priority}
+    Supply,           // nodeId=target, aux=source, aux2=pipes on path, value = {expected, actual, before, after}
+    MaxFlowSupply,    // nodeId, value = {rate, actual, before, after}
+    NoPath,           // nodeId=tank, aux=source
+    LeakSuspected,    // nodeId=tank, value = {expected, actual}
+    AlternateLeaking, // nodeId=tank
+    AlternateOk,      // nodeId=tank
+    NoAlternate,      // nodeId=tank
+    QueueCarryOver,   // aux=tanks processed, aux2=tanks left in queue
+    NodeRemoved,      // nodeId
+    NodeCapacitySet,  // nodeId, value = {capacity}
+    NodeTypeChanged,  // nodeId
+    NodeValveSet,     // nodeId, aux=valve status
+    EdgeRemoved,      // nodeId=from, aux=to
+    EdgeActivated,    // nodeId=from, aux=to
+    EdgeDeactivated,  // nodeId=from, aux=to
+    EdgeActiveSet,    // nodeId=from, aux=to, aux2=active
+    EdgeCapacitySet,  // nodeId=from, aux=to, value = {capacity}
+    EdgeFlowRateSet,  // nodeId=from, aux=to, value = {flowRate}
+    EdgeValveSet,     // nodeId=from, aux=to, aux2=valve status
+    EditBatch,        // aux=edits applied, aux2=edits that changed routing, value = {node edits, pipe edits}
+    PipeFlagged       // nodeId=from, aux=to, value = {confidence, estimated loss fraction}
+};
+
+// Represents a single log entry for simulation history: a fixed-size binary record that is
+// only rendered to text when printed or exported
+struct LogEntry {
+    LogKind kind;
+    int simTimeSec;
+    int nodeId;
+    int aux;
+    int aux2;
+    double value[4];
+};
+
 #endif // GRAPH_TYPES_H
\ No newline at end of file
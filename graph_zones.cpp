@@ -0,0 +1,351 @@
+#include <limits>
+#include <queue>
+#include "graph.h"
+
+// ---------------- zone-partitioned routing ----------------
+
+void ZoneRouter::setTargetZoneSize(int nodesPerZone) {
+    targetZoneSize = max(1, nodesPerZone);
+    built = false;
+}
+
+void ZoneRouter::setZones(const vector<int>& zoneOfSlot) {
+    explicitZones = zoneOfSlot;
+    built = false;
+}
+
+ZoneRouter::EdgeSignature ZoneRouter::signature(const Graph& g, int edgeIdx) const {
+    const Edge& e = g.edges[edgeIdx];
+    EdgeSignature sig;
+    sig.from = e.from;
+    sig.to = e.to;
+    sig.fromSlot = g.getNodeSlot(e.from);
+    sig.toSlot = g.getNodeSlot(e.to);
+    sig.rate = min(e.capacity, e.flowRate);
+    sig.open = e.active && e.valveStatus != 0;
+    sig.usable = sig.open && sig.fromSlot != -1 && sig.toSlot != -1;
+    return sig;
+}
+
+// Assigns every slot a zone: the explicit map if one was given for this many nodes, otherwise
+// BFS-grown regions of targetZoneSize nodes over the undirected pipe graph (inactive pipes
+// included, so zones stay put when valves move).
+void ZoneRouter::partition(const Graph& g) {
+    const int n = static_cast<int>(g.state.size());
+    const int m = static_cast<int>(g.edges.size());
+    zoneOf.assign(n, -1);
+    int zoneTotal = 0;
+
+    if (static_cast<int>(explicitZones.size()) == n) {
+        // compact arbitrary district ids to 0..k-1 in order of first appearance
+        unordered_map<int, int> compact;
+        for (int s = 0; s < n; ++s) {
+            auto it = compact.emplace(explicitZones[s], zoneTotal).first;
+            if (it->second == zoneTotal) ++zoneTotal;
+            zoneOf[s] = it->second;
+        }
+    } else {
+        vector<int> adjStart(n + 1, 0), adj(2 * static_cast<size_t>(m));
+        for (int i = 0; i < m; ++i) {
+            int a = g.getNodeSlot(g.edges[i].from), b = g.getNodeSlot(g.edges[i].to);
+            if (a == -1 || b == -1) continue;
+            ++adjStart[a + 1];
+            ++adjStart[b + 1];
+        }
+        for (int s = 0; s < n; ++s) adjStart[s + 1] += adjStart[s];
+        vector<int> cursor(adjStart.begin(), adjStart.end() - 1);
+        for (int i = 0; i < m; ++i) {
+            int a = g.getNodeSlot(g.edges[i].from), b = g.getNodeSlot(g.edges[i].to);
+            if (a == -1 || b == -1) continue;
+            adj[cursor[a]++] = b;
+            adj[cursor[b]++] = a;
+        }
+        vector<int> queue(n);
+        for (int seed = 0; seed < n; ++seed) {
+            if (zoneOf[seed] != -1) continue;
+            int z = zoneTotal++, size = 0, head = 0, tail = 0;
+            queue[tail++] = seed;
+            zoneOf[seed] = z;
+            while (head < tail && size < targetZoneSize) {
+                int cur = queue[head++];
+                ++size;
+                for (int p = adjStart[cur]; p < adjStart[cur + 1] && size + (tail - head) < targetZoneSize; ++p) {
+                    int nb = adj[p];
+                    if (zoneOf[nb] != -1) continue;
+                    zoneOf[nb] = z;
+                    queue[tail++] = nb;
+                }
+            }
+        }
+
+        // growing in slot order leaves small fragments behind; fold each one into a neighbouring
+        // zone so the overlay does not fill up with tiny zones
+        vector<int> mergedInto(zoneTotal), zoneSize(zoneTotal, 0);
+        for (int z = 0; z < zoneTotal; ++z) mergedInto[z] = z;
+        for (int s = 0; s < n; ++s) ++zoneSize[zoneOf[s]];
+        auto root = [&](int z) {
+            while (mergedInto[z] != z) z = mergedInto[z] = mergedInto[mergedInto[z]];
+            return z;
+        };
+        for (int s = 0; s < n; ++s) {
+            int z = root(zoneOf[s]);
+            if (zoneSize[z] * 4 >= targetZoneSize) continue;
+            for (int p = adjStart[s]; p < adjStart[s + 1]; ++p) {
+                int other = root(zoneOf[adj[p]]);
+                if (other == z) continue;
+                mergedInto[z] = other;
+                zoneSize[other] += zoneSize[z];
+                break;
+            }
+        }
+        vector<int> compactId(zoneTotal, -1);
+        int kept = 0;
+        for (int s = 0; s < n; ++s) {
+            int z = root(zoneOf[s]);
+            if (compactId[z] == -1) compactId[z] = kept++;
+            zoneOf[s] = compactId[z];
+        }
+        zoneTotal = kept;
+    }
+
+    // members and touching pipes per zone, counting-sorted so each list is in slot / edge order
+    zoneStart.assign(zoneTotal + 1, 0);
+    for (int s = 0; s < n; ++s) ++zoneStart[zoneOf[s] + 1];
+    for (int z = 0; z < zoneTotal; ++z) zoneStart[z + 1] += zoneStart[z];
+    members.resize(n);
+    localIndex.assign(n, -1);
+    vector<int> cursor(zoneStart.begin(), zoneStart.end() - 1);
+    for (int s = 0; s < n; ++s) {
+        int pos = cursor[zoneOf[s]]++;
+        members[pos] = s;
+        localIndex[s] = pos - zoneStart[zoneOf[s]];
+    }
+
+    edgeStart.assign(zoneTotal + 1, 0);
+    auto forEachZoneOfEdge = [&](int i, auto&& fn) {
+        int a = g.getNodeSlot(g.edges[i].from), b = g.getNodeSlot(g.edges[i].to);
+        if (a == -1 || b == -1) return;
+        fn(zoneOf[a]);
+        if (zoneOf[b] != zoneOf[a]) fn(zoneOf[b]);
+    };
+    for (int i = 0; i < m; ++i) forEachZoneOfEdge(i, [&](int z) { ++edgeStart[z + 1]; });
+    for (int z = 0; z < zoneTotal; ++z) edgeStart[z + 1] += edgeStart[z];
+    zoneEdges.resize(edgeStart[zoneTotal]);
+    cursor.assign(edgeStart.begin(), edgeStart.end() - 1);
+    for (int i = 0; i < m; ++i) forEachZoneOfEdge(i, [&](int z) { zoneEdges[cursor[z]++] = i; });
+}
+
+void ZoneRouter::build(const Graph& g) {
+    const int n = static_cast<int>(g.state.size());
+    const int m = static_cast<int>(g.edges.size());
+    partition(g);
+    signatures.resize(m);
+    for (int i = 0; i < m; ++i) signatures[i] = signature(g, i);
+    zones.assign(zoneCount(), Zone());
+    entryIndex.assign(n, -1);
+    pinned.assign(n, 0);
+    for (int z = 0; z < static_cast<int>(zoneCount()); ++z) recomputeZone(z);
+    overlayDist.assign(n, -1);
+    overlayReached.clear();
+    overlayPrevSlot.assign(n, -1);
+    overlayPrevArc.assign(n, -1);
+    overlaySource = -1;
+    ++overlayVersion;
+    seenTopologyVersion = g.topologyVersion;
+    seenStructureVersion = g.structureVersion;
+    journalSeen = g.changedEdges.size();
+    built = true;
+}
+
+// Brings the zones up to date with the graph: a full build after structural changes (node slots
+// or edge indices may have moved even when the counts match), otherwise only the zones touched by
+// the journalled pipes whose signature changed.
+void ZoneRouter::refresh(const Graph& g) {
+    const size_t n = g.state.size(), m = g.edges.size();
+    if (!built || g.structureVersion != seenStructureVersion || zoneOf.size() != n || signatures.size() != m ||
+        g.changedEdges.size() < journalSeen) {
+        build(g);
+        return;
+    }
+    if (g.topologyVersion == seenTopologyVersion) return;
+    seenTopologyVersion = g.topologyVersion;
+
+    vector<int> dirty;
+    for (size_t j = journalSeen; j < g.changedEdges.size(); ++j) {
+        const int i = g.changedEdges[j];
+        if (signatures[i].sameAs(g.edges[i])) continue;
+        EdgeSignature sig = signature(g, i);
+        signatures[i] = sig;
+        for (int slot : {sig.fromSlot, sig.toSlot}) {
+            if (slot != -1) dirty.push_back(zoneOf[slot]);
+        }
+    }
+    journalSeen = g.changedEdges.size();
+    sort(dirty.begin(), dirty.end());
+    dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+    for (int z : dirty) recomputeZone(z);
+    if (!dirty.empty()) ++overlayVersion;
+}
+
+void ZoneRouter::recomputeZone(int z) {
+    Zone& zone = zones[z];
+    const int base = zoneStart[z];
+    const int size = zoneStart[z + 1] - base;
+    for (int s : zone.entries) entryIndex[s] = -1;
+    zone.entries.clear();
+
+    // entries: routing sources pinned in this zone, and targets of usable pipes from other zones
+    vector<unsigned char> isEntry(size, 0);
+    for (int l = 0; l < size; ++l) isEntry[l] = pinned[members[base + l]];
+    vector<int> localStart(size + 1, 0), exits;
+    for (int p = edgeStart[z]; p < edgeStart[z + 1]; ++p) {
+        const EdgeSignature& sig = signatures[zoneEdges[p]];
+        if (!sig.usable) continue;
+        bool fromIn = zoneOf[sig.fromSlot] == z, toIn = zoneOf[sig.toSlot] == z;
+        if (fromIn && toIn) ++localStart[localIndex[sig.fromSlot] + 1];
+        else if (toIn) isEntry[localIndex[sig.toSlot]] = 1;
+        else exits.push_back(zoneEdges[p]);
+    }
+    for (int l = 0; l < size; ++l) {
+        if (!isEntry[l]) continue;
+        entryIndex[members[base + l]] = static_cast<int>(zone.entries.size());
+        zone.entries.push_back(members[base + l]);
+    }
+
+    // local CSR over the zone's own usable pipes, in edge order like the global snapshot
+    for (int l = 0; l < size; ++l) localStart[l + 1] += localStart[l];
+    vector<int> localEdge(localStart[size]);
+    vector<int> cursor(localStart.begin(), localStart.end() - 1);
+    for (int p = edgeStart[z]; p < edgeStart[z + 1]; ++p) {
+        const EdgeSignature& sig = signatures[zoneEdges[p]];
+        if (sig.usable && zoneOf[sig.fromSlot] == z && zoneOf[sig.toSlot] == z) {
+            localEdge[cursor[localIndex[sig.fromSlot]]++] = zoneEdges[p];
+        }
+    }
+
+    const size_t entryCount = zone.entries.size();
+    zone.parentEdge.assign(entryCount * size, -1);
+    zone.depth.assign(entryCount * size, -1);
+    zone.width.assign(entryCount * size, 0.0);
+    zone.arcStart.assign(entryCount + 1, 0);
+    zone.arcs.clear();
+    vector<int> queue(size);
+    for (size_t k = 0; k < entryCount; ++k) {
+        int* parent = zone.parentEdge.data() + k * size;
+        int* depth = zone.depth.data() + k * size;
+        double* width = zone.width.data() + k * size;
+        int root = localIndex[zone.entries[k]];
+        int head = 0, tail = 0;
+        queue[tail++] = root;
+        depth[root] = 0;
+        width[root] = numeric_limits<double>::infinity();
+        while (head < tail) {
+            int cur = queue[head++];
+            for (int p = localStart[cur]; p < localStart[cur + 1]; ++p) {
+                const EdgeSignature& sig = signatures[localEdge[p]];
+                int nb = localIndex[sig.toSlot];
+                if (depth[nb] != -1) continue;
+                depth[nb] = depth[cur] + 1;
+                parent[nb] = localEdge[p];
+                width[nb] = min(width[cur], sig.rate);
+                queue[tail++] = nb;
+            }
+        }
+        for (int e : exits) {
+            const EdgeSignature& sig = signatures[e];
+            int x = localIndex[sig.fromSlot];
+            if (depth[x] == -1) continue;
+            zone.arcs.push_back(OverlayArc{sig.toSlot, e, depth[x] + 1, min(width[x], sig.rate)});
+        }
+        zone.arcStart[k + 1] = static_cast<int>(zone.arcs.size());
+    }
+    ++recomputed;
+}
+
+// Fewest-hop search over the overlay of entry nodes, from sourceSlot; reused until the source
+// or the overlay changes.
+void ZoneRouter::searchOverlay(int sourceSlot) {
+    if (overlaySource == sourceSlot && overlaySearchedVersion == overlayVersion) return;
+    for (int s : overlayReached) overlayDist[s] = -1; // only entries were ever set
+    overlayReached.clear();
+    overlaySource = sourceSlot;
+    overlaySearchedVersion = overlayVersion;
+
+    typedef pair<int, int> Item; // (hops, slot)
+    priority_queue<Item, vector<Item>, greater<Item>> heap;
+    overlayDist[sourceSlot] = 0;
+    overlayPrevSlot[sourceSlot] = -1;
+    overlayReached.push_back(sourceSlot);
+    heap.push({0, sourceSlot});
+    while (!heap.empty()) {
+        auto [d, u] = heap.top();
+        heap.pop();
+        if (d != overlayDist[u]) continue;
+        const Zone& zone = zones[zoneOf[u]];
+        int k = entryIndex[u];
+        for (int a = zone.arcStart[k]; a < zone.arcStart[k + 1]; ++a) {
+            const OverlayArc& arc = zone.arcs[a];
+            int nd = d + arc.hops;
+            if (overlayDist[arc.toSlot] == -1) overlayReached.push_back(arc.toSlot);
+            else if (overlayDist[arc.toSlot] <= nd) continue;
+            overlayDist[arc.toSlot] = nd;
+            overlayPrevSlot[arc.toSlot] = u;
+            overlayPrevArc[arc.toSlot] = a;
+            heap.push({nd, arc.toSlot});
+        }
+    }
+}
+
+// Appends the pipes from slot back up to the zone entry's tree root, nearest first.
+bool ZoneRouter::walkZone(int z, int k, int slot, vector<int>& reversedPath) const {
+    const Zone& zone = zones[z];
+    const size_t size = static_cast<size_t>(zoneStart[z + 1] - zoneStart[z]);
+    const int* parent = zone.parentEdge.data() + k * size;
+    if (zone.depth[k * size + localIndex[slot]] == -1) return false;
+    for (int e = parent[localIndex[slot]]; e != -1; e = parent[localIndex[slot]]) {
+        reversedPath.push_back(e);
+        slot = signatures[e].fromSlot;
+    }
+    return true;
+}
+
+bool ZoneRouter::findPath(const Graph& g, int sourceId, int targetId, vector<int>& path, double* bottleneck) {
+    refresh(g);
+    int s = g.getNodeSlot(sourceId), t = g.getNodeSlot(targetId);
+    if (s == -1 || t == -1) return false;
+    if (!pinned[s]) {
+        pinned[s] = 1;
+        recomputeZone(zoneOf[s]);
+        ++overlayVersion;
+    }
+    searchOverlay(s);
+
+    // finish inside the target's zone through whichever entry gives the fewest hops overall
+    const int zt = zoneOf[t];
+    const Zone& zone = zones[zt];
+    const size_t size = static_cast<size_t>(zoneStart[zt + 1] - zoneStart[zt]);
+    int bestK = -1, bestHops = numeric_limits<int>::max();
+    for (size_t k = 0; k < zone.entries.size(); ++k) {
+        int du = overlayDist[zone.entries[k]];
+        int dk = zone.depth[k * size + localIndex[t]];
+        if (du == -1 || dk == -1 || du + dk >= bestHops) continue;
+        bestHops = du + dk;
+        bestK = static_cast<int>(k);
+    }
+    if (bestK == -1) return false;
+
+    path.clear();
+    double narrowest = zone.width[bestK * size + localIndex[t]];
+    walkZone(zt, bestK, t, path);
+    for (int u = zone.entries[bestK]; u != s; u = overlayPrevSlot[u]) {
+        int from = overlayPrevSlot[u];
+        int z = zoneOf[from];
+        const OverlayArc& arc = zones[z].arcs[overlayPrevArc[u]];
+        narrowest = min(narrowest, arc.width);
+        path.push_back(arc.exitEdge);
+        walkZone(z, entryIndex[from], signatures[arc.exitEdge].fromSlot, path);
+    }
+    reverse(path.begin(), path.end());
+    if (bottleneck) *bottleneck = narrowest;
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef GRAPH_ZONES_H
+#define GRAPH_ZONES_H
+
+#include "graph_types.h"
+
+class Graph;
+
+// Zone-partitioned routing for large networks. Nodes are split into zones (grown by BFS up to a
+// target size, or given explicitly, e.g. pressure districts). Inside each zone a BFS tree is kept
+// per entry node (a node fed by a pipe from another zone, or a routing source); every
+// entry-to-exit connection becomes an overlay arc carrying its hop count and bottleneck rate.
+// A query runs a shortest-path search over the overlay only (cached per source) and finishes
+// in the target's zone, so it never walks the whole network.
+//
+// Structural edits (Graph::structureVersion) rebuild the router. Otherwise it replays the graph's
+// journal of changed pipes (Graph::changedEdges), compares each one's signature (usable flag,
+// min(capacity, flowRate)) with the previous refresh and recomputes only the zones it touches.
+class ZoneRouter {
+public:
+    void setTargetZoneSize(int nodesPerZone);
+    // zoneOfSlot[s] is the zone of node slot s; an empty vector returns to automatic zones
+    void setZones(const vector<int>& zoneOfSlot);
+
+    // Shortest (fewest pipes) usable path as edge indices, like Graph::findPath.
+    // bottleneck, if given, receives min(capacity, flowRate) over the path.
+    bool findPath(const Graph& g, int sourceId, int targetId, vector<int>& path, double* bottleneck = nullptr);
+
+    size_t zoneCount() const { return zoneStart.empty() ? 0 : zoneStart.size() - 1; }
+    unsigned long long zonesRecomputed() const { return recomputed; }
+
+private:
+    struct EdgeSignature {
+        int from, to;         // node ids
+        int fromSlot, toSlot;
+        double rate;
+        bool open;            // active with the valve not closed
+        bool usable;          // open and both ends exist
+        bool sameAs(const Edge& e) const {
+            return e.from == from && e.to == to && min(e.capacity, e.flowRate) == rate &&
+                   (e.active && e.valveStatus != 0) == open;
+        }
+    };
+    struct OverlayArc {
+        int toSlot;     // entry node in the next zone
+        int exitEdge;   // the cross-zone pipe
+        int hops;       // pipes from the entry to toSlot, exitEdge included
+        double width;   // bottleneck rate over those pipes
+    };
+    // Per zone: BFS trees from each entry over the zone's own usable pipes, stored entry-major
+    // over the zone's members, plus the overlay arcs leaving each entry.
+    struct Zone {
+        vector<int> entries;
+        vector<int> parentEdge;     // [entry * size + local] -> edge, -1 unreached / root
+        vector<int> depth;          // -1 unreached
+        vector<double> width;
+        vector<int> arcStart;       // arcs of entry k are [arcStart[k], arcStart[k+1])
+        vector<OverlayArc> arcs;
+    };
+
+    void refresh(const Graph& g);
+    void build(const Graph& g);
+    void partition(const Graph& g);
+    EdgeSignature signature(const Graph& g, int edgeIdx) const;
+    void recomputeZone(int z);
+    void searchOverlay(int sourceSlot);
+    bool walkZone(int z, int entryIndex, int slot, vector<int>& reversedPath) const;
+
+    int targetZoneSize = 1024;
+    vector<int> explicitZones;
+    bool built = false;
+    unsigned seenTopologyVersion = 0;
+    unsigned seenStructureVersion = 0;
+    size_t journalSeen = 0;           // entries of Graph::changedEdges already replayed
+    unsigned overlayVersion = 0;
+    unsigned long long recomputed = 0;
+
+    vector<int> zoneOf, localIndex;   // per node slot
+    vector<int> zoneStart, members;   // members of zone z are members[zoneStart[z] .. zoneStart[z+1])
+    vector<int> edgeStart, zoneEdges; // pipes touching zone z (either end), same layout
+    vector<EdgeSignature> signatures; // per edge, as of the last refresh
+    vector<Zone> zones;
+    vector<int> entryIndex;           // per slot: index in its zone's entries, -1 if not an entry
+    vector<unsigned char> pinned;     // per slot: kept as an entry because it is a routing source
+
+    // overlay search from the cached source
+    int overlaySource = -1;
+    unsigned overlaySearchedVersion = 0;
+    vector<int> overlayDist;          // hops from the source to an entry slot, -1 unreached
+    vector<int> overlayPrevSlot;      // entry the arc came from
+    vector<int> overlayPrevArc;       // arc index within that entry's zone
+    vector<int> overlayReached;       // slots with overlayDist set, reset before the next search
+};
+
+#endif // GRAPH_ZONES_H
@@ -1,209 +1,424 @@
-#include "graph.h"
-#include <iostream>
-#include <thread>
-
-using namespace std;
-
-int main() {
-
-    Graph waterSystem;
-    //Adding Tank nodes
-    waterSystem.addNode(0, "Reservoir", NodeType::Tank, 1e12);
-    waterSystem.addNode(1, "Tank 1", NodeType::Tank, 10000);
-    waterSystem.addNode(2, "Tank 2", NodeType::Tank, 1000);
-    waterSystem.addNode(3, "Tank 3", NodeType::Tank, 1000);
-    waterSystem.addNode(4, "Tank 4", NodeType::Tank, 500);
-    waterSystem.addNode(5, "Tank 5", NodeType::Tank, 1000);
-    //Adding Industry nodes
-    waterSystem.addNode(6, "Industry 1", NodeType::Industry, 100000);
-    waterSystem.addNode(7, "Industry 2", NodeType::Industry, 100000);
-    //Adding Edges between nodes (pipes)
-    waterSystem.addEdge(0, 1, 100, 70, true, 1);
-    waterSystem.addEdge(0, 2, 100, 70, true, 1);
-    waterSystem.addEdge(0, 3, 100, 70, true, 1);
-    waterSystem.addEdge(0, 4, 100, 70, true, 1);
-    waterSystem.addEdge(0, 5, 100, 70, true, 1);
-    waterSystem.addEdge(1, 3, 80, 60, true, 1);
-    waterSystem.addEdge(1, 5, 80, 60, true, 1);
-    waterSystem.addEdge(2, 4, 80, 50, true, 1);
-
-    // Setting Initial Levels of tanks
-    waterSystem.getNodeById(0)->currentLevel = 1e12;
-    waterSystem.getNodeById(1)->currentLevel = 10000;
-    waterSystem.getNodeById(2)->currentLevel = 500;
-    waterSystem.getNodeById(3)->currentLevel = 700;
-    waterSystem.getNodeById(4)->currentLevel = 10;
-    waterSystem.getNodeById(5)->currentLevel = 1000;
-    waterSystem.getNodeById(6)->currentLevel = 1e4;
-    waterSystem.getNodeById(7)->currentLevel = 1e5;
-
-    // Setting Initial Valve Status of tanks
-    waterSystem.editNodeValveStatus(0, 1);
-    waterSystem.editNodeValveStatus(1, 1);
-    waterSystem.editNodeValveStatus(2, 1);
-    waterSystem.editNodeValveStatus(3, 1);
-    waterSystem.editNodeValveStatus(4, 1);
-    waterSystem.editNodeValveStatus(5, 1);
-
-    // Simulation parameters
-    const int intervalSec = 30;                 //Simulate every 30 seconds
-    const int totalSteps = 20;                  //No of steps to simulate
-    const double maxReductionPerHour = 10000.0; //max reduction unit/hour
-    const double prescribedLevel = 200.0;       //desired level of water in all tanks
-
-    //Starting simulation
-    cout << "Starting Simulation" << endl;
-    cout << "(Prints every " << intervalSec << " seconds)" << endl;
-
-    for (int step = 0; step < totalSteps; ++step) {
-        cout << "\nSimulation Step: " << step + 1 << " Simulated Time: " << waterSystem.simTimeSec << " seconds" << endl;
-        cout << "----------------------------------------" << endl;
-        waterSystem.simulateStep(intervalSec, 0, maxReductionPerHour, prescribedLevel);
-        cout << "----------------------------------------" << endl;
-        cout << "Do you want to: \nEdit edge or node? enter e\nView logs? enter l\nClose simulation? enter c\n" << endl;
-
-        char choice; 
-        cin >> choice;
-        bool finish = false;
-
-        switch (choice) {
-            case 'e': {
-                cout << "Edit menu" << endl;
-                cout << "Node options:" << endl;
-                cout << "1. Edit node capacity\n2. Edit node valve status\n" << endl;
-                cout << "Edge options:" << endl;
-                cout << "3. Toggle edge active\n4. Set edge valve\n5. Edit edge capacity\n6. Edit edge flow rate" << endl;
-
-                int subChoice; 
-                cin >> subChoice;
-                switch (subChoice) {
-                    case 1: {
-                        int nodeId; cout << "Enter node id to edit capacity: "; cin >> nodeId;
-                        int newCapacity; cout << "Enter new capacity: "; cin >> newCapacity;
-                        if (!waterSystem.editNodeCapacity(nodeId, newCapacity)) 
-                            cout << "Node with id " << nodeId << " not found." << endl;
-                        else
-                            cout << "Node " << nodeId << " capacity set to " << newCapacity << endl;
-                        break;
-                    }
-                    case 2: {
-                        int nodeId; cout << "Enter node id to edit valve status: "; cin >> nodeId;
-                        int newValveStatus; cout << "Enter new valve status: "; cin >> newValveStatus;
-                        if (!waterSystem.editNodeValveStatus(nodeId, newValveStatus)) 
-                            cout << "Node with id " << nodeId << " not found." << endl;
-                        else
-                            cout << "Node " << nodeId << " valve status set to " << newValveStatus << endl;
-                        break;
-                    }
-                    case 3: {
-                        int from, to;
-                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
-                        cin >> from >> to;
-                        int idx = waterSystem.getEdgeIndex(from, to);
-                        if (idx == -1) {
-                            cout << "Edge from " << from << " to " << to << " not found." << endl;
-                            break;
-                        }
-                        waterSystem.editEdgeStatus(from, to, !waterSystem.edges[idx].active);
-                        cout << "Edge " << from << "->" << to << " active set to " << waterSystem.edges[idx].active << endl;
-                        break;
-                    }
-                    case 4: {
-                        int from, to;
-                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
-                        cin >> from >> to;
-                        int idx = waterSystem.getEdgeIndex(from, to);
-                        if (idx == -1) {
-                            cout << "Edge from " << from << " to " << to << " not found." << endl;
-                            break;
-                        }
-                        int val; cout << "Enter valve status: "; cin >> val;
-                        waterSystem.editEdgeValve(from, to, val);
-                        cout << "Edge " << from << "->" << to << " valve status set to " << waterSystem.edges[idx].valveStatus << endl;
-                        break;
-                    }
-                    case 5: {
-                        int from, to;
-                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
-                        cin >> from >> to;
-                        int idx = waterSystem.getEdgeIndex(from, to);
-                        if (idx == -1) {
-                            cout << "Edge from " << from << " to " << to << " not found." << endl;
-                            break;
-                        }
-                        double newCapacity; cout << "Enter new capacity: "; cin >> newCapacity;
-                        waterSystem.editEdgeCapacity(from, to, newCapacity);
-                        cout << "Edge " << from << "->" << to << " capacity set to " << newCapacity << endl;
-                        break;
-                    }
-                    case 6: {
-                        int from, to;
-                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
-                        cin >> from >> to;
-                        int idx = waterSystem.getEdgeIndex(from, to);
-                        if (idx == -1) {
-                            cout << "Edge from " << from << " to " << to << " not found." << endl;
-                            break;
-                        }
-                        double newFlowRate; cout << "Enter new flow rate: "; cin >> newFlowRate;
-                        waterSystem.editEdgeFlowRate(from, to, newFlowRate);
-                        cout << "Edge " << from << "->" << to << " flow rate set to " << newFlowRate << endl;
-                        break;
-                    }
-                    default:
-                        cout << "Invalid choice." << endl;
-                        break;
-                }
-                break;
-            }
-            case 'l': {
-                int k; 
-                cout << "Enter number of log entries to view: "; 
-                cin >> k;
-                waterSystem.printLastKLogs(k);
-                break;
-            }
-            case 'c':
-                finish = true;
-                break;
-            default:
-                cout << "Invalid choice." << endl;
-                break;
-        }
-
-        if (finish) break;
-
-        cout << "Has any previously detected leakage been fixed? Enter y/n: ";
-        char ch; cin >> ch;
-        if (ch == 'y') {
-            cout << "Enter edge to mark repaired (from to), or '-1 -1' to mark all edges active: ";
-            int from, to; cin >> from >> to;
-            if (from == -1 && to == -1) {
-                for (auto& e : waterSystem.edges) {
-                    e.active = true;
-                    e.valveStatus = 1;
-                }
-                waterSystem.pushLog("User marked all edges repaired/enabled.");
-            }
-            else{
-                int idx = waterSystem.getEdgeIndex(from, to);
-                if (idx >= 0) {
-                    waterSystem.edges[idx].active = true;
-                    waterSystem.edges[idx].valveStatus = 1;
-                    waterSystem.pushLog("User marked edge " + to_string(from) + "->" + to_string(to) + " repaired/enabled.");
-                    cout << "Edge marked repaired.\n";
-                } else {
-                    cout << "Edge not found.\n";
-                }
-            }
-        }
-
-        this_thread::sleep_for(chrono::milliseconds(150));
-    }
-
-    cout << "Simulation ended" << endl;
-    cout << "Total time taken: " << waterSystem.simTimeSec << " seconds" << endl;
-    cout << "Here are the final 20 logs: " << endl;
-    waterSystem.printLastKLogs(20);
-    return 0;
-}
+#include "graph.h"
+#include "graph_checkpoint.h"
+#include "graph_des.h"
+#include "graph_metrics.h"
+#include "graph_replay.h"
+#include "graph_timeseries.h"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+// Builds the demo network: one reservoir feeding five tanks, plus two industries
+static void buildDemoNetwork(Graph& waterSystem) {
+    //Adding Tank nodes
+    waterSystem.addNode(0, "Reservoir", NodeType::Tank, 1e12);
+    waterSystem.addNode(1, "Tank 1", NodeType::Tank, 10000);
+    waterSystem.addNode(2, "Tank 2", NodeType::Tank, 1000);
+    waterSystem.addNode(3, "Tank 3", NodeType::Tank, 1000);
+    waterSystem.addNode(4, "Tank 4", NodeType::Tank, 500);
+    waterSystem.addNode(5, "Tank 5", NodeType::Tank, 1000);
+    //Adding Industry nodes
+    waterSystem.addNode(6, "Industry 1", NodeType::Industry, 100000);
+    waterSystem.addNode(7, "Industry 2", NodeType::Industry, 100000);
+    //Adding Edges between nodes (pipes)
+    waterSystem.addEdge(0, 1, 100, 70, true, 1);
+    waterSystem.addEdge(0, 2, 100, 70, true, 1);
+    waterSystem.addEdge(0, 3, 100, 70, true, 1);
+    waterSystem.addEdge(0, 4, 100, 70, true, 1);
+    waterSystem.addEdge(0, 5, 100, 70, true, 1);
+    waterSystem.addEdge(1, 3, 80, 60, true, 1);
+    waterSystem.addEdge(1, 5, 80, 60, true, 1);
+    waterSystem.addEdge(2, 4, 80, 50, true, 1);
+
+    // Setting Initial Levels of tanks
+    waterSystem.setNodeLevel(0, 1e12);
+    waterSystem.setNodeLevel(1, 10000);
+    waterSystem.setNodeLevel(2, 500);
+    waterSystem.setNodeLevel(3, 700);
+    waterSystem.setNodeLevel(4, 10);
+    waterSystem.setNodeLevel(5, 1000);
+    waterSystem.setNodeLevel(6, 1e4);
+    waterSystem.setNodeLevel(7, 1e5);
+
+    // Setting Initial Valve Status of tanks
+    waterSystem.editNodeValveStatus(0, 1);
+    waterSystem.editNodeValveStatus(1, 1);
+    waterSystem.editNodeValveStatus(2, 1);
+    waterSystem.editNodeValveStatus(3, 1);
+    waterSystem.editNodeValveStatus(4, 1);
+    waterSystem.editNodeValveStatus(5, 1);
+}
+
+int main(int argc, char** argv) {
+
+    Graph waterSystem;
+    buildDemoNetwork(waterSystem);
+
+    // Simulation parameters
+    const int intervalSec = 30;                 //Simulate every 30 seconds
+    const int totalSteps = 20;                  //No of steps to simulate
+    const double maxReductionPerHour = 10000.0; //max reduction unit/hour
+    const double prescribedLevel = 200.0;       //desired level of water in all tanks
+    const unsigned checkpointEverySteps = 10;   //steps between checkpoints when --checkpoint is given
+
+    // Command line options:
+    //   --headless <steps>     run the steps back to back with no console rendering and report throughput
+    //   --maxflow              use the max-flow allocation mode
+    //   --batched              refill every queued tank each step in parallel conflict-free batches
+    //   --zoned                route tanks through the zone-partitioned router
+    //   --widest               route each tank along its widest (maximum-bottleneck) path
+    //   --leak <from> <to> <fraction>  simulate a leak that loses <fraction> of what enters the pipe
+    //   --network <file>       load the network from a binary network file instead of the demo network
+    //   --import <nodes.csv> <pipes.csv>  replace the demo network with one imported from CSV files
+    //   --save-network <file>  write the network to a binary network file before simulating
+    //   --restore <file>       resume the run state from a checkpoint file (same network required)
+    //   --checkpoint <file>    write a checkpoint every checkpointEverySteps steps
+    //   --event-driven <sec>   run the discrete-event engine for <sec> simulated seconds instead of stepping
+    //   --ensemble <runs>      run independently seeded copies of the scenario for totalSteps steps
+    //                          each and report per-tank risk figures
+    //   --metrics <prefix>     on exit write <prefix>.prom (Prometheus text) and <prefix>.trace.json
+    //                          (Chrome trace); needs a build with make METRICS=1
+    //   --record <file>        record every node level and pipe flow each step and save the compressed
+    //                          time series to <file> on exit
+    //   --seed <n>             seed the consumption draws so the run can be repeated exactly
+    //   --record-run <file>    record the seed, the starting network and every edit of the run to <file>
+    //                          (network in <file>.net) so --replay can re-execute it
+    //   --replay <file>        re-run a recorded run and check every step's levels against the recording
+    long long headlessSteps = -1;
+    long long ensembleRuns = -1;
+    double eventDrivenSec = -1;
+    string replayPath;
+    unique_ptr<Checkpointer> checkpointer;
+    unique_ptr<CheckpointObserver> checkpointObserver;
+    struct MetricsExport { // writes the files on every return from main
+        string prefix;
+        ~MetricsExport() {
+            if (prefix.empty()) return;
+            if (writeMetricsPrometheus(prefix + ".prom") && writeMetricsTrace(prefix + ".trace.json")) {
+                cout << "Metrics written to " << prefix << ".prom and " << prefix << ".trace.json" << endl;
+            }
+        }
+    } metricsExport;
+    struct SeriesExport { // saves the recording on every return from main
+        string path;
+        TimeSeriesRecorder recorder;
+        ~SeriesExport() {
+            if (path.empty() || !recorder.save(path)) return;
+            cout << "Recorded " << recorder.valuesRecorded() << " samples in " << recorder.chunkCount() << " chunks to "
+                 << path << " (" << recorder.compressedBytes() << " bytes, "
+                 << static_cast<double>(recorder.rawBytes()) / max<size_t>(1, recorder.compressedBytes()) << "x smaller than raw)" << endl;
+        }
+    } seriesExport;
+    struct RunExport { // writes the run script on every return from main
+        string path;
+        RunRecorder recorder;
+        ~RunExport() {
+            if (!path.empty() && recorder.finish()) cout << "Recorded " << recorder.steps() << " steps to " << path << endl;
+        }
+    } runExport;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--headless" && i + 1 < argc) headlessSteps = atoll(argv[++i]);
+        else if (arg == "--event-driven" && i + 1 < argc) eventDrivenSec = atof(argv[++i]);
+        else if (arg == "--ensemble" && i + 1 < argc) ensembleRuns = atoll(argv[++i]);
+        else if (arg == "--metrics" && i + 1 < argc) metricsExport.prefix = argv[++i];
+        else if (arg == "--record" && i + 1 < argc) {
+            seriesExport.path = argv[++i];
+            waterSystem.recordEdgeFlows = true;
+            waterSystem.addObserver(&seriesExport.recorder);
+        }
+        else if (arg == "--seed" && i + 1 < argc) waterSystem.seed(strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--record-run" && i + 1 < argc) runExport.path = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--maxflow") waterSystem.allocationMode = AllocationMode::MaxFlow;
+        else if (arg == "--batched") waterSystem.allocationMode = AllocationMode::Batched;
+        else if (arg == "--zoned") waterSystem.routingMode = RoutingMode::Zoned;
+        else if (arg == "--widest") waterSystem.routingMode = RoutingMode::Widest;
+        else if (arg == "--leak" && i + 3 < argc) {
+            if (!waterSystem.setEdgeLoss(atoi(argv[i + 1]), atoi(argv[i + 2]), atof(argv[i + 3]))) {
+                cerr << "Cannot set a leak on pipe " << argv[i + 1] << "->" << argv[i + 2] << endl;
+                return 1;
+            }
+            i += 3;
+        }
+        else if (arg == "--network" && i + 1 < argc) {
+            if (!waterSystem.loadBinary(argv[++i])) return 1;
+        }
+        else if (arg == "--import" && i + 2 < argc) {
+            waterSystem.clearNetwork();
+            ImportReport report = waterSystem.importCsv(argv[i + 1], argv[i + 2]);
+            i += 2;
+            cout << "Imported " << report.nodesImported << " nodes and " << report.edgesImported << " pipes" << endl;
+            for (const auto& err : report.errors) cerr << err << endl;
+            if (report.suppressedErrors) cerr << "(" << report.suppressedErrors << " more errors)" << endl;
+        }
+        else if (arg == "--save-network" && i + 1 < argc) {
+            if (!waterSystem.saveBinary(argv[++i])) return 1;
+        }
+        else if (arg == "--restore" && i + 1 < argc) {
+            if (!Checkpointer::restore(waterSystem, argv[++i])) return 1;
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointer.reset(new Checkpointer(argv[++i]));
+            checkpointObserver.reset(new CheckpointObserver(*checkpointer, checkpointEverySteps));
+            waterSystem.addObserver(checkpointObserver.get());
+        }
+    }
+    if (!replayPath.empty()) {
+        ReplayReport report;
+        if (!replayRun(replayPath, report)) return 1;
+        cout << "Replayed " << report.steps << " of " << report.recordedSteps << " steps in " << report.wallSeconds << " s" << endl;
+        if (report.firstMismatchStep >= 0) cout << "Levels diverged at step " << report.firstMismatchStep + 1 << endl;
+        else if (report.ok()) cout << "Every step matched the recording" << endl;
+        return report.ok() ? 0 : 1;
+    }
+    if (!runExport.path.empty()) {
+        // after every other option, so the recording starts from the network the run will use
+        RunParams params;
+        params.intervalSec = intervalSec;
+        params.maxReductionPerHour = maxReductionPerHour;
+        params.prescribedLevel = prescribedLevel;
+        if (!runExport.recorder.begin(waterSystem, params, runExport.path)) return 1;
+        waterSystem.addObserver(&runExport.recorder);
+    }
+    auto reportLeaks = [&waterSystem]() {
+        for (size_t i = 0; i < waterSystem.edges.size(); ++i) {
+            if (!waterSystem.leaks.flagged(static_cast<int>(i))) continue;
+            const Edge& e = waterSystem.edges[i];
+            cout << "Leak flagged on pipe " << e.from << "->" << e.to << " (confidence "
+                 << waterSystem.leaks.confidence(static_cast<int>(i)) << ", estimated loss "
+                 << waterSystem.leaks.lossFraction(static_cast<int>(i)) * 100 << "%)" << endl;
+        }
+    };
+    if (eventDrivenSec >= 0) {
+        EventSimConfig config;
+        config.maxReductionPerHour = maxReductionPerHour;
+        config.prescribedLevel = prescribedLevel;
+        EventSimulation des(waterSystem, config);
+        des.runUntil(waterSystem.simTimeSec + eventDrivenSec);
+        const EventSimStats& s = des.stats();
+        cout << "Event-driven run to " << Graph::formatTime(waterSystem.simTimeSec) << ": " << s.events << " events ("
+             << s.staleEvents << " superseded), " << s.refillsCompleted << " refills, " << s.delivered << " units delivered" << endl;
+        for (size_t i = 0; i < waterSystem.nodes.size(); ++i) {
+            cout << "Node " << waterSystem.nodes[i].id << " (" << waterSystem.nodes[i].name << "): level="
+                 << waterSystem.state.level[i] << " / " << waterSystem.state.capacity[i] << endl;
+        }
+        reportLeaks();
+        return 0;
+    }
+    if (ensembleRuns >= 0) {
+        EnsembleConfig config;
+        config.runs = static_cast<size_t>(ensembleRuns);
+        config.steps = totalSteps;
+        config.intervalSec = intervalSec;
+        config.maxReductionPerHour = maxReductionPerHour;
+        config.prescribedLevel = prescribedLevel;
+        EnsembleResult result = waterSystem.runEnsemble(config);
+        cout << "Ensemble: " << result.runs << " runs of " << totalSteps << " steps in " << result.wallSeconds
+             << " s (" << result.runsPerSecond << " runs/sec)" << endl;
+        for (const auto& t : result.tanks) {
+            cout << "Tank " << t.tankId << ": P(below prescribed)=" << t.probabilityBelowPrescribed
+                 << " emptied in " << t.runsEmptied << " runs";
+            if (t.runsEmptied) cout << " (mean time to empty " << Graph::formatTime(static_cast<int>(t.meanTimeToEmptySec)) << ")";
+            cout << " leak alerts/run=" << t.leakAlertsPerRun << endl;
+        }
+        return 0;
+    }
+    if (headlessSteps >= 0) {
+        BatchStats stats = waterSystem.runBatch(headlessSteps, intervalSec, 0, maxReductionPerHour, prescribedLevel);
+        cout << "Headless run: " << stats.steps << " steps in " << stats.wallSeconds << " s (seed " << waterSystem.seed() << ")" << endl;
+        cout << "Steps/sec: " << stats.stepsPerSecond << endl;
+        cout << "Simulated seconds per wall second: " << stats.simSecondsPerWallSecond << endl;
+        cout << "Simulated time: " << Graph::formatTime(waterSystem.simTimeSec) << endl;
+        reportLeaks();
+        return 0;
+    }
+
+    ConsoleObserver console;
+    waterSystem.addObserver(&console);
+
+    //Starting simulation
+    cout << "Starting Simulation" << endl;
+    cout << "(Prints every " << intervalSec << " seconds)" << endl;
+
+    for (int step = 0; step < totalSteps; ++step) {
+        cout << "\nSimulation Step: " << step + 1 << " Simulated Time: " << waterSystem.simTimeSec << " seconds" << endl;
+        cout << "----------------------------------------" << endl;
+        waterSystem.simulateStep(intervalSec, 0, maxReductionPerHour, prescribedLevel);
+        cout << "----------------------------------------" << endl;
+        cout << "Do you want to: \nEdit edge or node? enter e\nView logs? enter l\nClose simulation? enter c\n" << endl;
+
+        char choice; 
+        cin >> choice;
+        bool finish = false;
+
+        switch (choice) {
+            case 'e': {
+                cout << "Edit menu" << endl;
+                cout << "Node options:" << endl;
+                cout << "1. Edit node capacity\n2. Edit node valve status\n" << endl;
+                cout << "Edge options:" << endl;
+                cout << "3. Toggle edge active\n4. Set edge valve\n5. Edit edge capacity\n6. Edit edge flow rate" << endl;
+
+                int subChoice; 
+                cin >> subChoice;
+                EditBatch edit; // applied through applyEdits so a run recording sees it
+                switch (subChoice) {
+                    case 1: {
+                        int nodeId; cout << "Enter node id to edit capacity: "; cin >> nodeId;
+                        if (waterSystem.getNodeSlot(nodeId) == -1) {
+                            cout << "Node with id " << nodeId << " not found." << endl;
+                            break;
+                        }
+                        int newCapacity; cout << "Enter new capacity: "; cin >> newCapacity;
+                        edit.setNodeCapacity(nodeId, newCapacity);
+                        if (!waterSystem.applyEdits(edit))
+                            cout << "Invalid capacity " << newCapacity << "." << endl;
+                        else
+                            cout << "Node " << nodeId << " capacity set to " << newCapacity << endl;
+                        break;
+                    }
+                    case 2: {
+                        int nodeId; cout << "Enter node id to edit valve status: "; cin >> nodeId;
+                        if (waterSystem.getNodeSlot(nodeId) == -1) {
+                            cout << "Node with id " << nodeId << " not found." << endl;
+                            break;
+                        }
+                        int newValveStatus; cout << "Enter new valve status: "; cin >> newValveStatus;
+                        edit.setNodeValve(nodeId, newValveStatus);
+                        if (!waterSystem.applyEdits(edit))
+                            cout << "Invalid valve status " << newValveStatus << "." << endl;
+                        else
+                            cout << "Node " << nodeId << " valve status set to " << newValveStatus << endl;
+                        break;
+                    }
+                    case 3: {
+                        int from, to;
+                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
+                        cin >> from >> to;
+                        int idx = waterSystem.getEdgeIndex(from, to);
+                        if (idx == -1) {
+                            cout << "Edge from " << from << " to " << to << " not found." << endl;
+                            break;
+                        }
+                        edit.setEdgeActive(from, to, !waterSystem.edges[idx].active);
+                        if (!waterSystem.applyEdits(edit))
+                            cout << "Edge " << from << "->" << to << " could not be toggled." << endl;
+                        else
+                            cout << "Edge " << from << "->" << to << " active set to " << waterSystem.edges[idx].active << endl;
+                        break;
+                    }
+                    case 4: {
+                        int from, to;
+                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
+                        cin >> from >> to;
+                        int idx = waterSystem.getEdgeIndex(from, to);
+                        if (idx == -1) {
+                            cout << "Edge from " << from << " to " << to << " not found." << endl;
+                            break;
+                        }
+                        int val; cout << "Enter valve status: "; cin >> val;
+                        edit.setEdgeValve(from, to, val);
+                        if (!waterSystem.applyEdits(edit))
+                            cout << "Invalid valve status " << val << "." << endl;
+                        else
+                            cout << "Edge " << from << "->" << to << " valve status set to " << waterSystem.edges[idx].valveStatus << endl;
+                        break;
+                    }
+                    case 5: {
+                        int from, to;
+                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
+                        cin >> from >> to;
+                        int idx = waterSystem.getEdgeIndex(from, to);
+                        if (idx == -1) {
+                            cout << "Edge from " << from << " to " << to << " not found." << endl;
+                            break;
+                        }
+                        double newCapacity; cout << "Enter new capacity: "; cin >> newCapacity;
+                        edit.setEdgeCapacity(from, to, newCapacity);
+                        if (!waterSystem.applyEdits(edit))
+                            cout << "Invalid capacity " << newCapacity << "." << endl;
+                        else
+                            cout << "Edge " << from << "->" << to << " capacity set to " << newCapacity << endl;
+                        break;
+                    }
+                    case 6: {
+                        int from, to;
+                        cout << "Enter edge from node id and to node id (e.g. '1 2'): ";
+                        cin >> from >> to;
+                        int idx = waterSystem.getEdgeIndex(from, to);
+                        if (idx == -1) {
+                            cout << "Edge from " << from << " to " << to << " not found." << endl;
+                            break;
+                        }
+                        double newFlowRate; cout << "Enter new flow rate: "; cin >> newFlowRate;
+                        edit.setEdgeFlowRate(from, to, newFlowRate);
+                        if (!waterSystem.applyEdits(edit))
+                            cout << "Invalid flow rate " << newFlowRate << "." << endl;
+                        else
+                            cout << "Edge " << from << "->" << to << " flow rate set to " << newFlowRate << endl;
+                        break;
+                    }
+                    default:
+                        cout << "Invalid choice." << endl;
+                        break;
+                }
+                break;
+            }
+            case 'l': {
+                int k; 
+                cout << "Enter number of log entries to view: "; 
+                cin >> k;
+                waterSystem.printLastKLogs(k);
+                break;
+            }
+            case 'c':
+                finish = true;
+                break;
+            default:
+                cout << "Invalid choice." << endl;
+                break;
+        }
+
+        if (finish) break;
+
+        cout << "Has any previously detected leakage been fixed? Enter y/n: ";
+        char ch; cin >> ch;
+        if (ch == 'y') {
+            cout << "Enter edge to mark repaired (from to), or '-1 -1' to mark all edges active: ";
+            int from, to; cin >> from >> to;
+            EditBatch repairs;
+            if (from == -1 && to == -1) {
+                for (const auto& e : waterSystem.edges) {
+                    repairs.setEdgeActive(e.from, e.to, true);
+                    repairs.setEdgeValve(e.from, e.to, 1);
+                    repairs.setEdgeLoss(e.from, e.to, 0.0);
+                }
+                waterSystem.applyEdits(repairs);
+                waterSystem.pushLog("User marked all edges repaired/enabled.");
+            }
+            else{
+                repairs.setEdgeActive(from, to, true);
+                repairs.setEdgeValve(from, to, 1);
+                repairs.setEdgeLoss(from, to, 0.0);
+                if (waterSystem.applyEdits(repairs)) {
+                    waterSystem.pushLog("User marked edge " + to_string(from) + "->" + to_string(to) + " repaired/enabled.");
+                    cout << "Edge marked repaired.\n";
+                } else {
+                    cout << "Edge not found.\n";
+                }
+            }
+        }
+
+        this_thread::sleep_for(chrono::milliseconds(150));
+    }
+
+    cout << "Simulation ended" << endl;
+    cout << "Total time taken: " << waterSystem.simTimeSec << " seconds" << endl;
+    cout << "Here are the final 20 logs: " << endl;
+    waterSystem.printLastKLogs(20);
+    return 0;
+}
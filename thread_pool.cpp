@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    for (unsigned i = 1; i < threadCount; ++i) workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::runTasks() {
+    for (size_t i = nextIndex.fetch_add(1); i < jobCount; i = nextIndex.fetch_add(1)) (*job)(i);
+}
+
+void ThreadPool::workerLoop() {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        runTasks();
+        {
+            // every worker checks in once per job, so none can still hold it when the next one starts
+            std::lock_guard<std::mutex> lock(mtx);
+            if (++finishedWorkers == workers.size()) done.notify_all();
+        }
+    }
+}
+
+size_t ThreadPool::parallelForStealing(size_t count, const std::function<void(size_t, unsigned)>& fn) {
+    // remaining indices of each slot; the owner takes from the front, thieves take the back half
+    struct Share {
+        std::mutex m;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    const unsigned slots = size();
+    std::unique_ptr<Share[]> shares(new Share[slots]);
+    for (unsigned s = 0; s < slots; ++s) {
+        shares[s].begin = count * s / slots;
+        shares[s].end = count * (s + 1) / slots;
+    }
+    std::atomic<size_t> steals{0};
+
+    parallelFor(slots, [&](size_t slotIndex) {
+        const unsigned slot = static_cast<unsigned>(slotIndex);
+        Share& own = shares[slot];
+        while (true) {
+            size_t item = count;
+            {
+                std::lock_guard<std::mutex> lock(own.m);
+                if (own.begin < own.end) item = own.begin++;
+            }
+            if (item < count) {
+                fn(item, slot);
+                continue;
+            }
+            // own share is empty: take the upper half of the first victim that has work left
+            size_t stolenBegin = 0, stolenEnd = 0;
+            for (unsigned k = 1; k < slots && stolenBegin == stolenEnd; ++k) {
+                Share& victim = shares[(slot + k) % slots];
+                std::lock_guard<std::mutex> lock(victim.m);
+                if (victim.begin < victim.end) {
+                    size_t mid = victim.begin + (victim.end - victim.begin) / 2;
+                    stolenBegin = mid;
+                    stolenEnd = victim.end;
+                    victim.end = mid;
+                }
+            }
+            if (stolenBegin == stolenEnd) return; // nothing left anywhere
+            steals.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(own.m);
+            own.begin = stolenBegin;
+            own.end = stolenEnd;
+        }
+    });
+    return steals.load();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    std::lock_guard<std::mutex> jobLock(jobMtx);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job = &fn;
+        jobCount = count;
+        nextIndex.store(0);
+        finishedWorkers = 0;
+        ++generation;
+    }
+    wake.notify_all();
+    runTasks();
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait(lock, [&] { return finishedWorkers == workers.size(); });
+    job = nullptr;
+}
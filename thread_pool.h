@@ -0,0 +1,49 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops over the graph.
+// parallelFor hands out indices through an atomic counter; the calling thread works too.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs fn(i) for every i in [0, count) and returns when all calls have finished.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+    // Runs fn(i, slot) for every i in [0, count), where slot < size() identifies a per-thread
+    // context that only one thread uses at a time. Each slot starts with a contiguous share of
+    // the indices and steals half of another slot's remainder once its own share runs out,
+    // which suits items of uneven cost. Returns the number of steals.
+    size_t parallelForStealing(size_t count, const std::function<void(size_t, unsigned)>& fn);
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Process-wide pool shared by every Graph.
+    static ThreadPool& shared();
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::mutex jobMtx;                     // serialises parallelFor calls from different threads
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> nextIndex{0};
+    size_t finishedWorkers = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_H